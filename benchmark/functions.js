@@ -0,0 +1,62 @@
+var sqlite3 = require('../lib/sqlite3');
+
+var rows = 100000;
+
+// Every variant computes the same sum over `rows` rows, so the differences
+// are the cost of getting values into JavaScript: one main thread hop per
+// call, cached deterministic calls (100 distinct arguments), batched
+// aggregate steps, and fetching all rows instead.
+function setup(callback) {
+    var db = new sqlite3.Database('');
+    db.serialize(function() {
+        db.run("CREATE TABLE foo (id INTEGER PRIMARY KEY, value INT)");
+        db.run("BEGIN");
+        var stmt = db.prepare("INSERT INTO foo (value) VALUES (?)");
+        for (var i = 0; i < rows; i++) stmt.run(i % 100);
+        stmt.finalize();
+        db.run("COMMIT", function(err) {
+            if (err) throw err;
+            callback(db);
+        });
+    });
+}
+
+function query(sql, finished) {
+    setup(function(db) {
+        db.function('double', function(x) { return x * 2; });
+        db.function('double_cached', function(x) { return x * 2; }, { deterministic: true });
+        db.aggregate('js_sum', {
+            start: 0,
+            step: function(total, x) { return total + x; }
+        });
+        db.get(sql, function(err) {
+            if (err) throw err;
+            db.close(finished);
+        });
+    });
+}
+
+exports.compare = {
+    'scalar function, one hop per row': function(finished) {
+        query("SELECT sum(double(value)) FROM foo", finished);
+    },
+
+    'deterministic scalar function': function(finished) {
+        query("SELECT sum(double_cached(value)) FROM foo", finished);
+    },
+
+    'aggregate function, batched steps': function(finished) {
+        query("SELECT js_sum(value * 2) FROM foo", finished);
+    },
+
+    'fetch rows and sum in JavaScript': function(finished) {
+        setup(function(db) {
+            db.all("SELECT value FROM foo", function(err, result) {
+                if (err) throw err;
+                var total = 0;
+                for (var i = 0; i < result.length; i++) total += result[i].value * 2;
+                db.close(finished);
+            });
+        });
+    }
+};
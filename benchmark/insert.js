@@ -51,6 +51,24 @@ exports.compare = {
 
         db.close(finished);
     },
+    'insert with transaction and runBatch': function(finished) {
+        var db = new sqlite3.Database('');
+
+        db.serialize(function() {
+            db.run("CREATE TABLE foo (id INT, txt TEXT)");
+            db.run("BEGIN");
+            var stmt = db.prepare("INSERT INTO foo VALUES (?, ?)");
+            var rows = [];
+            for (var i = 0; i < iterations; i++) {
+                rows.push([ i, 'Row ' + i ]);
+            }
+            stmt.runBatch(rows);
+            stmt.finalize();
+            db.run("COMMIT");
+        });
+
+        db.close(finished);
+    },
     'insert without transaction': function(finished) {
         var db = new sqlite3.Database('');
 
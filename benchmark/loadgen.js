@@ -0,0 +1,253 @@
+// Mixed read/write load generator in the spirit of YCSB.
+//
+//     node benchmark/loadgen.js [--clients=64] [--duration=5] [--read=0.95]
+//         [--distribution=zipfian|uniform] [--records=100000] [--row-size=100]
+//         [--threads=1,2,4,8] [--modes=serialize,parallelize] [--file=path]
+//         [--format=table|json]
+//
+// Every virtual client issues one operation at a time for `duration`
+// seconds: a point read with probability `read`, an update of a whole row
+// otherwise. The thread pool size is fixed when a process first uses it, so
+// each combination of UV_THREADPOOL_SIZE and mode runs in its own child
+// process against the same database file.
+
+var child_process = require('child_process');
+var fs = require('fs');
+var os = require('os');
+var path = require('path');
+
+function parseOptions(argv) {
+    var options = {
+        clients: 64,
+        duration: 5,
+        read: 0.95,
+        distribution: 'zipfian',
+        records: 100000,
+        rowSize: 100,
+        threads: [ 1, 2, 4, 8 ],
+        modes: [ 'serialize', 'parallelize' ],
+        file: path.join(os.tmpdir(), 'node-sqlite3-loadgen.db'),
+        format: 'table'
+    };
+    argv.forEach(function(arg) {
+        var match = /^--([a-z-]+)=(.*)$/.exec(arg);
+        if (!match) return;
+        var name = match[1].replace(/-([a-z])/g, function(_, c) { return c.toUpperCase(); });
+        if (!(name in options)) throw new Error('Unknown option --' + match[1]);
+        var value = match[2];
+        if (Array.isArray(options[name])) {
+            value = value.split(',');
+            if (name === 'threads') value = value.map(Number);
+        }
+        else if (typeof options[name] === 'number') {
+            value = Number(value);
+        }
+        options[name] = value;
+    });
+    return options;
+}
+
+// Zipfian distribution over [0, n) with the skew YCSB uses, after Gray et
+// al., "Quickly Generating Billion-Record Synthetic Databases". Keys are
+// scrambled with FNV-1a so that the hot keys aren't neighbours.
+function zipfian(n, theta) {
+    theta = theta || 0.99;
+    var zetan = 0;
+    for (var i = 1; i <= n; i++) zetan += 1 / Math.pow(i, theta);
+    var zeta2 = 1 + 1 / Math.pow(2, theta);
+    var alpha = 1 / (1 - theta);
+    var eta = (1 - Math.pow(2 / n, 1 - theta)) / (1 - zeta2 / zetan);
+
+    return function() {
+        var u = Math.random();
+        var uz = u * zetan;
+        var rank;
+        if (uz < 1) rank = 0;
+        else if (uz < zeta2) rank = 1;
+        else rank = Math.floor(n * Math.pow(eta * u - eta + 1, alpha));
+        return scramble(Math.min(rank, n - 1)) % n;
+    };
+}
+
+function scramble(value) {
+    var hash = 0x811c9dc5;
+    for (var i = 0; i < 4; i++) {
+        hash ^= (value >>> (i * 8)) & 0xff;
+        // hash * 0x01000193, without losing bits to doubles.
+        hash = ((hash << 24) + hash * 0x193) >>> 0;
+    }
+    return hash;
+}
+
+function uniform(n) {
+    return function() { return Math.floor(Math.random() * n); };
+}
+
+function payload(size) {
+    var text = '';
+    while (text.length < size) text += Math.random().toString(36).slice(2);
+    return text.slice(0, size);
+}
+
+function percentile(sorted, p) {
+    if (!sorted.length) return 0;
+    return sorted[Math.min(sorted.length - 1, Math.floor(sorted.length * p))];
+}
+
+// Runs in the child process. Latencies are reported in milliseconds.
+function run(options, mode, callback) {
+    var sqlite3 = require('../lib/sqlite3');
+    var db = new sqlite3.Database(options.file);
+    var next = options.distribution === 'uniform' ?
+        uniform(options.records) : zipfian(options.records);
+
+    db.configure('busyTimeout', 10000);
+    db[mode]();
+
+    var value = payload(options.rowSize);
+    var latencies = [];
+    var reads = 0, updates = 0, errors = 0;
+    var deadline = Date.now() + options.duration * 1000;
+    var start = process.hrtime();
+    var running = options.clients;
+    var statements = [];
+
+    // Each virtual client has its own statements. A statement runs one
+    // operation at a time, so shared ones would queue all clients behind
+    // each other and the benchmark would never have more than one read and
+    // one update in flight.
+    function client() {
+        var read = db.prepare("SELECT field FROM usertable WHERE key = ?");
+        var update = db.prepare("UPDATE usertable SET field = ? WHERE key = ?");
+        statements.push(read, update);
+
+        function operation() {
+            if (Date.now() >= deadline) {
+                if (--running === 0) finish();
+                return;
+            }
+            var began = process.hrtime();
+            function done(err) {
+                var elapsed = process.hrtime(began);
+                if (err) errors++;
+                latencies.push(elapsed[0] * 1e3 + elapsed[1] / 1e6);
+                operation();
+            }
+            if (Math.random() < options.read) {
+                reads++;
+                read.get(next(), done);
+            }
+            else {
+                updates++;
+                update.run(value, next(), done);
+            }
+        }
+        operation();
+    }
+
+    function finish() {
+        var elapsed = process.hrtime(start);
+        statements.forEach(function(stmt) { stmt.finalize(); });
+        db.close(function(err) {
+            if (err) throw err;
+            var sorted = latencies.sort(function(a, b) { return a - b; });
+            callback({
+                seconds: elapsed[0] + elapsed[1] / 1e9,
+                operations: reads + updates,
+                reads: reads,
+                updates: updates,
+                errors: errors,
+                p50: percentile(sorted, 0.5),
+                p99: percentile(sorted, 0.99),
+                p999: percentile(sorted, 0.999)
+            });
+        });
+    }
+
+    for (var i = 0; i < options.clients; i++) client();
+}
+
+function load(options, callback) {
+    var sqlite3 = require('../lib/sqlite3');
+    try { fs.unlinkSync(options.file); } catch (err) {}
+    var db = new sqlite3.Database(options.file);
+    db.serialize(function() {
+        db.run("PRAGMA journal_mode = WAL");
+        db.run("CREATE TABLE usertable (key INTEGER PRIMARY KEY, field TEXT)");
+        db.run("BEGIN");
+        var stmt = db.prepare("INSERT INTO usertable VALUES (?, ?)");
+        for (var i = 0; i < options.records; i++) stmt.run(i, payload(options.rowSize));
+        stmt.finalize();
+        db.run("COMMIT");
+        db.close(function(err) {
+            if (err) throw err;
+            callback();
+        });
+    });
+}
+
+function report(options, threads, mode, result) {
+    if (options.format === 'json') {
+        result.threads = threads;
+        result.mode = mode;
+        return console.log(JSON.stringify(result));
+    }
+    console.log([
+        pad(threads, 7),
+        pad(mode, 12),
+        pad(Math.round(result.operations / result.seconds), 10),
+        pad(result.p50.toFixed(3), 9),
+        pad(result.p99.toFixed(3), 9),
+        pad(result.p999.toFixed(3), 9),
+        pad(result.errors, 7)
+    ].join(' '));
+}
+
+function pad(value, width) {
+    value = String(value);
+    while (value.length < width) value = ' ' + value;
+    return value;
+}
+
+if (process.argv[2] === '--child') {
+    var childOptions = JSON.parse(process.argv[3]);
+    run(childOptions, process.argv[4], function(result) {
+        process.send(result);
+    });
+}
+else {
+    var options = parseOptions(process.argv.slice(2));
+    var runs = [];
+    options.threads.forEach(function(threads) {
+        options.modes.forEach(function(mode) {
+            runs.push({ threads: threads, mode: mode });
+        });
+    });
+
+    if (options.format !== 'json') {
+        console.log(options.clients + ' clients, ' + options.duration + 's, ' +
+            Math.round(options.read * 100) + '% reads, ' + options.distribution + ' keys, ' +
+            options.records + ' records of ' + options.rowSize + ' bytes');
+        console.log(' threads         mode      ops/s  p50 (ms)  p99 (ms) p999 (ms) errors');
+    }
+
+    load(options, function next() {
+        var current = runs.shift();
+        if (!current) {
+            try { fs.unlinkSync(options.file); } catch (err) {}
+            return;
+        }
+        var env = {};
+        for (var key in process.env) env[key] = process.env[key];
+        env.UV_THREADPOOL_SIZE = String(current.threads);
+        var child = child_process.fork(__filename,
+            [ '--child', JSON.stringify(options), current.mode ], { env: env });
+        child.on('message', function(result) {
+            report(options, current.threads, current.mode, result);
+        });
+        child.on('exit', function(code) {
+            if (code !== 0) throw new Error('Run exited with code ' + code);
+            next();
+        });
+    });
+}
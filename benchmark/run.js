@@ -0,0 +1,303 @@
+// Benchmark regression gate.
+//
+//     node benchmark/run.js [--runs=5] [--warmup=1] [--filter=regexp]
+//         [--baseline=file] [--counts=file] [--save] [--allow-missing]
+//         [--threshold=0.05] [--alloc-threshold=0.01] [--loadgen]
+//
+// Runs every case of the `compare` suites in benchmark/*.js `runs` times
+// and records its time and the allocations counted by sqlite3.debugStats().
+// With --loadgen, short benchmark/loadgen.js runs add throughput and
+// latency percentiles under concurrent load.
+//
+// --save stores the samples as the baselines. Timings only compare on the
+// same machine, so they go to --baseline, by default
+// benchmark/baselines/<platform>-<arch>.json, which isn't checked in.
+// Allocation and byte counts are exact and the same everywhere, so they go
+// to --counts, by default the checked-in benchmark/baselines/counts.json.
+//
+// Otherwise the samples are compared against the baselines and the process
+// exits with status 1 when a metric got worse by more than the threshold
+// and Welch's t-test says the difference is significant at the 95% level.
+// Counts only need to exceed --alloc-threshold. A missing counts baseline,
+// or a case missing from it, also fails the gate unless --allow-missing is
+// given; a missing timing baseline only skips the timings.
+
+var child_process = require('child_process');
+var fs = require('fs');
+var path = require('path');
+var sqlite3 = require('../lib/sqlite3');
+
+// Whether larger values of a metric are better.
+var higherIsBetter = {
+    time: false,
+    allocations: false,
+    bytes: false,
+    opsPerSec: true,
+    p50: false,
+    p99: false,
+    p999: false
+};
+
+function parseOptions(argv) {
+    var options = {
+        runs: 5,
+        warmup: 1,
+        filter: null,
+        baseline: path.join(__dirname, 'baselines', process.platform + '-' + process.arch + '.json'),
+        counts: path.join(__dirname, 'baselines', 'counts.json'),
+        save: false,
+        allowMissing: false,
+        threshold: 0.05,
+        allocThreshold: 0.01,
+        loadgen: false
+    };
+    argv.forEach(function(arg) {
+        var match = /^--([a-z-]+)(?:=(.*))?$/.exec(arg);
+        if (!match) throw new Error('Unknown argument ' + arg);
+        var name = match[1].replace(/-([a-z])/g, function(_, c) { return c.toUpperCase(); });
+        if (!(name in options)) throw new Error('Unknown option --' + match[1]);
+        var value = match[2];
+        if (typeof options[name] === 'boolean') value = value !== 'false';
+        else if (typeof options[name] === 'number') value = Number(value);
+        options[name] = value;
+    });
+    return options;
+}
+
+function suites() {
+    return fs.readdirSync(__dirname).filter(function(file) {
+        return /\.js$/.test(file) && file !== 'run.js' && file !== 'loadgen.js';
+    }).sort().map(function(file) {
+        return { file: file, compare: require(path.join(__dirname, file)).compare || {} };
+    });
+}
+
+function totals(stats) {
+    var result = { allocations: 0, bytes: 0 };
+    for (var operation in stats) {
+        result.allocations += stats[operation].allocations;
+        result.bytes += stats[operation].bytes;
+    }
+    return result;
+}
+
+// Runs one case `count` times, one after the other.
+function measure(fn, count, callback) {
+    var samples = { time: [], allocations: [], bytes: [] };
+    (function next() {
+        if (samples.time.length === count) return callback(samples);
+        sqlite3.debugStats(true);
+        var start = process.hrtime();
+        fn(function() {
+            var elapsed = process.hrtime(start);
+            var counted = totals(sqlite3.debugStats());
+            samples.time.push(elapsed[0] * 1e3 + elapsed[1] / 1e6);
+            samples.allocations.push(counted.allocations);
+            samples.bytes.push(counted.bytes);
+            // Let closed databases be cleaned up before the next run.
+            setImmediate(next);
+        });
+    })();
+}
+
+function loadgen(options, callback) {
+    var samples = { opsPerSec: [], p50: [], p99: [], p999: [] };
+    (function next() {
+        if (samples.opsPerSec.length === options.runs) return callback(samples);
+        var args = [ path.join(__dirname, 'loadgen.js'), '--format=json',
+            '--duration=2', '--records=10000', '--threads=4', '--modes=parallelize' ];
+        child_process.execFile(process.execPath, args, function(err, stdout) {
+            if (err) throw err;
+            var result = JSON.parse(stdout.trim().split('\n').pop());
+            samples.opsPerSec.push(result.operations / result.seconds);
+            samples.p50.push(result.p50);
+            samples.p99.push(result.p99);
+            samples.p999.push(result.p999);
+            next();
+        });
+    })();
+}
+
+function collect(options, callback) {
+    var cases = [];
+    suites().forEach(function(suite) {
+        Object.keys(suite.compare).forEach(function(name) {
+            var id = suite.file + ': ' + name;
+            if (options.filter && !new RegExp(options.filter).test(id)) return;
+            cases.push({ id: id, fn: suite.compare[name] });
+        });
+    });
+
+    var results = {};
+    (function next() {
+        var current = cases.shift();
+        if (!current) {
+            if (!options.loadgen) return callback(results);
+            console.error('loadgen.js');
+            return loadgen(options, function(samples) {
+                results['loadgen.js: 95% reads, zipfian'] = samples;
+                callback(results);
+            });
+        }
+        console.error(current.id);
+        measure(current.fn, options.warmup, function() {
+            measure(current.fn, options.runs, function(samples) {
+                results[current.id] = samples;
+                next();
+            });
+        });
+    })();
+}
+
+function mean(values) {
+    var sum = 0;
+    for (var i = 0; i < values.length; i++) sum += values[i];
+    return sum / values.length;
+}
+
+function variance(values) {
+    var m = mean(values), sum = 0;
+    for (var i = 0; i < values.length; i++) sum += (values[i] - m) * (values[i] - m);
+    return values.length > 1 ? sum / (values.length - 1) : 0;
+}
+
+// Two-sided critical values of Student's t distribution at p = 0.05.
+var T_CRITICAL = [ 12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262, 2.228,
+    2.201, 2.179, 2.160, 2.145, 2.131, 2.120, 2.110, 2.101, 2.093, 2.086,
+    2.080, 2.074, 2.069, 2.064, 2.060, 2.056, 2.052, 2.048, 2.045, 2.042 ];
+
+// Welch's t-test for samples with unequal variances.
+function significant(a, b) {
+    var va = variance(a) / a.length, vb = variance(b) / b.length;
+    if (va + vb === 0) return mean(a) !== mean(b);
+    var t = Math.abs(mean(a) - mean(b)) / Math.sqrt(va + vb);
+    var df = (va + vb) * (va + vb) /
+        (va * va / Math.max(a.length - 1, 1) + vb * vb / Math.max(b.length - 1, 1));
+    var critical = df >= T_CRITICAL.length ? 1.960 : T_CRITICAL[Math.max(Math.floor(df), 1) - 1];
+    return t > critical;
+}
+
+function isCount(metric) {
+    return metric === 'allocations' || metric === 'bytes';
+}
+
+// Splits the results into the timing samples and the counts of each case.
+// Counts don't vary between runs, so one value per metric is kept.
+function split(results) {
+    var timings = {}, counts = {};
+    Object.keys(results).forEach(function(id) {
+        Object.keys(results[id]).forEach(function(metric) {
+            if (isCount(metric)) {
+                counts[id] = counts[id] || {};
+                counts[id][metric] = Math.round(mean(results[id][metric]));
+            }
+            else {
+                timings[id] = timings[id] || {};
+                timings[id][metric] = results[id][metric];
+            }
+        });
+    });
+    return { timings: timings, counts: counts };
+}
+
+function report(regressed, id, metric, old, now) {
+    var change = old === 0 ? (now === 0 ? 0 : Infinity) : (now - old) / old;
+    console.log((regressed ? 'REGRESSION ' : '           ') + id + ' ' + metric + ': ' +
+        format(old) + ' -> ' + format(now) + ' (' + (change >= 0 ? '+' : '') +
+        (change * 100).toFixed(1) + '%)');
+}
+
+function worsening(metric, old, now) {
+    var change = old === 0 ? (now === 0 ? 0 : Infinity) : (now - old) / old;
+    return higherIsBetter[metric] ? -change : change;
+}
+
+// Returns the number of regressions and of cases without counts baseline.
+function compare(timings, counts, results, options) {
+    var regressions = 0, missing = 0;
+    Object.keys(results).forEach(function(id) {
+        var samples = results[id];
+        Object.keys(samples).forEach(function(metric) {
+            var now = mean(samples[metric]), old, regressed;
+            if (isCount(metric)) {
+                if (!counts.cases[id] || counts.cases[id][metric] === undefined) {
+                    console.log((options.allowMissing ? '           ' : 'MISSING    ') +
+                        id + ' ' + metric + ': no baseline');
+                    missing++;
+                    return;
+                }
+                old = counts.cases[id][metric];
+                regressed = worsening(metric, old, now) > options.allocThreshold;
+            }
+            else {
+                var before = timings && timings.cases[id];
+                if (!before || !before[metric]) return;
+                old = mean(before[metric]);
+                regressed = worsening(metric, old, now) > options.threshold &&
+                    significant(before[metric], samples[metric]);
+            }
+            if (regressed) regressions++;
+            report(regressed, id, metric, old, now);
+        });
+    });
+    return { regressions: regressions, missing: missing };
+}
+
+function read(file) {
+    return fs.existsSync(file) ? JSON.parse(fs.readFileSync(file, 'utf8')) : null;
+}
+
+function write(file, data) {
+    var dir = path.dirname(file);
+    if (!fs.existsSync(dir)) fs.mkdirSync(dir);
+    fs.writeFileSync(file, JSON.stringify(data, null, 2) + '\n');
+    console.log('Saved baseline to ' + file);
+}
+
+function format(value) {
+    return value >= 100 ? String(Math.round(value)) : value.toFixed(3);
+}
+
+var options = parseOptions(process.argv.slice(2));
+collect(options, function(results) {
+    var parts = split(results);
+    if (options.save) {
+        write(options.baseline, {
+            node: process.version,
+            sqlite: sqlite3.VERSION,
+            runs: options.runs,
+            cases: parts.timings
+        });
+        // Keeps the counts of cases that --filter left out.
+        var saved = read(options.counts) || { cases: {} };
+        Object.keys(parts.counts).forEach(function(id) {
+            saved.cases[id] = parts.counts[id];
+        });
+        write(options.counts, { sqlite: sqlite3.VERSION, cases: saved.cases });
+        return;
+    }
+
+    var timings = read(options.baseline);
+    if (!timings) {
+        console.log('No timing baseline at ' + options.baseline + '; create one with --save.');
+    }
+    else if (timings.node !== process.version || timings.sqlite !== sqlite3.VERSION) {
+        console.log('Timing baseline was recorded with node ' + timings.node +
+            ' and SQLite ' + timings.sqlite + '.');
+    }
+    var counts = read(options.counts);
+    if (!counts) {
+        console.log('No counts baseline at ' + options.counts + '; create one with --save.');
+        if (!options.allowMissing) process.exit(1);
+        counts = { cases: {} };
+    }
+
+    var outcome = compare(timings, counts, results, options);
+    var failed = outcome.regressions || (outcome.missing && !options.allowMissing);
+    console.log(outcome.regressions ? outcome.regressions + ' regression(s)' : 'No regressions');
+    if (outcome.missing) {
+        console.log(outcome.missing + ' count(s) without baseline' +
+            (options.allowMissing ? '' : '; save them with --save or pass --allow-missing'));
+    }
+    process.exit(failed ? 1 : 0);
+});
@@ -33,9 +33,23 @@
       ],
       "cflags": [ "-include ../src/gcc-preinclude.h" ],
       "sources": [
+        "src/aggregates.cc",
+        "src/collations.cc",
+        "src/compress.cc",
         "src/database.cc",
+        "src/debug_stats.cc",
+        "src/functions.cc",
+        "src/metrics.cc",
         "src/node_sqlite3.cc",
-        "src/statement.cc"
+        "src/pool.cc",
+        "src/promise.cc",
+        "src/regexp.cc",
+        "src/statement.cc",
+        "src/timeline.cc",
+        "src/tokenizers.cc",
+        "src/udf.cc",
+        "src/unicode.cc",
+        "src/vector.cc"
       ]
     },
     {
@@ -0,0 +1,232 @@
+module.exports = function(sqlite3) {
+    var Database = sqlite3.Database;
+
+    function compareBy(key) {
+        return function(a, b) {
+            a = a[key];
+            b = b[key];
+            return a < b ? -1 : a > b ? 1 : 0;
+        };
+    }
+
+    // Buffers rows and inserts them in batches within one transaction.
+    function BulkLoader(db, statement, columns, options, settings, indexes) {
+        this.database = db;
+        this.statement = statement;
+        this.columns = columns;
+        this.batchSize = options.batchSize || 10000;
+        // Rows are buffered as arrays, so names are sorted by their position.
+        var sortBy = typeof options.sortBy === 'string' ?
+            columns.indexOf(options.sortBy) : options.sortBy;
+        this.compare = sortBy !== undefined ? compareBy(sortBy) : null;
+        this.settings = settings;
+        this.indexes = indexes;
+        // Without a journal, ROLLBACK can't undo what was written.
+        this.rollback = !/^OFF$/i.test(options.journalMode || '');
+        this.rows = [];
+        this.error = null;
+        this.finished = false;
+    }
+
+    // Adds rows, either arrays of values in column order or objects keyed by
+    // column name. Columns missing from an object are inserted as NULL.
+    BulkLoader.prototype.insert = function(rows) {
+        if (this.finished) {
+            throw new Error('Bulk load has already finished');
+        }
+        for (var i = 0; i < rows.length; i++) {
+            var row = rows[i];
+            if (!Array.isArray(row)) row = this.columns.map(valueOf, row);
+            this.rows.push(row);
+        }
+        if (this.rows.length >= this.batchSize) this.flush();
+        return this;
+    };
+
+    function valueOf(name) {
+        return this[name] === undefined ? null : this[name];
+    }
+
+    BulkLoader.prototype.flush = function() {
+        var loader = this;
+        if (!this.rows.length) return this;
+        var rows = this.rows;
+        this.rows = [];
+        // Inserting in key order keeps B-tree pages dense and local.
+        if (this.compare) rows.sort(this.compare);
+        this.statement.runBatch(rows, function(err) {
+            if (err && !loader.error) loader.error = err;
+        });
+        return this;
+    };
+
+    // Inserts the remaining rows, commits, creates the deferred indexes and
+    // restores the connection settings.
+    BulkLoader.prototype.finish = function(callback) {
+        var loader = this;
+        var db = this.database;
+        if (this.finished) {
+            throw new Error('Bulk load has already finished');
+        }
+        this.flush();
+        this.finished = true;
+
+        function check(err) {
+            if (err && !loader.error) loader.error = err;
+        }
+
+        // The finalize callback runs after all batches have completed.
+        this.statement.finalize(function() {
+            db.serialize(function() {
+                if (loader.error && loader.rollback) {
+                    // Fails if SQLite has already rolled back, e.g. after
+                    // SQLITE_FULL; the batch's error is reported either way.
+                    db.run("ROLLBACK", check);
+                }
+                else {
+                    db.run("COMMIT", check);
+                    loader.indexes.forEach(function(index) {
+                        db.run(index.sql, check);
+                    });
+                }
+                restore(db, loader.settings, function(err) {
+                    var error = loader.error || err;
+                    if (callback) callback.call(db, error);
+                    else if (error) db.emit('error', error);
+                });
+            });
+        });
+    };
+
+    function restore(db, settings, callback) {
+        var error = null;
+        function check(err) {
+            if (err && !error) error = err;
+        }
+        db.serialize(function() {
+            for (var name in settings) {
+                db.run("PRAGMA " + name + " = " + settings[name], check);
+            }
+            db.wait(function(err) {
+                callback(error || err);
+            });
+        });
+    }
+
+    function quote(name) {
+        return '"' + name.replace(/"/g, '""') + '"';
+    }
+
+    // Database#bulkLoad(table, [options], callback)
+    //
+    // Switches the connection to load-optimized settings, drops the
+    // secondary indexes of `table` and prepares an INSERT for `options.columns`
+    // (default: all columns). The callback receives a BulkLoader; its
+    // finish() method restores everything. Rows are inserted with positional
+    // parameters; objects are turned into arrays in column order.
+    //   journalMode: 'MEMORY' (default) or 'OFF'. Without a journal, a failed
+    //                load isn't rolled back: the rows inserted before the
+    //                error are committed. A crash during the load will most
+    //                likely corrupt the database.
+    //   cacheSize:   cache_size during the load (default: -262144, i.e. 256MB)
+    //   deferIndexes: drop and recreate secondary indexes (default: true)
+    //   columns:     names of the columns to insert
+    //   sortBy:      column index/name to sort each batch by
+    //   batchSize:   rows per native batch (default: 10000)
+    Database.prototype.bulkLoad = function(table, options, callback) {
+        if (typeof options === 'function') {
+            callback = options;
+            options = {};
+        }
+        options = options || {};
+
+        var db = this;
+        var settings = {}, indexes = [];
+        var journalMode = options.journalMode || 'MEMORY';
+        var cacheSize = options.cacheSize || -262144;
+
+        if (!/^(MEMORY|OFF)$/i.test(journalMode)) {
+            throw new TypeError('journalMode must be MEMORY or OFF');
+        }
+        if (options.columns && !(Array.isArray(options.columns) && options.columns.length &&
+                options.columns.every(function(name) { return typeof name === 'string'; }))) {
+            throw new TypeError('columns must be an array of column names');
+        }
+
+        function fail(err) {
+            restore(db, settings, function() {
+                callback.call(db, err);
+            });
+        }
+
+        db.serialize(function() {
+            [ 'journal_mode', 'synchronous', 'cache_size' ].forEach(function(name) {
+                db.get("PRAGMA " + name, function(err, row) {
+                    if (!err) settings[name] = row[name];
+                });
+            });
+            db.all("SELECT name, sql FROM sqlite_master WHERE type = 'index' AND tbl_name = ? AND sql IS NOT NULL",
+                    table, function(err, rows) {
+                if (err) return callback.call(db, err);
+                if (options.deferIndexes !== false) indexes = rows;
+
+                var error = null;
+                function check(err) {
+                    if (err && !error) error = err;
+                }
+
+                db.serialize(function() {
+                    db.run("PRAGMA journal_mode = " + journalMode, check);
+                    db.run("PRAGMA synchronous = OFF", check);
+                    db.run("PRAGMA cache_size = " + (cacheSize | 0), check);
+                    db.run("BEGIN", function(err) {
+                        // E.g. within a transaction, which isn't ours to end.
+                        if (err) return fail(err);
+                        if (error) return abort(error);
+
+                        db.serialize(function() {
+                            indexes.forEach(function(index) {
+                                db.run("DROP INDEX " + quote(index.name), check);
+                            });
+                            db.all("PRAGMA table_info(" + quote(table) + ")", function(err, info) {
+                                if (error || err) return abort(error || err);
+                                prepare(options.columns || info.map(function(column) { return column.name; }));
+                            });
+                        });
+                    });
+                });
+            });
+        });
+
+        function abort(err) {
+            function ignore() {}
+            db.serialize(function() {
+                if (/^OFF$/i.test(journalMode)) {
+                    // Nothing to undo but the dropped indexes.
+                    db.run("COMMIT", ignore);
+                    indexes.forEach(function(index) { db.run(index.sql, ignore); });
+                }
+                else {
+                    db.run("ROLLBACK", ignore);
+                }
+                fail(err);
+            });
+        }
+
+        function prepare(columns) {
+            if (typeof options.sortBy === 'string' && columns.indexOf(options.sortBy) < 0) {
+                return abort(new TypeError('sortBy must name one of the inserted columns'));
+            }
+            var sql = "INSERT INTO " + quote(table) + " (" + columns.map(quote).join(", ") + ") VALUES (" +
+                columns.map(function() { return "?"; }).join(", ") + ")";
+            var statement = db.prepare(sql, function(err) {
+                if (err) return abort(err);
+                callback.call(db, null, new BulkLoader(db, statement, columns, options, settings, indexes));
+            });
+        }
+
+        return this;
+    };
+
+    return BulkLoader;
+};
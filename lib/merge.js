@@ -0,0 +1,92 @@
+// Helpers for combining the results of one query that was run in several
+// parts, e.g. over rowid ranges or over several database files.
+
+var combiners = {
+    sum: function(a, b) { return a + b; },
+    count: function(a, b) { return a + b; },
+    min: function(a, b) { return b < a ? b : a; },
+    max: function(a, b) { return b > a ? b : a; }
+};
+
+// Concatenates the row arrays of all parts in the order of the parts.
+function concat(results) {
+    return Array.prototype.concat.apply([], results);
+}
+exports.concat = concat;
+
+// Combines single-row aggregate results into one row. `spec` maps column
+// names to one of 'sum', 'count', 'min' or 'max'. Columns that are not
+// mentioned keep the value of the first part that returned a row. NULL
+// values (e.g. SUM() over an empty range) are skipped.
+function aggregate(results, spec) {
+    var row = null;
+    for (var i = 0; i < results.length; i++) {
+        var part = results[i][0];
+        if (!part) continue;
+        if (!row) {
+            row = {};
+            for (var key in part) row[key] = part[key];
+            continue;
+        }
+        for (var column in spec) {
+            var combine = combiners[spec[column]];
+            if (part[column] === null || part[column] === undefined) continue;
+            row[column] = (row[column] === null || row[column] === undefined)
+                ? part[column]
+                : combine(row[column], part[column]);
+        }
+    }
+    return row ? [ row ] : [];
+}
+exports.aggregate = aggregate;
+
+// Validates a merge option and returns a function that merges an array of
+// row arrays, or throws when the option is invalid.
+exports.merger = function(merge) {
+    if (merge === undefined || merge === null || merge === 'concat') {
+        return concat;
+    }
+    else if (typeof merge === 'function') {
+        return merge;
+    }
+    else if (typeof merge === 'object') {
+        for (var column in merge) {
+            if (!combiners[merge[column]]) {
+                throw new TypeError('Unknown aggregate "' + merge[column] +
+                    '" for column ' + column);
+            }
+        }
+        return function(results) { return aggregate(results, merge); };
+    }
+    throw new TypeError('Invalid merge option');
+};
+
+function compare(a, b) {
+    if (a === b) return 0;
+    if (a === null || a === undefined) return -1;
+    if (b === null || b === undefined) return 1;
+    return a < b ? -1 : 1;
+}
+
+// Merges row arrays that are each already sorted by `column` into one sorted
+// array without re-sorting the whole result.
+function sorted(results, column, descending) {
+    var heads = [], merged = [];
+    var i, direction = descending ? -1 : 1;
+    for (i = 0; i < results.length; i++) heads.push(0);
+
+    while (true) {
+        var best = -1;
+        for (i = 0; i < results.length; i++) {
+            if (heads[i] >= results[i].length) continue;
+            if (best < 0 || direction * compare(results[i][heads[i]][column],
+                    results[best][heads[best]][column]) < 0) {
+                best = i;
+            }
+        }
+        if (best < 0) break;
+        merged.push(results[best][heads[best]++]);
+    }
+    return merged;
+}
+exports.sorted = sorted;
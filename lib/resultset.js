@@ -0,0 +1,164 @@
+var os = require('os');
+
+// Values as packed by Statement::Work_AllPacked(), in the byte order of the
+// machine: a type byte, then an int64 or double, or a length-prefixed text
+// or blob. NULL has no payload.
+var INTEGER = 1;
+var FLOAT = 2;
+var TEXT = 3;
+var BLOB = 4;
+
+var littleEndian = os.endianness() === 'LE';
+
+function readUInt32(data, offset) {
+    return littleEndian ? data.readUInt32LE(offset) : data.readUInt32BE(offset);
+}
+
+function readInt32(data, offset) {
+    return littleEndian ? data.readInt32LE(offset) : data.readInt32BE(offset);
+}
+
+// Like all(), integers beyond 2^53 lose precision.
+function readInt64(data, offset) {
+    return littleEndian ?
+        data.readInt32LE(offset + 4) * 4294967296 + data.readUInt32LE(offset) :
+        data.readInt32BE(offset) * 4294967296 + data.readUInt32BE(offset + 4);
+}
+
+function readDouble(data, offset) {
+    return littleEndian ? data.readDoubleLE(offset) : data.readDoubleBE(offset);
+}
+
+function toBuffer(data) {
+    if (Buffer.isBuffer(data)) return data;
+    if (data instanceof ArrayBuffer) {
+        return Buffer.from && Buffer.from !== Uint8Array.from ? Buffer.from(data) : new Buffer(data);
+    }
+    throw new TypeError('ResultSet needs a Buffer or an ArrayBuffer');
+}
+
+// ResultSet(data)
+//
+// The rows of a query packed into one buffer by Statement#resultSet() or
+// Database#resultSet(). Rows and values are only converted to JavaScript
+// when they are accessed, so a large result costs one allocation until it
+// is read. `data` may also be the ArrayBuffer of toArrayBuffer(), e.g.
+// after transferring it to a worker; this module doesn't need the native
+// binding there.
+function ResultSet(data) {
+    if (!(this instanceof ResultSet)) return new ResultSet(data);
+    data = toBuffer(data);
+    this.data = data;
+    this.length = readUInt32(data, 0);
+    this._index = readUInt32(data, 8);
+
+    var columns = readUInt32(data, 4);
+    var offset = 12;
+    this.columns = [];
+    for (var i = 0; i < columns; i++) {
+        var length = readUInt32(data, offset);
+        this.columns.push(data.toString('utf8', offset + 4, offset + 4 + length));
+        offset += 4 + length;
+    }
+}
+
+// Offset of the value after the one at `offset`.
+ResultSet.prototype._skip = function(offset) {
+    switch (this.data[offset]) {
+        case INTEGER:
+        case FLOAT:
+            return offset + 9;
+        case TEXT:
+        case BLOB:
+            return offset + 5 + readInt32(this.data, offset + 1);
+        default:
+            return offset + 1;
+    }
+};
+
+ResultSet.prototype._value = function(offset) {
+    var data = this.data;
+    switch (data[offset]) {
+        case INTEGER:
+            return readInt64(data, offset + 1);
+        case FLOAT:
+            return readDouble(data, offset + 1);
+        case TEXT:
+            return data.toString('utf8', offset + 5, offset + 5 + readInt32(data, offset + 1));
+        case BLOB:
+            // A copy, as all() returns.
+            var length = readInt32(data, offset + 1);
+            var blob = new Buffer(length);
+            data.copy(blob, 0, offset + 5, offset + 5 + length);
+            return blob;
+        default:
+            return null;
+    }
+};
+
+ResultSet.prototype._offset = function(i) {
+    if (!(i >= 0 && i < this.length) || i % 1 !== 0) {
+        throw new RangeError('Row ' + i + ' is out of range');
+    }
+    return readUInt32(this.data, this._index + 4 * i);
+};
+
+// The row at index `i` as an object, like the rows of all().
+ResultSet.prototype.row = function(i) {
+    var offset = this._offset(i);
+    var row = {};
+    for (var c = 0; c < this.columns.length; c++) {
+        row[this.columns[c]] = this._value(offset);
+        offset = this._skip(offset);
+    }
+    return row;
+};
+
+// The values of one column of all rows. With duplicate names, the last
+// column of that name is used, as in the rows of all().
+ResultSet.prototype.column = function(name) {
+    var c = this.columns.lastIndexOf(name);
+    if (c < 0) throw new Error('No column named ' + name);
+    var values = new Array(this.length);
+    for (var i = 0; i < this.length; i++) {
+        var offset = this._offset(i);
+        for (var skip = 0; skip < c; skip++) offset = this._skip(offset);
+        values[i] = this._value(offset);
+    }
+    return values;
+};
+
+ResultSet.prototype.forEach = function(fn, thisArg) {
+    for (var i = 0; i < this.length; i++) fn.call(thisArg, this.row(i), i, this);
+};
+
+ResultSet.prototype.toArray = function() {
+    var rows = new Array(this.length);
+    for (var i = 0; i < this.length; i++) rows[i] = this.row(i);
+    return rows;
+};
+
+// An ArrayBuffer holding only the packed result, e.g. for
+// worker.postMessage(buffer, [ buffer ]).
+ResultSet.prototype.toArrayBuffer = function() {
+    var data = this.data;
+    if (data.byteOffset === 0 && data.byteLength === data.buffer.byteLength) {
+        return data.buffer;
+    }
+    return data.buffer.slice(data.byteOffset, data.byteOffset + data.byteLength);
+};
+
+if (typeof Symbol === 'function' && Symbol.iterator) {
+    ResultSet.prototype[Symbol.iterator] = function() {
+        var set = this, i = 0;
+        return {
+            next: function() {
+                return i < set.length ?
+                    { value: set.row(i++), done: false } :
+                    { value: undefined, done: true };
+            }
+        };
+    };
+}
+
+module.exports = ResultSet;
@@ -0,0 +1,208 @@
+var EventEmitter = require('events').EventEmitter;
+var util = require('util');
+var merge = require('./merge');
+
+module.exports = function(sqlite3) {
+    var Database = sqlite3.Database;
+    var isMemoryDatabase = sqlite3._isMemoryDatabase;
+
+    // 32-bit FNV-1a over the string form of the key.
+    function hash(key) {
+        var str = String(key), h = 0x811c9dc5;
+        for (var i = 0; i < str.length; i++) {
+            h ^= str.charCodeAt(i);
+            h = (h + (h << 1) + (h << 4) + (h << 7) + (h << 8) + (h << 24)) >>> 0;
+        }
+        return h;
+    }
+
+    // new ShardedDatabase(filenames, [mode], [options], [callback])
+    //
+    // Manages one Database per file. Keys are assigned to shards by hash
+    // (default) or, with `options.ranges`, by range: shard i holds the keys
+    // below ranges[i] and the last shard holds everything else.
+    function ShardedDatabase(filenames) {
+        if (!(this instanceof ShardedDatabase)) {
+            throw new TypeError('Use the new operator to create new ShardedDatabase objects');
+        }
+        if (!Array.isArray(filenames) || !filenames.length) {
+            throw new TypeError('Array of shard filenames expected');
+        }
+        EventEmitter.call(this);
+
+        var args = Array.prototype.slice.call(arguments, 1);
+        var callback = typeof args[args.length - 1] === 'function' ? args.pop() : null;
+        var mode = typeof args[0] === 'number' ? args.shift() : undefined;
+        var options = args[0] || {};
+        var sharded = this;
+
+        if (options.ranges) {
+            if (!Array.isArray(options.ranges) || options.ranges.length !== filenames.length - 1) {
+                throw new TypeError('Expected ' + (filenames.length - 1) + ' range boundaries');
+            }
+            // shardFor() returns the first shard whose boundary is above the key.
+            for (var i = 1; i < options.ranges.length; i++) {
+                if (!(options.ranges[i - 1] < options.ranges[i])) {
+                    throw new TypeError('Range boundaries must be strictly increasing');
+                }
+            }
+        }
+        this.ranges = options.ranges || null;
+
+        var waiting = filenames.length, error = null;
+        function opened(err) {
+            if (err && !error) error = err;
+            if (--waiting) return;
+            if (callback) callback.call(sharded, error);
+            else if (error) sharded.emit('error', error);
+            if (!error) sharded.emit('open');
+        }
+
+        this.shards = filenames.map(function(filename) {
+            return mode === undefined
+                ? new Database(filename, opened)
+                : new Database(filename, mode, opened);
+        });
+    }
+    util.inherits(ShardedDatabase, EventEmitter);
+
+    ShardedDatabase.prototype.shardFor = function(key) {
+        if (this.ranges) {
+            for (var i = 0; i < this.ranges.length; i++) {
+                if (key < this.ranges[i]) return i;
+            }
+            return this.ranges.length;
+        }
+        return hash(key) % this.shards.length;
+    };
+
+    // ShardedDatabase#run(key, sql, [bind1, bind2, ...], [callback])
+    // and likewise get, all, each and prepare: route the statement to the
+    // shard that holds `key`.
+    [ 'run', 'get', 'all', 'each', 'map', 'prepare' ].forEach(function(name) {
+        ShardedDatabase.prototype[name] = function(key) {
+            var db = this.shards[this.shardFor(key)];
+            var result = db[name].apply(db, Array.prototype.slice.call(arguments, 1));
+            return name === 'prepare' ? result : this;
+        };
+    });
+
+    // ShardedDatabase#exec(sql, [callback]): runs on every shard, e.g. for
+    // schema changes.
+    ShardedDatabase.prototype.exec = function(sql, callback) {
+        this._everyShard(function(db, done) { db.exec(sql, done); }, callback);
+        return this;
+    };
+
+    ShardedDatabase.prototype.close = function(callback) {
+        this._everyShard(function(db, done) { db.close(done); }, callback);
+        return this;
+    };
+
+    // ShardedDatabase#fanout(sql, [bind1, bind2, ...], [options], callback)
+    //
+    // Runs a read on several shards in parallel, each on its own read-only
+    // connection so that it doesn't queue behind writes to that shard.
+    //   keys:    only query the shards owning these keys (default: all)
+    //   orderBy: column name or { column, desc } the per-shard results are
+    //            sorted by; they are merged without re-sorting
+    //   merge:   'concat' (default), an aggregate spec like { n: 'sum' } or
+    //            a function receiving the row arrays
+    //   limit:   truncate the merged result
+    ShardedDatabase.prototype.fanout = function(sql) {
+        var sharded = this;
+        var args = Array.prototype.slice.call(arguments, 1);
+        var callback = args.pop();
+        var options = {};
+        if (args.length && args[args.length - 1] !== null && typeof args[args.length - 1] === 'object' &&
+                !Array.isArray(args[args.length - 1]) && !Buffer.isBuffer(args[args.length - 1]) &&
+                (args.length > 1 || isFanoutOptions(args[0]))) {
+            options = args.pop();
+        }
+        if (typeof callback !== 'function') {
+            throw new TypeError('Callback expected');
+        }
+
+        var combine;
+        if (options.orderBy) {
+            var order = typeof options.orderBy === 'string'
+                ? { column: options.orderBy } : options.orderBy;
+            combine = function(results) { return merge.sorted(results, order.column, order.desc); };
+        }
+        else {
+            try {
+                combine = merge.merger(options.merge);
+            } catch (err) {
+                return process.nextTick(function() { callback.call(sharded, err); });
+            }
+        }
+
+        var targets = [];
+        if (options.keys) {
+            options.keys.forEach(function(key) {
+                var index = sharded.shardFor(key);
+                if (targets.indexOf(index) < 0) targets.push(index);
+            });
+        }
+        else {
+            for (var i = 0; i < this.shards.length; i++) targets.push(i);
+        }
+
+        var results = [], remaining = targets.length, failed = false;
+        function finished(err, index, rows) {
+            if (failed) return;
+            if (err) {
+                failed = true;
+                return callback.call(sharded, err);
+            }
+            results[index] = rows;
+            if (--remaining) return;
+            var merged = combine(results);
+            if (options.limit !== undefined) merged = merged.slice(0, options.limit);
+            callback.call(sharded, null, merged);
+        }
+
+        if (!remaining) {
+            return process.nextTick(function() { callback.call(sharded, null, []); });
+        }
+
+        targets.forEach(function(index, position) {
+            var db = sharded.shards[index];
+            function query(conn) {
+                conn.all.apply(conn, [ sql ].concat(args, function(err, rows) {
+                    finished(err, position, rows);
+                }));
+            }
+            if (isMemoryDatabase(db.filename)) {
+                // Private in-memory databases can't be opened twice.
+                query(db);
+            }
+            else {
+                db._readers(1, function(err, readers) {
+                    if (err) return finished(err);
+                    query(readers[0]);
+                });
+            }
+        });
+        return this;
+    };
+
+    ShardedDatabase.prototype._everyShard = function(fn, callback) {
+        var sharded = this;
+        var waiting = this.shards.length, error = null;
+        this.shards.forEach(function(db) {
+            fn(db, function(err) {
+                if (err && !error) error = err;
+                if (--waiting) return;
+                if (callback) callback.call(sharded, error);
+                else if (error) sharded.emit('error', error);
+            });
+        });
+    };
+
+    function isFanoutOptions(object) {
+        return 'keys' in object || 'orderBy' in object || 'merge' in object || 'limit' in object;
+    }
+
+    return ShardedDatabase;
+};
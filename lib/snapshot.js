@@ -0,0 +1,103 @@
+module.exports = function(sqlite3) {
+    var Database = sqlite3.Database;
+    var isMemoryDatabase = sqlite3._isMemoryDatabase;
+
+    // A set of read-only connections whose read transactions all see the
+    // same state of the database. Queries are spread over the connections in
+    // turn, so independent reads run in parallel on the thread pool.
+    function Snapshot(db, readers) {
+        this.database = db;
+        this.readers = readers;
+        this.next = 0;
+    }
+
+    [ 'get', 'all', 'each', 'map', 'prepare' ].forEach(function(name) {
+        Snapshot.prototype[name] = function() {
+            if (!this.readers) {
+                throw new Error('Snapshot has already been released');
+            }
+            var reader = this.readers[this.next++ % this.readers.length];
+            var result = reader[name].apply(reader, arguments);
+            return name === 'prepare' ? result : this;
+        };
+    });
+
+    // Ends the read transactions and closes the connections.
+    Snapshot.prototype.release = function(callback) {
+        var readers = this.readers || [];
+        var waiting = readers.length, error = null;
+        this.readers = null;
+        if (!waiting && callback) process.nextTick(callback);
+        readers.forEach(function(reader) {
+            reader.close(function(err) {
+                if (err && !error) error = err;
+                if (!--waiting && callback) callback(error);
+            });
+        });
+    };
+
+    // Database#snapshot([options], callback)
+    //
+    // Opens `options.readers` (default 2) read-only connections pinned to the
+    // current state of the database. For WAL databases all of them share one
+    // snapshot; otherwise a single connection holds the read transaction,
+    // which also keeps writers from committing until the snapshot is
+    // released.
+    Database.prototype.snapshot = function(options, callback) {
+        if (typeof options === 'function') {
+            callback = options;
+            options = {};
+        }
+        options = options || {};
+
+        var db = this;
+        var count = options.readers || 2;
+
+        if (isMemoryDatabase(db.filename)) {
+            return process.nextTick(function() {
+                callback.call(db, new Error('Snapshots require a database file'));
+            });
+        }
+
+        function open(callback) {
+            var reader = new Database(db.filename, sqlite3.OPEN_READONLY, function(err) {
+                if (err) return callback(err);
+                db._copyFunctions(reader);
+                callback(null, reader);
+            });
+        }
+
+        open(function(err, first) {
+            if (err) return callback.call(db, err);
+            first.pinSnapshot(function(err, shared) {
+                if (err) {
+                    first.close();
+                    return callback.call(db, err);
+                }
+                var readers = [ first ];
+                var waiting = shared ? count - 1 : 0;
+                if (!waiting) return callback.call(db, null, new Snapshot(db, readers));
+
+                // Connections that fail to open the snapshot (e.g. because it
+                // was checkpointed away meanwhile) are simply not used.
+                for (var i = 1; i < count; i++) {
+                    open(function(err, reader) {
+                        if (err) return joined();
+                        reader.pinSnapshot(first, function(err) {
+                            if (err) reader.close();
+                            else readers.push(reader);
+                            joined();
+                        });
+                    });
+                }
+                function joined() {
+                    if (!--waiting) callback.call(db, null, new Snapshot(db, readers));
+                }
+            });
+        });
+
+        return this;
+    };
+
+    return Snapshot;
+};
@@ -29,13 +29,13 @@ function inherits(target, source) {
 
 sqlite3.cached = {
     Database: function(file, a, b) {
-        if (file === '' || file === ':memory:') {
+        if (isMemoryDatabase(file)) {
             // Don't cache special databases.
             return new Database(file, a, b);
         }
 
         var db;
-        file = path.resolve(file);
+        if (!isURI(file)) file = path.resolve(file);
         function cb() { callback.call(db, null); }
 
         if (!sqlite3.cached.objects[file]) {
@@ -56,6 +56,25 @@ sqlite3.cached = {
     objects: {}
 };
 
+// sqlite3.pooled.Database(filename, [mode], [callback])
+//
+// Opens a database whose connection is borrowed from the process-wide
+// connection pool and handed back to it on close(), keeping its page cache
+// and schema warm for the next database opened on the same file. Relative
+// paths are resolved first, so that different spellings of the same file
+// share its connections.
+sqlite3.pooled = {
+    Database: function(file, a, b) {
+        var mode = typeof a === 'number' ? a :
+            sqlite3.OPEN_READWRITE | sqlite3.OPEN_CREATE | sqlite3.OPEN_FULLMUTEX;
+        var callback = typeof a === 'number' ? b : a;
+        if (typeof file === 'string' && file !== '' && file !== ':memory:' && !isURI(file)) {
+            file = path.resolve(file);
+        }
+        return new Database(file, mode | sqlite3.OPEN_POOLED, callback);
+    }
+};
+
 
 var Database = sqlite3.Database;
 var Statement = sqlite3.Statement;
@@ -99,6 +118,381 @@ Database.prototype.map = normalizeMethod(function(statement, params) {
     return this;
 });
 
+// Database#hash(sql, [bind1, bind2, ...], [callback])
+//
+// Calls back with { hash, rows }: a 64-bit hex digest of the column names
+// and all result rows, and the number of rows. The rows are hashed while
+// stepping and never converted to JavaScript, e.g. for computing ETags.
+Database.prototype.hash = normalizeMethod(function(statement, params) {
+    statement.hash.apply(statement, params).finalize();
+    return this;
+});
+
+// Database#resultSet(sql, [bind1, bind2, ...], [callback])
+//
+// Like all(), but calls back with a sqlite3.ResultSet whose rows are only
+// converted to objects when they are read.
+Database.prototype.resultSet = normalizeMethod(function(statement, params) {
+    statement.resultSet.apply(statement, params).finalize();
+    return this;
+});
+
+// Promise variants: run/get/all/exec/prepare/close with an "Async" suffix.
+// The native methods resolve their promise when the work completes, so no
+// callbacks are wrapped; errors reject the promise instead of being emitted.
+// Not available before Node 0.12.
+function noop() {}
+
+function promiseMethod(name) {
+    return function(sql) {
+        var statement = new Statement(this, sql, noop);
+        var promise = statement[name].apply(statement, Array.prototype.slice.call(arguments, 1));
+        statement.finalize();
+        return promise;
+    };
+}
+
+if (Statement.prototype.runAsync) {
+    // Database#runAsync(sql, [bind1, bind2, ...]) resolves to { lastID, changes }
+    Database.prototype.runAsync = promiseMethod('runAsync');
+    // Database#getAsync(sql, [bind1, bind2, ...]) resolves to a row or undefined
+    Database.prototype.getAsync = promiseMethod('getAsync');
+    // Database#allAsync(sql, [bind1, bind2, ...]) resolves to an array of rows
+    Database.prototype.allAsync = promiseMethod('allAsync');
+
+    // Database#prepareAsync(sql, [bind1, bind2, ...]) resolves to the
+    // statement once it is prepared (and bound).
+    Database.prototype.prepareAsync = function(sql) {
+        var statement = new Statement(this, sql, noop);
+        return statement.bindAsync.apply(statement, Array.prototype.slice.call(arguments, 1));
+    };
+
+    var closeAsync = Database.prototype.closeAsync;
+    Database.prototype.closeAsync = function() {
+        closeReaders(this);
+        return closeAsync.call(this);
+    };
+}
+
+function isURI(filename) {
+    return filename.slice(0, 5) === 'file:';
+}
+
+// Whether the database lives in memory private to a single connection.
+// Shared-cache in-memory databases opened by URI, e.g.
+// "file:name?mode=memory&cache=shared", can be opened again by name.
+function isMemoryDatabase(filename) {
+    if (filename === '' || filename === ':memory:') return true;
+    if (!isURI(filename)) return false;
+    var memory = /^file::memory:|[?&]mode=memory(&|$)/.test(filename);
+    return memory && !/[?&]cache=shared(&|$)/.test(filename);
+}
+
+// Queries beyond the size of libuv's thread pool don't run in parallel, so
+// more readers than that would only cost file handles and page caches.
+var MAX_READERS = Math.max(1, parseInt(process.env.UV_THREADPOOL_SIZE, 10) || 4);
+
+// Opens a read-only connection to the same file as `db`, with the
+// functions registered on `db`. Callbacks passed to reader._whenOpen()
+// receive the result of opening it, also after it has opened. Readers that
+// fail to open are dropped from `pool`.
+function openReader(db, pool) {
+    var callbacks = [], result;
+    var reader = new Database(db.filename, sqlite3.OPEN_READONLY, function(err) {
+        result = err || null;
+        if (err && pool.indexOf(reader) >= 0) pool.splice(pool.indexOf(reader), 1);
+        if (!err) db._copyFunctions(reader);
+        callbacks.splice(0).forEach(function(callback) { callback(result); });
+    });
+    reader._whenOpen = function(callback) {
+        if (result === undefined) callbacks.push(callback);
+        else process.nextTick(function() { callback(result); });
+    };
+    return reader;
+}
+
+// Opens (or reuses) `count` read-only connections to the same file as this
+// database, but no more than MAX_READERS. Callers share the connections
+// and all of them wait until the ones they get are open. They are closed
+// together with the database.
+Database.prototype._readers = function(count, callback) {
+    var db = this;
+    var pool = db._readerPool || (db._readerPool = []);
+    count = Math.min(count, MAX_READERS);
+    while (pool.length < count) pool.push(openReader(db, pool));
+
+    var readers = pool.slice(0, count);
+    var waiting = readers.length, error = null;
+    readers.forEach(function(reader) {
+        reader._whenOpen(function(err) {
+            if (err && !error) error = err;
+            if (--waiting === 0) callback(error, error ? null : readers);
+        });
+    });
+};
+
+function quote(name) {
+    return '"' + String(name).replace(/"/g, '""') + '"';
+}
+
+function isInteger(value) {
+    return typeof value === 'number' && isFinite(value) && value % 1 === 0;
+}
+
+function closeReaders(db) {
+    var pool = db._readerPool;
+    if (pool) {
+        db._readerPool = null;
+        pool.forEach(function(reader) { reader.close(); });
+    }
+}
+
+var close = Database.prototype.close;
+Database.prototype.close = function() {
+    closeReaders(this);
+    return close.apply(this, arguments);
+};
+
+// Database#parallelAll(sql, [bind1, bind2, ...], options, callback)
+//
+// Splits the range of `options.partitionBy` (default: rowid) of
+// `options.table`, which must hold integers, into `options.parts` half-open
+// ranges and runs `sql` once per range on separate read-only connections. The query restricts itself
+// to its range through the $partitionStart and $partitionEnd parameters, e.g.
+//
+//     SELECT count(*) AS n FROM foo
+//         WHERE rowid >= $partitionStart AND rowid < $partitionEnd
+//
+// Results are concatenated unless `options.merge` is an aggregate spec such
+// as { n: 'sum' } or a function receiving the row arrays of all parts.
+// Positional parameters are bound by index, so `?` placeholders must appear
+// before the partition parameters in the query.
+Database.prototype.parallelAll = function(sql) {
+    var db = this;
+    var args = Array.prototype.slice.call(arguments, 1);
+    var callback = typeof args[args.length - 1] === 'function' ? args.pop() : null;
+    var options = args.pop() || {};
+    var params = args.length === 1 && typeof args[0] === 'object' && args[0] !== null &&
+        !Buffer.isBuffer(args[0]) && !(args[0] instanceof Date) && !(args[0] instanceof RegExp)
+        ? args[0] : args;
+    var column = options.partitionBy || 'rowid';
+    var parts = options.parts || 4;
+    var merge;
+
+    function done(err, rows) {
+        if (callback) callback.call(db, err, rows);
+        else if (err) db.emit('error', err);
+    }
+
+    try {
+        merge = require('./merge').merger(options.merge);
+    } catch (err) {
+        return done(err);
+    }
+    if (typeof options.table !== 'string') {
+        return done(new TypeError('parallelAll requires options.table'));
+    }
+    if (!(parts >= 1) || parts % 1 !== 0) {
+        return done(new TypeError('options.parts must be a positive integer'));
+    }
+
+    function bindings(start, end) {
+        var result = {};
+        if (Array.isArray(params)) {
+            for (var i = 0; i < params.length; i++) result[i + 1] = params[i];
+        }
+        else {
+            for (var key in params) result[key] = params[key];
+        }
+        result.$partitionStart = start;
+        result.$partitionEnd = end;
+        return result;
+    }
+
+    function run(connections, lo, hi) {
+        var size = Math.ceil((hi - lo + 1) / parts);
+        var results = [], remaining = 0, failed = false;
+        for (var i = 0, start = lo; start <= hi; i++, start += size) {
+            remaining++;
+            (function(index, start, end) {
+                var conn = connections[index % connections.length];
+                conn.all(sql, bindings(start, end), function(err, rows) {
+                    if (failed) return;
+                    if (err) {
+                        failed = true;
+                        return done(err);
+                    }
+                    results[index] = rows;
+                    if (--remaining === 0) done(null, merge(results));
+                });
+            })(i, start, Math.min(start + size, hi + 1));
+        }
+    }
+
+    var range = 'SELECT min(' + quote(column) + ') AS lo, max(' + quote(column) + ') AS hi FROM ' +
+        quote(options.table);
+    db.get(range, function(err, row) {
+        if (err) return done(err);
+        if (row.lo === null) return done(null, merge([]));
+        if (!isInteger(row.lo) || !isInteger(row.hi)) {
+            return done(new TypeError('parallelAll requires an integer partitionBy column, ' +
+                options.table + '.' + column + ' holds ' + row.lo + ' to ' + row.hi));
+        }
+        if (isMemoryDatabase(db.filename)) {
+            // Private in-memory databases can't be opened twice.
+            return run([ db ], row.lo, row.hi);
+        }
+        db._readers(parts, function(err, readers) {
+            if (err) return done(err);
+            run(readers, row.lo, row.hi);
+        });
+    });
+
+    return this;
+};
+
+// Database#integrityCheck([options], [callback])
+//
+// Runs PRAGMA integrity_check, or quick_check with `options.quick`, on a
+// separate read-only connection, so queries on this database keep running.
+// The check pauses for `options.pause` milliseconds whenever it has read
+// another `options.pagesPerSlice` pages (default 1000) and stops after
+// `options.maxErrors` problems (default 100). It reads one snapshot, which
+// only keeps writers out when the database isn't in WAL mode, so pausing
+// defaults to 10 ms in WAL mode and to none otherwise; asking for a pause
+// outside of WAL mode fails with SQLITE_MISUSE. The returned
+// emitter emits 'progress' with { pages, totalPages } after every slice and
+// can be cancel()ed. The callback receives the problems found, which is an
+// empty array for an intact database.
+var integrityCheck = Database.prototype.integrityCheck;
+Database.prototype.integrityCheck = function(options, callback) {
+    if (typeof options === 'function') {
+        callback = options;
+        options = null;
+    }
+    options = options || {};
+    var db = this;
+    var check = new EventEmitter();
+    var checker = null;
+    var cancelled = false;
+
+    function done(err, problems) {
+        if (callback) callback.call(db, err, problems);
+        else if (err) check.emit('error', err);
+        if (!err) check.emit('end', problems);
+    }
+
+    check.cancel = function() {
+        cancelled = true;
+        if (checker && checker.open) checker.interrupt();
+        return check;
+    };
+
+    if (isMemoryDatabase(db.filename)) {
+        process.nextTick(function() {
+            done(new Error('SQLITE_MISUSE: In-memory databases can\'t be checked on another connection'));
+        });
+        return check;
+    }
+
+    checker = new Database(db.filename, sqlite3.OPEN_READONLY, function(err) {
+        if (err) return done(err);
+        if (cancelled) {
+            err = new Error('SQLITE_INTERRUPT: interrupted');
+            err.errno = sqlite3.INTERRUPT;
+            err.code = 'SQLITE_INTERRUPT';
+            return checker.close(function() { done(err); });
+        }
+        try {
+            integrityCheck.call(checker, !!options.quick,
+                options.maxErrors === undefined ? 100 : options.maxErrors,
+                options.pagesPerSlice === undefined ? 1000 : options.pagesPerSlice,
+                options.pause === undefined ? -1 : options.pause,
+                function(err, problems) {
+                    checker.close(function() { done(err, problems); });
+                });
+        }
+        catch (err) {
+            checker.close(function() { done(err); });
+        }
+    });
+    checker.on('integrityProgress', function(pages, total) {
+        // An interrupt only reaches a running query.
+        if (cancelled) checker.interrupt();
+        check.emit('progress', { pages: pages, totalPages: total });
+    });
+
+    return check;
+};
+
+// Registers a function on this connection and remembers it, so that the
+// connections opened by parallelAll(), ShardedDatabase#fanout() and
+// snapshot() can have it too. Readers that are already open get it now.
+function register(db, name, spec) {
+    db.registerFunction(name, spec);
+    var functions = db._functions || (db._functions = []);
+    functions.push({ name: name, spec: spec });
+    (db._readerPool || []).forEach(function(reader) {
+        reader._whenOpen(function(err) {
+            if (!err) reader.registerFunction(name, spec);
+        });
+    });
+    return db;
+}
+
+// Registers the functions of this database on another, open connection.
+Database.prototype._copyFunctions = function(connection) {
+    (this._functions || []).forEach(function(registered) {
+        connection.registerFunction(registered.name, registered.spec);
+    });
+};
+
+// Database#function(name, fn, [options])
+//
+// Makes `fn` callable from SQL on this connection and on the read-only
+// connections this database opens for parallel queries. Queries run in the
+// thread pool, so each call waits until the main thread has run `fn`;
+// calls from concurrent queries are handed over together. With
+// `options.deterministic`, results are cached by argument, so repeated
+// arguments (e.g. over a scan of a low-cardinality column) don't leave the
+// thread pool. `options.varargs` accepts any number of arguments instead
+// of fn.length.
+Database.prototype.function = function(name, fn, options) {
+    options = options || {};
+    if (typeof fn !== 'function') {
+        throw new TypeError('fn must be a function');
+    }
+    return register(this, name, {
+        fn: fn,
+        length: options.varargs ? -1 : fn.length,
+        deterministic: !!options.deterministic
+    });
+};
+
+// Database#aggregate(name, { start, step, [result] }, [options])
+//
+// Registers an aggregate function, also on the connections used for
+// parallel queries. `step(accumulator, ...args)` returns the new
+// accumulator, starting with `start` (or its return value, if it is a
+// function) for each group; `result(accumulator)` computes the final
+// value. Rows are buffered and passed to the main thread in batches.
+Database.prototype.aggregate = function(name, definition, options) {
+    options = options || {};
+    if (!definition || typeof definition.step !== 'function') {
+        throw new TypeError('step must be a function');
+    }
+    if (definition.result !== undefined && typeof definition.result !== 'function') {
+        throw new TypeError('result must be a function');
+    }
+    return register(this, name, {
+        start: definition.start,
+        step: definition.step,
+        result: definition.result,
+        length: options.varargs ? -1 : Math.max(definition.step.length - 1, 0),
+        deterministic: !!options.deterministic
+    });
+};
+
 Statement.prototype.map = function() {
     var params = Array.prototype.slice.call(arguments);
     var callback = params.pop();
@@ -125,6 +519,32 @@ Statement.prototype.map = function() {
     return this.all.apply(this, params);
 };
 
+// Statement#resultSet([bind1, bind2, ...], [callback])
+Statement.prototype.resultSet = function() {
+    var params = Array.prototype.slice.call(arguments);
+    var callback = typeof params[params.length - 1] === 'function' ? params.pop() : null;
+    var statement = this;
+    params.push(function(err, data) {
+        if (err) {
+            if (callback) callback.call(statement, err);
+            else statement.emit('error', err);
+        }
+        else if (callback) {
+            callback.call(statement, null, new ResultSet(data));
+        }
+    });
+    return this.allPacked.apply(this, params);
+};
+
+// For the modules below, which open more connections to a database.
+sqlite3._isMemoryDatabase = isMemoryDatabase;
+
+var ResultSet = sqlite3.ResultSet = require('./resultset');
+sqlite3.ShardedDatabase = require('./sharded')(sqlite3);
+sqlite3.Snapshot = require('./snapshot')(sqlite3);
+sqlite3.BulkLoader = require('./bulkload')(sqlite3);
+sqlite3.timeline = require('./timeline')(sqlite3);
+
 var isVerbose = false;
 
 var supportedEvents = [ 'trace', 'profile', 'insert', 'update', 'delete' ];
@@ -164,6 +584,7 @@ sqlite3.verbose = function() {
             'all',
             'each',
             'map',
+            'hash',
             'close',
             'exec'
         ].forEach(function (name) {
@@ -173,9 +594,11 @@ sqlite3.verbose = function() {
             'bind',
             'get',
             'run',
+            'runBatch',
             'all',
             'each',
             'map',
+            'hash',
             'reset',
             'finalize',
         ].forEach(function (name) {
@@ -0,0 +1,124 @@
+module.exports = function(sqlite3) {
+    // Records the phases of database operations:
+    //
+    //     sqlite3.timeline.start();
+    //     ... queries ...
+    //     sqlite3.timeline.stop();
+    //     fs.writeFileSync('trace.json', JSON.stringify(sqlite3.timeline.toChromeTrace()));
+    //
+    // and open trace.json in chrome://tracing. Spans are kept in a native
+    // buffer of `capacity` entries (default 10000); older ones are dropped.
+    // Times are in microseconds since start(); `lockWait` is the part of the
+    // work phase spent waiting for the connection mutex.
+    var startedAt = 0;
+
+    var timeline = {
+        start: function(capacity) {
+            startedAt = Date.now();
+            if (capacity === undefined) sqlite3.startTimeline();
+            else sqlite3.startTimeline(capacity);
+            return timeline;
+        },
+
+        stop: function() {
+            sqlite3.stopTimeline();
+            return timeline;
+        },
+
+        // Recorded spans, oldest first. Pass true to clear the buffer.
+        spans: function(clear) {
+            return sqlite3.timelineSpans(!!clear);
+        },
+
+        // Chrome trace-event format. Every connection is shown as a thread,
+        // with one event per operation and nested events for its phases.
+        toChromeTrace: function(clear) {
+            var pid = process.pid;
+            var events = [];
+            var connections = {};
+            timeline.spans(clear).forEach(function(span) {
+                if (!connections[span.connection]) {
+                    connections[span.connection] = true;
+                    events.push({ name: 'thread_name', ph: 'M', pid: pid, tid: span.connection,
+                        args: { name: 'connection ' + span.connection } });
+                }
+                function phase(name, start, end, args) {
+                    events.push({ name: name, cat: 'sqlite3', ph: 'X', pid: pid, tid: span.connection,
+                        ts: start, dur: end - start, args: args || {} });
+                }
+                phase(span.name, span.enqueued, span.afterEnd,
+                    { id: span.id, connection: span.connection, statement: span.statement,
+                      lockWait: span.lockWait });
+                phase('queued', span.enqueued, span.dequeued);
+                phase('thread pool', span.dequeued, span.workStart);
+                phase('work', span.workStart, span.workEnd);
+                phase('callback', span.afterStart, span.afterEnd);
+            });
+            return { traceEvents: events, displayTimeUnit: 'ms' };
+        },
+
+        // OTLP/JSON trace data: one span per operation with its phases as
+        // events.
+        toOpenTelemetry: function(clear) {
+            var traceId = randomHex(32);
+            var spans = timeline.spans(clear).map(function(span) {
+                return {
+                    traceId: traceId,
+                    spanId: hex(span.id, 16),
+                    name: span.name,
+                    kind: 3,
+                    startTimeUnixNano: unixNano(span.enqueued),
+                    endTimeUnixNano: unixNano(span.afterEnd),
+                    attributes: [
+                        { key: 'db.system', value: { stringValue: 'sqlite' } },
+                        { key: 'sqlite.connection', value: { intValue: span.connection } },
+                        { key: 'sqlite.statement', value: { intValue: span.statement } },
+                        { key: 'sqlite.lock_wait_us', value: { doubleValue: span.lockWait } }
+                    ],
+                    events: [
+                        { name: 'dequeued', timeUnixNano: unixNano(span.dequeued) },
+                        { name: 'work.start', timeUnixNano: unixNano(span.workStart) },
+                        { name: 'work.end', timeUnixNano: unixNano(span.workEnd) },
+                        { name: 'callback.start', timeUnixNano: unixNano(span.afterStart) }
+                    ]
+                };
+            });
+            return {
+                resourceSpans: [ {
+                    resource: { attributes: [
+                        { key: 'service.name', value: { stringValue: 'node-sqlite3' } },
+                        { key: 'process.pid', value: { intValue: process.pid } }
+                    ] },
+                    scopeSpans: [ {
+                        scope: { name: 'sqlite3', version: sqlite3.VERSION },
+                        spans: spans
+                    } ]
+                } ]
+            };
+        }
+    };
+
+    // Nanoseconds since the epoch as a decimal string; they don't fit into
+    // a double.
+    function unixNano(microseconds) {
+        var ms = startedAt + microseconds / 1000;
+        var seconds = Math.floor(ms / 1000);
+        var nanos = String(Math.round((ms - seconds * 1000) * 1e6));
+        while (nanos.length < 9) nanos = '0' + nanos;
+        return String(seconds) + nanos;
+    }
+
+    function hex(value, length) {
+        var text = value.toString(16);
+        while (text.length < length) text = '0' + text;
+        return text;
+    }
+
+    function randomHex(length) {
+        var text = '';
+        while (text.length < length) text += hex(Math.floor(Math.random() * 0x10000), 4);
+        return text;
+    }
+
+    return timeline;
+};
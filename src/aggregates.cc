@@ -0,0 +1,319 @@
+#include <algorithm>
+#include <cmath>
+#include <vector>
+#include <stdint.h>
+
+#include "functions.h"
+#include "hash.h"
+
+namespace node_sqlite3 {
+
+// Aggregates keep a pointer to their state in the aggregate context; the
+// final function deletes it. SQLite calls xFinal even after an error in
+// xStep, so the state never leaks.
+template <class T> static T* AggregateState(sqlite3_context* context) {
+    T** state = static_cast<T**>(sqlite3_aggregate_context(context, sizeof(T*)));
+    if (state == NULL) return NULL;
+    if (*state == NULL) *state = new T();
+    return *state;
+}
+
+template <class T> static T* TakeAggregateState(sqlite3_context* context) {
+    T** state = static_cast<T**>(sqlite3_aggregate_context(context, 0));
+    if (state == NULL) return NULL;
+    T* result = *state;
+    *state = NULL;
+    return result;
+}
+
+static bool IsNumeric(sqlite3_value* value) {
+    int type = sqlite3_value_numeric_type(value);
+    return type == SQLITE_INTEGER || type == SQLITE_FLOAT;
+}
+
+// Validates the percentile argument, which must be the same for every row
+// of a group. Returns false after setting an error.
+static bool CheckPercentile(sqlite3_context* context, sqlite3_value* value, double& percentile, bool first) {
+    if (!IsNumeric(value)) {
+        sqlite3_result_error(context, "percentile must be a number between 0 and 100", -1);
+        return false;
+    }
+    double p = sqlite3_value_double(value);
+    if (!(p >= 0 && p <= 100)) {
+        sqlite3_result_error(context, "percentile must be a number between 0 and 100", -1);
+        return false;
+    }
+    if (!first && p != percentile) {
+        sqlite3_result_error(context, "percentile must be the same for all rows", -1);
+        return false;
+    }
+    percentile = p;
+    return true;
+}
+
+// Returns false after setting an error for values that aren't numbers.
+// NULLs are skipped like in the built-in aggregates.
+static bool CheckValue(sqlite3_context* context, sqlite3_value* value, bool& skip) {
+    skip = sqlite3_value_type(value) == SQLITE_NULL;
+    if (skip || IsNumeric(value)) return true;
+    sqlite3_result_error(context, "percentile values must be numeric", -1);
+    return false;
+}
+
+// percentile(x, p) and median(x) collect the values of the group and
+// select the ranks around p with nth_element, which is linear instead of
+// sorting the whole group. Like the SQLite percentile extension, p is in
+// the range 0..100 and the result is interpolated between the two nearest
+// values.
+struct ExactPercentile {
+    ExactPercentile() : percentile(50), initialized(false) {}
+    std::vector<double> values;
+    double percentile;
+    bool initialized;
+};
+
+static void ExactPercentileStep(sqlite3_context* context, int argc, sqlite3_value** argv) {
+    ExactPercentile* state = AggregateState<ExactPercentile>(context);
+    if (state == NULL) return sqlite3_result_error_nomem(context);
+
+    if (argc > 1) {
+        if (!CheckPercentile(context, argv[1], state->percentile, !state->initialized)) return;
+        state->initialized = true;
+    }
+    bool skip;
+    if (!CheckValue(context, argv[0], skip) || skip) return;
+    state->values.push_back(sqlite3_value_double(argv[0]));
+}
+
+static void ExactPercentileFinal(sqlite3_context* context) {
+    ExactPercentile* state = TakeAggregateState<ExactPercentile>(context);
+    if (state == NULL || state->values.empty()) {
+        delete state;
+        return sqlite3_result_null(context);
+    }
+
+    std::vector<double>& values = state->values;
+    double rank = state->percentile / 100 * (values.size() - 1);
+    size_t lower = (size_t)rank;
+    std::nth_element(values.begin(), values.begin() + lower, values.end());
+    double result = values[lower];
+    if (rank > lower) {
+        // The next rank is the smallest value of the upper partition.
+        double upper = *std::min_element(values.begin() + lower + 1, values.end());
+        result += (upper - result) * (rank - lower);
+    }
+    delete state;
+    sqlite3_result_double(context, result);
+}
+
+// percentile_approx(x, p) and median_approx(x) summarize the group in a
+// merging t-digest: values are buffered, then sorted and merged into
+// centroids whose size shrinks towards the tails, so extreme percentiles
+// stay accurate while memory stays bounded by the compression factor.
+struct Centroid {
+    Centroid(double mean_, double weight_) : mean(mean_), weight(weight_) {}
+    bool operator<(const Centroid& other) const { return mean < other.mean; }
+    double mean;
+    double weight;
+};
+
+class TDigest {
+public:
+    TDigest() : percentile(50), initialized(false), total(0), min(0), max(0) {
+        buffer.reserve(BUFFER_SIZE);
+    }
+
+    void Add(double value) {
+        if (total == 0 && buffer.empty()) min = max = value;
+        min = std::min(min, value);
+        max = std::max(max, value);
+        buffer.push_back(Centroid(value, 1));
+        if (buffer.size() >= BUFFER_SIZE) Compress();
+    }
+
+    bool Empty() const {
+        return total == 0 && buffer.empty();
+    }
+
+    double Quantile(double q) {
+        Compress();
+        if (centroids.size() == 1) return centroids[0].mean;
+
+        double target = q * total;
+        double cumulative = 0, previous_center = 0, previous_mean = min;
+        for (size_t i = 0; i < centroids.size(); i++) {
+            double center = cumulative + centroids[i].weight / 2;
+            if (target < center) {
+                return Interpolate(previous_mean, centroids[i].mean,
+                    previous_center, center, target);
+            }
+            cumulative += centroids[i].weight;
+            previous_center = center;
+            previous_mean = centroids[i].mean;
+        }
+        return Interpolate(previous_mean, max, previous_center, total, target);
+    }
+
+    double percentile;
+    bool initialized;
+
+private:
+    static const size_t BUFFER_SIZE = 512;
+    static const int COMPRESSION = 100;
+
+    static double Interpolate(double from, double to, double start, double end, double position) {
+        if (end <= start) return to;
+        return from + (to - from) * (position - start) / (end - start);
+    }
+
+    void Compress() {
+        if (buffer.empty()) return;
+        buffer.insert(buffer.end(), centroids.begin(), centroids.end());
+        std::sort(buffer.begin(), buffer.end());
+        total = 0;
+        for (size_t i = 0; i < buffer.size(); i++) total += buffer[i].weight;
+
+        centroids.clear();
+        Centroid current = buffer[0];
+        double so_far = 0;
+        for (size_t i = 1; i < buffer.size(); i++) {
+            double proposed = current.weight + buffer[i].weight;
+            double q = (so_far + proposed / 2) / total;
+            double limit = 4 * total * q * (1 - q) / COMPRESSION;
+            if (proposed <= limit) {
+                current.mean += (buffer[i].mean - current.mean) * buffer[i].weight / proposed;
+                current.weight = proposed;
+            }
+            else {
+                so_far += current.weight;
+                centroids.push_back(current);
+                current = buffer[i];
+            }
+        }
+        centroids.push_back(current);
+        buffer.clear();
+    }
+
+    double total;
+    double min;
+    double max;
+    std::vector<Centroid> centroids;
+    std::vector<Centroid> buffer;
+};
+
+static void ApproxPercentileStep(sqlite3_context* context, int argc, sqlite3_value** argv) {
+    TDigest* state = AggregateState<TDigest>(context);
+    if (state == NULL) return sqlite3_result_error_nomem(context);
+
+    if (argc > 1) {
+        if (!CheckPercentile(context, argv[1], state->percentile, !state->initialized)) return;
+        state->initialized = true;
+    }
+    bool skip;
+    if (!CheckValue(context, argv[0], skip) || skip) return;
+    state->Add(sqlite3_value_double(argv[0]));
+}
+
+static void ApproxPercentileFinal(sqlite3_context* context) {
+    TDigest* state = TakeAggregateState<TDigest>(context);
+    if (state == NULL || state->Empty()) {
+        delete state;
+        return sqlite3_result_null(context);
+    }
+    double result = state->Quantile(state->percentile / 100);
+    delete state;
+    sqlite3_result_double(context, result);
+}
+
+// approx_count_distinct(x) is a HyperLogLog sketch with 2^14 registers
+// (16KB per group, ~0.8% standard error). Values are hashed by type and
+// content, so 1 and '1' count as different values, just like DISTINCT
+// with the default collation.
+static const int HLL_PRECISION = 14;
+static const int HLL_REGISTERS = 1 << HLL_PRECISION;
+
+static void ApproxCountDistinctStep(sqlite3_context* context, int argc, sqlite3_value** argv) {
+    int type = sqlite3_value_type(argv[0]);
+    if (type == SQLITE_NULL) return;
+
+    // SQLite zeroes the context on allocation, which is exactly the
+    // initial state of the registers.
+    uint8_t* registers = static_cast<uint8_t*>(sqlite3_aggregate_context(context, HLL_REGISTERS));
+    if (registers == NULL) return sqlite3_result_error_nomem(context);
+
+    uint64_t hash;
+    if (type == SQLITE_INTEGER) {
+        sqlite3_int64 value = sqlite3_value_int64(argv[0]);
+        hash = Hash64::Compute(&value, sizeof(value), SQLITE_INTEGER);
+    }
+    else if (type == SQLITE_FLOAT) {
+        double value = sqlite3_value_double(argv[0]);
+        // Integral floats compare equal to integers, so hash them alike.
+        if (value >= -9.2e18 && value <= 9.2e18 && value == std::floor(value)) {
+            sqlite3_int64 integer = (sqlite3_int64)value;
+            hash = Hash64::Compute(&integer, sizeof(integer), SQLITE_INTEGER);
+        }
+        else {
+            hash = Hash64::Compute(&value, sizeof(value), SQLITE_FLOAT);
+        }
+    }
+    else {
+        const void* data = type == SQLITE_TEXT
+            ? (const void*)sqlite3_value_text(argv[0])
+            : sqlite3_value_blob(argv[0]);
+        hash = Hash64::Compute(data, sqlite3_value_bytes(argv[0]), type);
+    }
+
+    // The top bits select the register, the rest supplies the run of zeros.
+    uint32_t index = (uint32_t)(hash >> (64 - HLL_PRECISION));
+    uint64_t rest = (hash << HLL_PRECISION) | (1ULL << (HLL_PRECISION - 1));
+    uint8_t rank = 1;
+    while (!(rest & (1ULL << 63))) {
+        rank++;
+        rest <<= 1;
+    }
+    if (rank > registers[index]) registers[index] = rank;
+}
+
+static void ApproxCountDistinctFinal(sqlite3_context* context) {
+    uint8_t* registers = static_cast<uint8_t*>(sqlite3_aggregate_context(context, 0));
+    if (registers == NULL) return sqlite3_result_int64(context, 0);
+
+    const double m = HLL_REGISTERS;
+    double sum = 0;
+    int zeros = 0;
+    for (int i = 0; i < HLL_REGISTERS; i++) {
+        sum += std::ldexp(1.0, -registers[i]);
+        if (registers[i] == 0) zeros++;
+    }
+    double estimate = 0.7213 / (1 + 1.079 / m) * m * m / sum;
+    // Linear counting is more accurate while many registers are empty.
+    if (estimate <= 2.5 * m && zeros > 0) {
+        estimate = m * std::log(m / zeros);
+    }
+    sqlite3_result_int64(context, (sqlite3_int64)(estimate + 0.5));
+}
+
+int RegisterAggregateFunctions(sqlite3* db) {
+    static const struct {
+        const char* name;
+        int args;
+        void (*step)(sqlite3_context*, int, sqlite3_value**);
+        void (*final)(sqlite3_context*);
+    } functions[] = {
+        { "percentile", 2, ExactPercentileStep, ExactPercentileFinal },
+        { "median", 1, ExactPercentileStep, ExactPercentileFinal },
+        { "percentile_approx", 2, ApproxPercentileStep, ApproxPercentileFinal },
+        { "median_approx", 1, ApproxPercentileStep, ApproxPercentileFinal },
+        { "approx_count_distinct", 1, ApproxCountDistinctStep, ApproxCountDistinctFinal }
+    };
+
+    int status = SQLITE_OK;
+    for (unsigned int i = 0; i < sizeof(functions) / sizeof(functions[0]) && status == SQLITE_OK; i++) {
+        status = sqlite3_create_function(db, functions[i].name, functions[i].args, SQLITE_UTF8,
+            NULL, NULL, functions[i].step, functions[i].final);
+    }
+    return status;
+}
+
+}
@@ -2,6 +2,7 @@
 #define NODE_SQLITE3_SRC_ASYNC_H
 
 #include "threading.h"
+#include "metrics.h"
 #include <node_version.h>
 
 #if defined(NODE_SQLITE3_BOOST_THREADING)
@@ -18,6 +19,8 @@ protected:
     NODE_SQLITE3_MUTEX_t
     std::vector<Item*> data;
     Callback callback;
+    // Waits for `mutex` on both sides, protected by it.
+    node_sqlite3::LockWait lock_wait;
 public:
     Parent* parent;
 
@@ -32,7 +35,7 @@ public:
     static void listener(uv_async_t* handle, int status) {
         Async* async = static_cast<Async*>(handle->data);
         std::vector<Item*> rows;
-        NODE_SQLITE3_MUTEX_LOCK(&async->mutex)
+        node_sqlite3::LockMutex(&async->mutex, async->lock_wait);
         rows.swap(async->data);
         NODE_SQLITE3_MUTEX_UNLOCK(&async->mutex)
         for (unsigned int i = 0, size = rows.size(); i < size; i++) {
@@ -56,11 +59,18 @@ public:
     }
 
     void add(Item* item) {
-        NODE_SQLITE3_MUTEX_LOCK(&mutex);
+        node_sqlite3::LockMutex(&mutex, lock_wait);
         data.push_back(item);
         NODE_SQLITE3_MUTEX_UNLOCK(&mutex)
     }
 
+    node_sqlite3::LockWait LockStats() {
+        NODE_SQLITE3_MUTEX_LOCK(&mutex)
+        node_sqlite3::LockWait result = lock_wait;
+        NODE_SQLITE3_MUTEX_UNLOCK(&mutex)
+        return result;
+    }
+
     void send() {
         uv_async_send(&watcher);
     }
@@ -0,0 +1,99 @@
+#include <cstring>
+
+#include "functions.h"
+#include "unicode.h"
+
+namespace node_sqlite3 {
+
+enum CollationFlags {
+    COLLATE_NATURAL = 1,
+    COLLATE_FOLD = 2
+};
+
+static inline bool IsDigit(unsigned char c) {
+    return c >= '0' && c <= '9';
+}
+
+static inline uint32_t FoldAscii(uint32_t c) {
+    return c >= 'A' && c <= 'Z' ? c + 32 : c;
+}
+
+// Compares two UTF-8 strings code point by code point. With
+// COLLATE_NATURAL, runs of digits compare by their numeric value, so
+// "file2" sorts before "file10"; numbers that only differ in leading zeros
+// are ordered by the number of zeros if the strings are otherwise equal.
+// With COLLATE_FOLD, code points are case folded first. Pure ASCII text
+// never goes through the Unicode tables.
+static int CompareCollation(void* data, int length_a, const void* value_a, int length_b, const void* value_b) {
+    int flags = (int)(intptr_t)data;
+    const unsigned char* a = (const unsigned char*)value_a;
+    const unsigned char* b = (const unsigned char*)value_b;
+    const unsigned char* end_a = a + length_a;
+    const unsigned char* end_b = b + length_b;
+    int tie = 0;
+
+    while (a < end_a && b < end_b) {
+        if ((flags & COLLATE_NATURAL) && IsDigit(*a) && IsDigit(*b)) {
+            const unsigned char* zeros_a = a;
+            const unsigned char* zeros_b = b;
+            while (a < end_a && *a == '0') a++;
+            while (b < end_b && *b == '0') b++;
+            long zeros = (long)(a - zeros_a) - (long)(b - zeros_b);
+
+            const unsigned char* digits_a = a;
+            const unsigned char* digits_b = b;
+            while (a < end_a && IsDigit(*a)) a++;
+            while (b < end_b && IsDigit(*b)) b++;
+            // Without leading zeros, the longer number is the larger one.
+            if (a - digits_a != b - digits_b) return a - digits_a < b - digits_b ? -1 : 1;
+            int result = memcmp(digits_a, digits_b, a - digits_a);
+            if (result) return result < 0 ? -1 : 1;
+            if (!tie && zeros) tie = zeros < 0 ? -1 : 1;
+            continue;
+        }
+
+        uint32_t c_a, c_b;
+        if (*a < 0x80 && *b < 0x80) {
+            c_a = *a++;
+            c_b = *b++;
+            if (flags & COLLATE_FOLD) {
+                c_a = FoldAscii(c_a);
+                c_b = FoldAscii(c_b);
+            }
+        }
+        else {
+            c_a = DecodeUtf8(a, end_a);
+            c_b = DecodeUtf8(b, end_b);
+            if (flags & COLLATE_FOLD) {
+                c_a = FoldCase(c_a);
+                c_b = FoldCase(c_b);
+            }
+        }
+        if (c_a != c_b) return c_a < c_b ? -1 : 1;
+    }
+
+    if (a < end_a) return 1;
+    if (b < end_b) return -1;
+    return tie;
+}
+
+// NATURAL is a keyword in SQL, so the natural orderings are called NATSORT.
+int RegisterCollations(sqlite3* db) {
+    static const struct {
+        const char* name;
+        int flags;
+    } collations[] = {
+        { "NATSORT", COLLATE_NATURAL },
+        { "NATSORT_NOCASE", COLLATE_NATURAL | COLLATE_FOLD },
+        { "UNICODE_NOCASE", COLLATE_FOLD }
+    };
+
+    int status = SQLITE_OK;
+    for (unsigned int i = 0; i < sizeof(collations) / sizeof(collations[0]) && status == SQLITE_OK; i++) {
+        status = sqlite3_create_collation_v2(db, collations[i].name, SQLITE_UTF8,
+            (void*)(intptr_t)collations[i].flags, CompareCollation, NULL);
+    }
+    return status;
+}
+
+}
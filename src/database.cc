@@ -1,12 +1,16 @@
 #include <string.h>
+#include <algorithm>
 
 #include "macros.h"
 #include "database.h"
+#include "functions.h"
 #include "statement.h"
+#include "udf.h"
 
 using namespace node_sqlite3;
 
 Nan::Persistent<FunctionTemplate> Database::constructor_template;
+std::set<Database*> Database::instances;
 
 NAN_MODULE_INIT(Database::Init) {
     Nan::HandleScope scope;
@@ -24,6 +28,14 @@ NAN_MODULE_INIT(Database::Init) {
     Nan::SetPrototypeMethod(t, "parallelize", Parallelize);
     Nan::SetPrototypeMethod(t, "configure", Configure);
     Nan::SetPrototypeMethod(t, "interrupt", Interrupt);
+    Nan::SetPrototypeMethod(t, "pinSnapshot", PinSnapshot);
+    Nan::SetPrototypeMethod(t, "registerFunction", RegisterFunction);
+    Nan::SetPrototypeMethod(t, "tableStats", GetTableStats);
+    Nan::SetPrototypeMethod(t, "integrityCheck", IntegrityCheck);
+#ifdef NODE_SQLITE3_PROMISES
+    Nan::SetPrototypeMethod(t, "execAsync", ExecAsync);
+    Nan::SetPrototypeMethod(t, "closeAsync", CloseAsync);
+#endif
 
     NODE_SET_GETTER(t, "open", OpenGetter);
 
@@ -45,7 +57,11 @@ void Database::Process() {
         while (!queue.empty()) {
             Call* call = queue.front();
             Local<Function> cb = Nan::New(call->baton->callback);
-            if (!cb.IsEmpty() && cb->IsFunction()) {
+            if (!call->baton->resolver.IsEmpty()) {
+                SettlePromise(this->handle(), call->baton->resolver, exception, true);
+                called = true;
+            }
+            else if (!cb.IsEmpty() && cb->IsFunction()) {
                 TRY_CATCH_CALL(this->handle(), cb, 1, argv);
                 called = true;
             }
@@ -79,6 +95,10 @@ void Database::Process() {
 
         if (locked) break;
     }
+
+    if (open && !closing && pending == 0 && queue.empty()) {
+        ArmMaintenance();
+    }
 }
 
 void Database::Schedule(Work_Callback callback, Baton* baton, bool exclusive) {
@@ -87,7 +107,10 @@ void Database::Schedule(Work_Callback callback, Baton* baton, bool exclusive) {
     if (!open && locked) {
         EXCEPTION(Nan::New("Database is closed").ToLocalChecked(), SQLITE_MISUSE, exception);
         Local<Function> cb = Nan::New(baton->callback);
-        if (!cb.IsEmpty() && cb->IsFunction()) {
+        if (!baton->resolver.IsEmpty()) {
+            SettlePromise(handle(), baton->resolver, exception, true);
+        }
+        else if (!cb.IsEmpty() && cb->IsFunction()) {
             Local<Value> argv[] = { exception };
             TRY_CATCH_CALL(handle(), cb, 1, argv);
         }
@@ -98,6 +121,10 @@ void Database::Schedule(Work_Callback callback, Baton* baton, bool exclusive) {
         return;
     }
 
+    if (callback != Work_BeginMaintenance) {
+        PostponeMaintenance();
+    }
+
     if (!open || ((locked || exclusive || serialize) && pending > 0)) {
         queue.push(new Call(callback, baton, exclusive || serialize));
     }
@@ -121,6 +148,11 @@ NAN_METHOD(Database::New) {
     } else {
         mode = SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE | SQLITE_OPEN_FULLMUTEX;
     }
+    // Filenames like "file:name?mode=memory&cache=shared" are always URIs,
+    // so that several connections can share a named in-memory database.
+    if (strncmp(*filename, "file:", 5) == 0) {
+        mode |= SQLITE_OPEN_URI;
+    }
 
     Local<Function> callback;
     if (info.Length() >= pos && info[pos]->IsFunction()) {
@@ -129,6 +161,8 @@ NAN_METHOD(Database::New) {
 
     Database* db = new Database();
     db->Wrap(info.This());
+    db->pooled = (mode & NODE_SQLITE3_OPEN_POOLED) != 0;
+    db->filename = *filename;
 
     info.This()->ForceSet(Nan::New("filename").ToLocalChecked(), info[0].As<String>(), ReadOnly);
     info.This()->ForceSet(Nan::New("mode").ToLocalChecked(), Nan::New(mode), ReadOnly);
@@ -141,8 +175,8 @@ NAN_METHOD(Database::New) {
 }
 
 void Database::Work_BeginOpen(Baton* baton) {
-    int status = uv_queue_work(uv_default_loop(),
-        &baton->request, Work_Open, (uv_after_work_cb)Work_AfterOpen);
+    int status = Timeline::Queue(&baton->request, "Database.Open",
+        Work_Open, (uv_after_work_cb)Work_AfterOpen);
     assert(status == 0);
 }
 
@@ -150,12 +184,19 @@ void Database::Work_Open(uv_work_t* req) {
     OpenBaton* baton = static_cast<OpenBaton*>(req->data);
     Database* db = baton->db;
 
-    baton->status = sqlite3_open_v2(
-        baton->filename.c_str(),
-        &db->_handle,
-        baton->mode,
-        NULL
-    );
+    int flags = baton->mode & ~NODE_SQLITE3_OPEN_POOLED;
+    bool reused = false;
+    if (db->pooled) {
+        baton->status = ConnectionPool::Acquire(baton->filename, flags, &db->_handle, &reused);
+    }
+    else {
+        baton->status = sqlite3_open_v2(
+            baton->filename.c_str(),
+            &db->_handle,
+            flags,
+            NULL
+        );
+    }
 
     if (baton->status != SQLITE_OK) {
         baton->message = std::string(sqlite3_errmsg(db->_handle));
@@ -164,7 +205,12 @@ void Database::Work_Open(uv_work_t* req) {
     }
     else {
         // Set default database handle values.
-        sqlite3_busy_timeout(db->_handle, 1000);
+        sqlite3_busy_handler(db->_handle, BusyHandler, db);
+        // Pooled connections keep them, and registering FTS5 tokenizers
+        // again would leak the previous ones.
+        if (!reused) RegisterFunctions(db->_handle);
+        // Installed once: changing the authorizer expires all statements.
+        sqlite3_set_authorizer(db->_handle, AuthorizeCallback, db);
     }
 }
 
@@ -225,10 +271,11 @@ void Database::Work_BeginClose(Baton* baton) {
     assert(baton->db->pending == 0);
 
     baton->db->RemoveCallbacks();
+    baton->db->StopMaintenance();
     baton->db->closing = true;
 
-    int status = uv_queue_work(uv_default_loop(),
-        &baton->request, Work_Close, (uv_after_work_cb)Work_AfterClose);
+    int status = Timeline::Queue(&baton->request, "Database.Close",
+        Work_Close, (uv_after_work_cb)Work_AfterClose);
     assert(status == 0);
 }
 
@@ -236,7 +283,20 @@ void Database::Work_Close(uv_work_t* req) {
     Baton* baton = static_cast<Baton*>(req->data);
     Database* db = baton->db;
 
-    baton->status = sqlite3_close(db->_handle);
+    db->FreeSnapshot();
+    // Statements collected by the garbage collector may still wait for the
+    // thread pool.
+    db->FinalizeOrphans();
+    if (db->pooled && sqlite3_next_stmt(db->_handle, NULL) == NULL) {
+        // Connections with JavaScript functions would call into freed
+        // functions, so they are closed instead of being kept.
+        ConnectionPool::Release(db->_handle, db->functions.empty());
+        baton->status = SQLITE_OK;
+    }
+    else {
+        // Fails with SQLITE_BUSY while statements are left.
+        baton->status = sqlite3_close(db->_handle);
+    }
 
     if (baton->status != SQLITE_OK) {
         baton->message = std::string(sqlite3_errmsg(db->_handle));
@@ -261,6 +321,7 @@ void Database::Work_AfterClose(uv_work_t* req) {
     }
     else {
         db->open = false;
+        db->FreeFunctions();
         // Leave db->locked to indicate that this db object has reached
         // the end of its life.
         argv[0] = Nan::Null();
@@ -269,7 +330,11 @@ void Database::Work_AfterClose(uv_work_t* req) {
     Local<Function> cb = Nan::New(baton->callback);
 
     // Fire callbacks.
-    if (!cb.IsEmpty() && cb->IsFunction()) {
+    if (!baton->resolver.IsEmpty()) {
+        SettlePromise(db->handle(), baton->resolver,
+            db->open ? argv[0] : Local<Value>(Nan::Undefined()), db->open);
+    }
+    else if (!cb.IsEmpty() && cb->IsFunction()) {
         TRY_CATCH_CALL(db->handle(), cb, 1, argv);
     }
     else if (db->open) {
@@ -320,6 +385,11 @@ NAN_METHOD(Database::Parallelize) {
     info.GetReturnValue().Set(info.This());
 }
 
+static int IntegerOption(Local<Object> options, const char* name, int fallback) {
+    Local<Value> value = Nan::Get(options, Nan::New(name).ToLocalChecked()).ToLocalChecked();
+    return value->IsInt32() ? Nan::To<int32_t>(value).FromJust() : fallback;
+}
+
 NAN_METHOD(Database::Configure) {
     Database* db = Nan::ObjectWrap::Unwrap<Database>(info.This());
 
@@ -328,12 +398,12 @@ NAN_METHOD(Database::Configure) {
     if (Nan::Equals(info[0], Nan::New("trace").ToLocalChecked()).FromJust()) {
         Local<Function> handle;
         Baton* baton = new Baton(db, handle);
-        db->Schedule(RegisterTraceCallback, baton);
+        db->Schedule(RegisterTraceCallback, baton, true);
     }
     else if (Nan::Equals(info[0], Nan::New("profile").ToLocalChecked()).FromJust()) {
         Local<Function> handle;
         Baton* baton = new Baton(db, handle);
-        db->Schedule(RegisterProfileCallback, baton);
+        db->Schedule(RegisterProfileCallback, baton, true);
     }
     else if (Nan::Equals(info[0], Nan::New("busyTimeout").ToLocalChecked()).FromJust()) {
         if (!info[1]->IsInt32()) {
@@ -342,7 +412,22 @@ NAN_METHOD(Database::Configure) {
         Local<Function> handle;
         Baton* baton = new Baton(db, handle);
         baton->status = Nan::To<int>(info[1]).FromJust();
-        db->Schedule(SetBusyTimeout, baton);
+        db->Schedule(SetBusyTimeout, baton, true);
+    }
+    else if (Nan::Equals(info[0], Nan::New("maintenance").ToLocalChecked()).FromJust()) {
+        if (info[1]->IsObject()) {
+            Local<Object> options = info[1].As<Object>();
+            db->StartMaintenance(
+                IntegerOption(options, "idle", 1000),
+                IntegerOption(options, "budget", 50),
+                IntegerOption(options, "vacuumPages", 128));
+        }
+        else if (!Nan::To<bool>(info[1]).FromJust()) {
+            db->StopMaintenance();
+        }
+        else {
+            db->StartMaintenance(1000, 50, 128);
+        }
     }
     else {
         return Nan::ThrowError(Exception::Error(String::Concat(
@@ -376,7 +461,371 @@ void Database::SetBusyTimeout(Baton* baton) {
     assert(baton->db->_handle);
 
     // Abuse the status field for passing the timeout.
-    sqlite3_busy_timeout(baton->db->_handle, baton->status);
+    Database* db = baton->db;
+    db->LockHandle();
+    db->busy_timeout = baton->status;
+    sqlite3_busy_handler(db->_handle, db->busy_timeout > 0 ? BusyHandler : NULL, db);
+    db->UnlockHandle();
+
+    db->Process();
+
+    delete baton;
+}
+
+// Same as SQLite's handler for sqlite3_busy_timeout(), but counts how often
+// it waits. Called with the connection mutex held.
+int Database::BusyHandler(void* data, int count) {
+    Database* db = static_cast<Database*>(data);
+    static const int delays[] = { 1, 2, 5, 10, 15, 20, 25, 25, 25, 50, 50, 100 };
+    static const int totals[] = { 0, 1, 3, 8, 18, 33, 53, 78, 103, 128, 178, 228 };
+    static const int n = sizeof(delays) / sizeof(delays[0]);
+
+    int delay, prior;
+    if (count < n) {
+        delay = delays[count];
+        prior = totals[count];
+    }
+    else {
+        delay = delays[n - 1];
+        prior = totals[n - 1] + delay * (count - (n - 1));
+    }
+    if (prior + delay > db->busy_timeout) {
+        delay = db->busy_timeout - prior;
+        if (delay <= 0) return 0;
+    }
+
+    NODE_SQLITE3_ATOMIC_ADD(&db->busy_retries, 1);
+    sqlite3_sleep(delay);
+    return 1;
+}
+
+NAN_METHOD(Database::RegisterFunction) {
+    Database* db = Nan::ObjectWrap::Unwrap<Database>(info.This());
+
+    REQUIRE_ARGUMENT_STRING(0, name);
+    if (info.Length() < 2 || !info[1]->IsObject()) {
+        return Nan::ThrowTypeError("Argument 1 must be an object");
+    }
+    Local<Object> options = info[1].As<Object>();
+
+    Local<Value> fn = Nan::Get(options, Nan::New("fn").ToLocalChecked()).ToLocalChecked();
+    Local<Value> step = Nan::Get(options, Nan::New("step").ToLocalChecked()).ToLocalChecked();
+    bool deterministic = Nan::To<bool>(
+        Nan::Get(options, Nan::New("deterministic").ToLocalChecked()).ToLocalChecked()).FromJust();
+    int args = IntegerOption(options, "length", -1);
+    if (args < -1 || args > 127) {
+        return Nan::ThrowRangeError("Functions can take at most 127 arguments");
+    }
+
+    JSFunction* function;
+    if (fn->IsFunction()) {
+        function = new JSFunction(*name, deterministic, fn.As<Function>());
+    }
+    else if (step->IsFunction()) {
+        function = new JSFunction(*name, deterministic,
+            Nan::Get(options, Nan::New("start").ToLocalChecked()).ToLocalChecked(),
+            step.As<Function>(),
+            Nan::Get(options, Nan::New("result").ToLocalChecked()).ToLocalChecked());
+    }
+    else {
+        return Nan::ThrowTypeError("Either fn or step must be a function");
+    }
+
+    // Exclusive, so that no query is using the function it may replace.
+    Baton* baton = new FunctionBaton(db, function, args);
+    db->Schedule(Work_RegisterFunction, baton, true);
+
+    info.GetReturnValue().Set(info.This());
+}
+
+void Database::Work_RegisterFunction(Baton* b) {
+    Nan::HandleScope scope;
+
+    FunctionBaton* baton = static_cast<FunctionBaton*>(b);
+    Database* db = baton->db;
+
+    assert(db->locked);
+    assert(db->open);
+    assert(db->_handle);
+    assert(db->pending == 0);
+
+    // Kept until the connection is closed, even if it is replaced later.
+    db->functions.push_back(baton->function);
+    baton->status = baton->function->Register(db->_handle, baton->args);
+
+    if (baton->status != SQLITE_OK) {
+        EXCEPTION(Nan::New(sqlite3_errmsg(db->_handle)).ToLocalChecked(), baton->status, exception);
+        Local<Value> info[] = { Nan::New("error").ToLocalChecked(), exception };
+        EMIT_EVENT(db->handle(), 2, info);
+    }
+
+    db->Process();
+
+    delete baton;
+}
+
+void Database::FreeFunctions() {
+    for (std::vector<JSFunction*>::iterator it = functions.begin(); it < functions.end(); ++it) {
+        delete *it;
+    }
+    functions.clear();
+}
+
+void Database::LockHandle() {
+    if (_handle == NULL) return;
+    EnterMutex(sqlite3_db_mutex(_handle), main_wait);
+}
+
+void Database::UnlockHandle() {
+    if (_handle == NULL) return;
+    sqlite3_mutex_leave(sqlite3_db_mutex(_handle));
+}
+
+void Database::AddOrphan(sqlite3_stmt* handle) {
+    uv_mutex_lock(&orphans_mutex);
+    orphans.insert(handle);
+    uv_mutex_unlock(&orphans_mutex);
+}
+
+void Database::FinalizeOrphan(sqlite3_stmt* handle, LockWait& wait) {
+    // Note: This function is called in the thread pool.
+    uv_mutex_lock(&orphans_mutex);
+    if (orphans.erase(handle)) {
+        sqlite3_mutex* mtx = sqlite3_db_mutex(_handle);
+        EnterMutex(mtx, wait);
+        sqlite3_finalize(handle);
+        sqlite3_mutex_leave(mtx);
+    }
+    uv_mutex_unlock(&orphans_mutex);
+}
+
+void Database::FinalizeOrphans() {
+    uv_mutex_lock(&orphans_mutex);
+    for (std::set<sqlite3_stmt*>::iterator it = orphans.begin(); it != orphans.end(); ++it) {
+        sqlite3_finalize(*it);
+    }
+    orphans.clear();
+    uv_mutex_unlock(&orphans_mutex);
+}
+
+void Database::StartMaintenance(int idle, int budget, int vacuum_pages) {
+    maintenance_idle = idle;
+    maintenance_budget = budget;
+    maintenance_vacuum_pages = vacuum_pages;
+    maintenance_settled = false;
+
+    if (maintenance_timer == NULL) {
+        maintenance_timer = new uv_timer_t;
+        uv_timer_init(uv_default_loop(), maintenance_timer);
+        maintenance_timer->data = this;
+        // Maintenance alone shouldn't keep the process alive.
+        uv_unref(reinterpret_cast<uv_handle_t*>(maintenance_timer));
+    }
+
+    if (open && !closing && pending == 0 && queue.empty()) {
+        ArmMaintenance();
+    }
+}
+
+void Database::StopMaintenance() {
+    if (maintenance_timer) {
+        uv_timer_stop(maintenance_timer);
+        uv_close(reinterpret_cast<uv_handle_t*>(maintenance_timer), MaintenanceTimerClosed);
+        maintenance_timer = NULL;
+    }
+
+    if (maintenance_counting && _handle) {
+        // Queries may hold the connection; wait for them in the queue.
+        if (pending == 0) StopCounting();
+        else Schedule(Work_StopCounting, new Baton(this, Local<Function>()), true);
+    }
+}
+
+void Database::StopCounting() {
+    LockHandle();
+    sqlite3_update_hook(_handle, update_event ? UpdateCallback : NULL, this);
+    maintenance_counting = false;
+    maintenance_written.clear();
+    maintenance_analyzed.clear();
+    UnlockHandle();
+}
+
+void Database::Work_StopCounting(Baton* baton) {
+    Database* db = baton->db;
+    if (db->maintenance_counting && db->maintenance_timer == NULL) {
+        db->StopCounting();
+    }
+    db->Process();
+    delete baton;
+}
+
+// Called for all work on the connection, including statements, which are
+// scheduled without going through Schedule(): postpones maintenance and
+// cuts a running slice short.
+void Database::PostponeMaintenance() {
+    if (maintenance_timer) {
+        uv_timer_stop(maintenance_timer);
+        maintenance_settled = false;
+        if (maintenance_running) maintenance_preempt = true;
+    }
+}
+
+void Database::MaintenanceTimerClosed(uv_handle_t* handle) {
+    delete reinterpret_cast<uv_timer_t*>(handle);
+}
+
+void Database::ArmMaintenance() {
+    if (maintenance_timer && !maintenance_running && !maintenance_settled) {
+        uv_timer_start(maintenance_timer,
+            reinterpret_cast<uv_timer_cb>(MaintenanceTimer), maintenance_idle, 0);
+    }
+}
+
+void Database::MaintenanceTimer(uv_timer_t* handle, int status) {
+    Database* db = static_cast<Database*>(handle->data);
+
+    if (!db->open || db->closing || db->pending > 0 || !db->queue.empty()) {
+        return;
+    }
+
+    if (!db->maintenance_counting) {
+        // Count writes per table from now on; the first round analyzes all
+        // tables anyway.
+        db->LockHandle();
+        sqlite3_update_hook(db->_handle, UpdateCallback, db);
+        db->maintenance_counting = true;
+        db->UnlockHandle();
+    }
+
+    db->maintenance_running = true;
+    db->maintenance_preempt = false;
+    db->Schedule(Work_BeginMaintenance, new MaintenanceBaton(db), true);
+}
+
+void Database::Work_BeginMaintenance(Baton* baton) {
+    assert(baton->db->open);
+    assert(baton->db->_handle);
+    // Counts as pending work so that exclusive operations like close wait.
+    baton->db->pending++;
+    int status = Timeline::Queue(&baton->request, "Database.Maintenance",
+        Work_Maintenance, (uv_after_work_cb)Work_AfterMaintenance);
+    assert(status == 0);
+}
+
+int Database::MaintenanceProgress(void* data) {
+    // Note: This function is called in the thread pool.
+    Database* db = static_cast<Database*>(data);
+    return db->maintenance_preempt || uv_hrtime() > db->maintenance_deadline;
+}
+
+// Runs one step of maintenance. The progress handler is only installed
+// while the connection mutex is held for that step, so it can't interrupt
+// statements that run on the connection in between.
+int Database::MaintenanceExec(Database* db, const char* sql, LockWait& wait) {
+    sqlite3_mutex* mtx = sqlite3_db_mutex(db->_handle);
+    EnterMutex(mtx, wait);
+    sqlite3_progress_handler(db->_handle, 100, MaintenanceProgress, db);
+    int status = sqlite3_exec(db->_handle, sql, NULL, NULL, NULL);
+    sqlite3_progress_handler(db->_handle, 0, NULL, NULL);
+    sqlite3_mutex_leave(mtx);
+    return status;
+}
+
+static int QueryInteger(sqlite3* handle, const char* sql) {
+    sqlite3_stmt* stmt = NULL;
+    int value = -1;
+    if (sqlite3_prepare_v2(handle, sql, -1, &stmt, NULL) == SQLITE_OK &&
+            sqlite3_step(stmt) == SQLITE_ROW) {
+        value = sqlite3_column_int(stmt, 0);
+    }
+    sqlite3_finalize(stmt);
+    return value;
+}
+
+void Database::Work_Maintenance(uv_work_t* req) {
+    MaintenanceBaton* baton = static_cast<MaintenanceBaton*>(req->data);
+    Database* db = baton->db;
+    sqlite3* handle = db->_handle;
+
+    db->maintenance_deadline = uv_hrtime() + (uint64_t)db->maintenance_budget * 1000000;
+    sqlite3_mutex* mtx = sqlite3_db_mutex(handle);
+
+    // Only does something with SQLite 3.18 and later; older versions ignore
+    // unknown pragmas.
+    int status = MaintenanceExec(db, "PRAGMA optimize", baton->request.lock_wait);
+    baton->optimized = status == SQLITE_OK;
+    baton->interrupted = status == SQLITE_INTERRUPT;
+
+    // Analyze the next table in turn, unless nothing was written to it
+    // through this connection since it was last analyzed.
+    std::vector<std::string> tables;
+    sqlite3_stmt* stmt = NULL;
+    if (!baton->interrupted && sqlite3_prepare_v2(handle,
+            "SELECT name FROM sqlite_master WHERE type = 'table' AND name NOT LIKE 'sqlite_%' ORDER BY name",
+            -1, &stmt, NULL) == SQLITE_OK) {
+        while (sqlite3_step(stmt) == SQLITE_ROW) {
+            tables.push_back(std::string((const char*)sqlite3_column_text(stmt, 0)));
+        }
+    }
+    sqlite3_finalize(stmt);
+
+    for (unsigned int i = 0; i < tables.size() && !baton->interrupted; i++) {
+        std::string& table = tables[db->maintenance_table++ % tables.size()];
+        EnterMutex(mtx, baton->request.lock_wait);
+        int written = db->maintenance_written[table];
+        std::map<std::string, int>::iterator it = db->maintenance_analyzed.find(table);
+        bool unchanged = it != db->maintenance_analyzed.end() && it->second == written;
+        // Don't retry a table that doesn't fit into the budget until the next
+        // round; otherwise it would starve all others.
+        db->maintenance_analyzed[table] = written;
+        sqlite3_mutex_leave(mtx);
+        if (unchanged) continue;
+
+        char* sql = sqlite3_mprintf("ANALYZE \"%w\"", table.c_str());
+        status = MaintenanceExec(db, sql, baton->request.lock_wait);
+        sqlite3_free(sql);
+        baton->interrupted = status == SQLITE_INTERRUPT;
+        if (status == SQLITE_OK) baton->analyzed = table;
+        break;
+    }
+
+    if (!baton->interrupted && db->maintenance_vacuum_pages > 0 &&
+            QueryInteger(handle, "PRAGMA auto_vacuum") == 2) {
+        int before = QueryInteger(handle, "PRAGMA freelist_count");
+        if (before > 0) {
+            char* sql = sqlite3_mprintf("PRAGMA incremental_vacuum(%d)", db->maintenance_vacuum_pages);
+            status = MaintenanceExec(db, sql, baton->request.lock_wait);
+            sqlite3_free(sql);
+            baton->interrupted = status == SQLITE_INTERRUPT;
+            baton->vacuumed = before - QueryInteger(handle, "PRAGMA freelist_count");
+        }
+    }
+
+    baton->settled = !baton->interrupted && baton->analyzed.empty() && baton->vacuumed <= 0;
+}
+
+void Database::Work_AfterMaintenance(uv_work_t* req) {
+    Nan::HandleScope scope;
+
+    MaintenanceBaton* baton = static_cast<MaintenanceBaton*>(req->data);
+    Database* db = baton->db;
+
+    db->maintenance_running = false;
+    db->pending--;
+    // Wait for new work before running another slice that has nothing to do.
+    if (baton->settled) db->maintenance_settled = true;
+
+    Local<Object> result = Nan::New<Object>();
+    Nan::Set(result, Nan::New("optimized").ToLocalChecked(), Nan::New(baton->optimized));
+    Nan::Set(result, Nan::New("analyzed").ToLocalChecked(), baton->analyzed.empty() ?
+        Local<Value>(Nan::Null()) : Local<Value>(Nan::New(baton->analyzed.c_str()).ToLocalChecked()));
+    Nan::Set(result, Nan::New("vacuumed").ToLocalChecked(), Nan::New(baton->vacuumed));
+    Nan::Set(result, Nan::New("interrupted").ToLocalChecked(), Nan::New(baton->interrupted));
+
+    Local<Value> argv[] = { Nan::New("maintenance").ToLocalChecked(), result };
+    EMIT_EVENT(db->handle(), 2, argv);
+
+    db->Process();
 
     delete baton;
 }
@@ -389,15 +838,22 @@ void Database::RegisterTraceCallback(Baton* baton) {
     if (db->debug_trace == NULL) {
         // Add it.
         db->debug_trace = new AsyncTrace(db, TraceCallback);
+        db->LockHandle();
         sqlite3_trace(db->_handle, TraceCallback, db);
+        db->UnlockHandle();
     }
     else {
         // Remove it.
+        db->LockHandle();
         sqlite3_trace(db->_handle, NULL, NULL);
+        db->UnlockHandle();
+        db->events_wait.Add(db->debug_trace->LockStats());
         db->debug_trace->finish();
         db->debug_trace = NULL;
     }
 
+    db->Process();
+
     delete baton;
 }
 
@@ -427,15 +883,22 @@ void Database::RegisterProfileCallback(Baton* baton) {
     if (db->debug_profile == NULL) {
         // Add it.
         db->debug_profile = new AsyncProfile(db, ProfileCallback);
+        db->LockHandle();
         sqlite3_profile(db->_handle, ProfileCallback, db);
+        db->UnlockHandle();
     }
     else {
         // Remove it.
+        db->LockHandle();
         sqlite3_profile(db->_handle, NULL, NULL);
+        db->UnlockHandle();
+        db->events_wait.Add(db->debug_profile->LockStats());
         db->debug_profile->finish();
         db->debug_profile = NULL;
     }
 
+    db->Process();
+
     delete baton;
 }
 
@@ -465,18 +928,28 @@ void Database::RegisterUpdateCallback(Baton* baton) {
     assert(baton->db->_handle);
     Database* db = baton->db;
 
+    // The hook stays installed while maintenance counts writes.
     if (db->update_event == NULL) {
         // Add it.
-        db->update_event = new AsyncUpdate(db, UpdateCallback);
+        AsyncUpdate* event = new AsyncUpdate(db, UpdateCallback);
+        db->LockHandle();
+        db->update_event = event;
         sqlite3_update_hook(db->_handle, UpdateCallback, db);
+        db->UnlockHandle();
     }
     else {
         // Remove it.
-        sqlite3_update_hook(db->_handle, NULL, NULL);
-        db->update_event->finish();
+        AsyncUpdate* event = db->update_event;
+        db->LockHandle();
         db->update_event = NULL;
+        sqlite3_update_hook(db->_handle, db->maintenance_counting ? UpdateCallback : NULL, db);
+        db->UnlockHandle();
+        db->events_wait.Add(event->LockStats());
+        event->finish();
     }
 
+    db->Process();
+
     delete baton;
 }
 
@@ -484,12 +957,18 @@ void Database::UpdateCallback(void* db, int type, const char* database,
         const char* table, sqlite3_int64 rowid) {
     // Note: This function is called in the thread pool.
     // Note: Some queries, such as "EXPLAIN" queries, are not sent through this.
+    Database* self = static_cast<Database*>(db);
+    if (self->maintenance_counting && strcmp(database, "main") == 0) {
+        self->maintenance_written[table]++;
+    }
+    if (self->update_event == NULL) return;
+
     UpdateInfo* info = new UpdateInfo();
     info->type = type;
     info->database = std::string(database);
     info->table = std::string(table);
     info->rowid = rowid;
-    static_cast<Database*>(db)->update_event->send(info);
+    self->update_event->send(info);
 }
 
 void Database::UpdateCallback(Database *db, UpdateInfo* info) {
@@ -517,19 +996,51 @@ NAN_METHOD(Database::Exec) {
     info.GetReturnValue().Set(info.This());
 }
 
+#ifdef NODE_SQLITE3_PROMISES
+
+NAN_METHOD(Database::ExecAsync) {
+    Database* db = Nan::ObjectWrap::Unwrap<Database>(info.This());
+
+    REQUIRE_ARGUMENT_STRING(0, sql);
+
+    Local<PromiseResolver> resolver = NewResolver();
+    Baton* baton = new ExecBaton(db, Local<Function>(), *sql);
+    baton->resolver.Reset(resolver);
+    db->Schedule(Work_BeginExec, baton, true);
+
+    info.GetReturnValue().Set(resolver->GetPromise());
+}
+
+NAN_METHOD(Database::CloseAsync) {
+    Database* db = Nan::ObjectWrap::Unwrap<Database>(info.This());
+
+    Local<PromiseResolver> resolver = NewResolver();
+    Baton* baton = new Baton(db, Local<Function>());
+    baton->resolver.Reset(resolver);
+    db->Schedule(Work_BeginClose, baton, true);
+
+    info.GetReturnValue().Set(resolver->GetPromise());
+}
+
+#endif
+
 void Database::Work_BeginExec(Baton* baton) {
     assert(baton->db->locked);
     assert(baton->db->open);
     assert(baton->db->_handle);
     assert(baton->db->pending == 0);
-    int status = uv_queue_work(uv_default_loop(),
-        &baton->request, Work_Exec, (uv_after_work_cb)Work_AfterExec);
+    int status = Timeline::Queue(&baton->request, "Database.Exec",
+        Work_Exec, (uv_after_work_cb)Work_AfterExec);
     assert(status == 0);
 }
 
 void Database::Work_Exec(uv_work_t* req) {
     ExecBaton* baton = static_cast<ExecBaton*>(req->data);
 
+    // sqlite3_exec() holds the connection mutex throughout; entering it
+    // first only measures the wait.
+    sqlite3_mutex* mtx = sqlite3_db_mutex(baton->db->_handle);
+    EnterMutex(mtx, baton->request.lock_wait);
     char* message = NULL;
     baton->status = sqlite3_exec(
         baton->db->_handle,
@@ -538,6 +1049,7 @@ void Database::Work_Exec(uv_work_t* req) {
         NULL,
         &message
     );
+    sqlite3_mutex_leave(mtx);
 
     if (baton->status != SQLITE_OK && message != NULL) {
         baton->message = std::string(message);
@@ -556,7 +1068,10 @@ void Database::Work_AfterExec(uv_work_t* req) {
     if (baton->status != SQLITE_OK) {
         EXCEPTION(Nan::New(baton->message.c_str()).ToLocalChecked(), baton->status, exception);
 
-        if (!cb.IsEmpty() && cb->IsFunction()) {
+        if (!baton->resolver.IsEmpty()) {
+            SettlePromise(db->handle(), baton->resolver, exception, true);
+        }
+        else if (!cb.IsEmpty() && cb->IsFunction()) {
             Local<Value> argv[] = { exception };
             TRY_CATCH_CALL(db->handle(), cb, 1, argv);
         }
@@ -565,6 +1080,9 @@ void Database::Work_AfterExec(uv_work_t* req) {
             EMIT_EVENT(db->handle(), 2, info);
         }
     }
+    else if (!baton->resolver.IsEmpty()) {
+        SettlePromise(db->handle(), baton->resolver, Nan::Undefined());
+    }
     else if (!cb.IsEmpty() && cb->IsFunction()) {
         Local<Value> argv[] = { Nan::Null() };
         TRY_CATCH_CALL(db->handle(), cb, 1, argv);
@@ -575,6 +1093,124 @@ void Database::Work_AfterExec(uv_work_t* req) {
     delete baton;
 }
 
+NAN_METHOD(Database::PinSnapshot) {
+    Database* db = Nan::ObjectWrap::Unwrap<Database>(info.This());
+
+    Database* source = NULL;
+    int pos = 0;
+    if (info.Length() > pos && Database::HasInstance(info[pos])) {
+        source = Nan::ObjectWrap::Unwrap<Database>(info[pos++].As<Object>());
+    }
+    OPTIONAL_ARGUMENT_FUNCTION(pos, callback);
+
+    Baton* baton = new SnapshotBaton(db, callback, source);
+    db->Schedule(Work_BeginPinSnapshot, baton, true);
+
+    info.GetReturnValue().Set(info.This());
+}
+
+void Database::Work_BeginPinSnapshot(Baton* baton) {
+    assert(baton->db->locked);
+    assert(baton->db->open);
+    assert(baton->db->_handle);
+    assert(baton->db->pending == 0);
+    int status = Timeline::Queue(&baton->request, "Database.PinSnapshot",
+        Work_PinSnapshot, (uv_after_work_cb)Work_AfterPinSnapshot);
+    assert(status == 0);
+}
+
+void Database::Work_PinSnapshot(uv_work_t* req) {
+    SnapshotBaton* baton = static_cast<SnapshotBaton*>(req->data);
+    Database* db = baton->db;
+
+    // Opening a snapshot must be the first operation after BEGIN, but the
+    // connection needs prior I/O to know that the file is in WAL mode. A
+    // fresh snapshot instead needs an open read transaction.
+    char* message = NULL;
+    baton->status = sqlite3_exec(db->_handle, baton->source ?
+        "PRAGMA application_id; BEGIN" :
+        "BEGIN; SELECT count(*) FROM sqlite_master",
+        NULL, NULL, &message);
+
+    if (baton->status != SQLITE_OK) {
+        if (message != NULL) {
+            baton->message = std::string(message);
+            sqlite3_free(message);
+        }
+        return;
+    }
+
+#ifdef SQLITE_ENABLE_SNAPSHOT
+    if (baton->source) {
+        if (baton->source->snapshot == NULL) {
+            baton->status = SQLITE_MISUSE;
+            baton->message = "Source database has no snapshot";
+        }
+        else {
+            baton->status = sqlite3_snapshot_open(db->_handle, "main", baton->source->snapshot);
+            if (baton->status != SQLITE_OK) {
+                baton->message = std::string(sqlite3_errmsg(db->_handle));
+            }
+        }
+    }
+    else {
+        // This only succeeds for WAL databases. Otherwise the read transaction
+        // is still pinned, but can't be shared with other connections.
+        db->FreeSnapshot();
+        baton->shared = sqlite3_snapshot_get(db->_handle, "main", &db->snapshot) == SQLITE_OK;
+        if (!baton->shared) db->snapshot = NULL;
+    }
+#else
+    if (baton->source) {
+        baton->status = SQLITE_ERROR;
+        baton->message = "SQLite was compiled without snapshot support";
+    }
+#endif
+
+    if (baton->status != SQLITE_OK) {
+        sqlite3_exec(db->_handle, "ROLLBACK", NULL, NULL, NULL);
+    }
+}
+
+void Database::Work_AfterPinSnapshot(uv_work_t* req) {
+    Nan::HandleScope scope;
+
+    SnapshotBaton* baton = static_cast<SnapshotBaton*>(req->data);
+    Database* db = baton->db;
+
+    Local<Function> cb = Nan::New(baton->callback);
+
+    if (baton->status != SQLITE_OK) {
+        EXCEPTION(Nan::New(baton->message.c_str()).ToLocalChecked(), baton->status, exception);
+
+        if (!cb.IsEmpty() && cb->IsFunction()) {
+            Local<Value> argv[] = { exception };
+            TRY_CATCH_CALL(db->handle(), cb, 1, argv);
+        }
+        else {
+            Local<Value> info[] = { Nan::New("error").ToLocalChecked(), exception };
+            EMIT_EVENT(db->handle(), 2, info);
+        }
+    }
+    else if (!cb.IsEmpty() && cb->IsFunction()) {
+        Local<Value> argv[] = { Nan::Null(), Nan::New(baton->shared) };
+        TRY_CATCH_CALL(db->handle(), cb, 2, argv);
+    }
+
+    db->Process();
+
+    delete baton;
+}
+
+void Database::FreeSnapshot() {
+#ifdef SQLITE_ENABLE_SNAPSHOT
+    if (snapshot) {
+        sqlite3_snapshot_free(snapshot);
+        snapshot = NULL;
+    }
+#endif
+}
+
 NAN_METHOD(Database::Wait) {
     Database* db = Nan::ObjectWrap::Unwrap<Database>(info.This());
 
@@ -622,8 +1258,8 @@ void Database::Work_BeginLoadExtension(Baton* baton) {
     assert(baton->db->open);
     assert(baton->db->_handle);
     assert(baton->db->pending == 0);
-    int status = uv_queue_work(uv_default_loop(),
-        &baton->request, Work_LoadExtension, reinterpret_cast<uv_after_work_cb>(Work_AfterLoadExtension));
+    int status = Timeline::Queue(&baton->request, "Database.LoadExtension",
+        Work_LoadExtension, reinterpret_cast<uv_after_work_cb>(Work_AfterLoadExtension));
     assert(status == 0);
 }
 
@@ -677,12 +1313,268 @@ void Database::Work_AfterLoadExtension(uv_work_t* req) {
     delete baton;
 }
 
+NAN_METHOD(Database::IntegrityCheck) {
+    Database* db = Nan::ObjectWrap::Unwrap<Database>(info.This());
+
+    bool quick = info.Length() > 0 && Nan::To<bool>(info[0]).FromJust();
+    OPTIONAL_ARGUMENT_INTEGER(1, max_errors, 100);
+    OPTIONAL_ARGUMENT_INTEGER(2, pages_per_slice, 1000);
+    // -1 pauses 10 ms in WAL mode and not at all otherwise.
+    OPTIONAL_ARGUMENT_INTEGER(3, pause, -1);
+    OPTIONAL_ARGUMENT_FUNCTION(4, callback);
+
+    if (max_errors <= 0 || pages_per_slice <= 0 || pause < -1) {
+        return Nan::ThrowRangeError("Integrity check options must be positive");
+    }
+
+    IntegrityCheckBaton* baton = new IntegrityCheckBaton(db, callback, quick,
+        max_errors, pages_per_slice, pause);
+    baton->progress = new AsyncIntegrity(db, IntegrityCheckProgress);
+    db->Schedule(Work_BeginIntegrityCheck, baton, true);
+
+    info.GetReturnValue().Set(info.This());
+}
+
+void Database::Work_BeginIntegrityCheck(Baton* baton) {
+    assert(baton->db->locked);
+    assert(baton->db->open);
+    assert(baton->db->_handle);
+    assert(baton->db->pending == 0);
+    int status = Timeline::Queue(&baton->request, "Database.IntegrityCheck",
+        Work_IntegrityCheck, (uv_after_work_cb)Work_AfterIntegrityCheck);
+    assert(status == 0);
+}
+
+void Database::Work_IntegrityCheck(uv_work_t* req) {
+    IntegrityCheckBaton* baton = static_cast<IntegrityCheckBaton*>(req->data);
+    sqlite3* handle = baton->db->_handle;
+
+    sqlite3_mutex* mtx = sqlite3_db_mutex(handle);
+    EnterMutex(mtx, baton->request.lock_wait);
+
+    // The whole check reads one snapshot, so the journal mode can't change
+    // while it runs.
+    baton->status = sqlite3_exec(handle, "BEGIN", NULL, NULL, NULL);
+
+    sqlite3_stmt* stmt = NULL;
+    if (baton->status == SQLITE_OK) {
+        baton->status = sqlite3_prepare_v2(handle, "PRAGMA page_count", -1, &stmt, NULL);
+    }
+    if (baton->status == SQLITE_OK && sqlite3_step(stmt) == SQLITE_ROW) {
+        baton->total_pages = sqlite3_column_int(stmt, 0);
+    }
+    sqlite3_finalize(stmt);
+    stmt = NULL;
+
+    // Outside of WAL mode, the shared lock held during a pause keeps every
+    // writer out, so pausing would only make writers wait longer.
+    bool wal = false;
+    if (baton->status == SQLITE_OK) {
+        baton->status = sqlite3_prepare_v2(handle, "PRAGMA journal_mode", -1, &stmt, NULL);
+    }
+    if (baton->status == SQLITE_OK && sqlite3_step(stmt) == SQLITE_ROW) {
+        wal = sqlite3_stricmp((const char*)sqlite3_column_text(stmt, 0), "wal") == 0;
+    }
+    sqlite3_finalize(stmt);
+    stmt = NULL;
+
+    bool misuse = false;
+    if (baton->pause < 0) {
+        baton->pause = wal ? 10 : 0;
+    }
+    else if (baton->pause > 0 && !wal && baton->status == SQLITE_OK) {
+        baton->status = SQLITE_MISUSE;
+        misuse = true;
+    }
+
+    // Pages are counted as cache misses of this connection, which starts
+    // with an empty cache.
+    int highwater;
+    sqlite3_db_status(handle, SQLITE_DBSTATUS_CACHE_MISS, &baton->slice_start, &highwater, 0);
+
+    if (baton->status == SQLITE_OK) {
+        char* sql = sqlite3_mprintf("PRAGMA %s(%d)",
+            baton->quick ? "quick_check" : "integrity_check", baton->max_errors);
+        baton->status = sqlite3_prepare_v2(handle, sql, -1, &stmt, NULL);
+        sqlite3_free(sql);
+    }
+
+    if (baton->status == SQLITE_OK) {
+        sqlite3_progress_handler(handle, 1000, IntegrityCheckProgress, baton);
+        while ((baton->status = sqlite3_step(stmt)) == SQLITE_ROW) {
+            // Older versions of SQLite report all problems in one row.
+            std::string text((const char*)sqlite3_column_text(stmt, 0));
+            size_t start = 0;
+            while (start <= text.size()) {
+                size_t end = text.find('\n', start);
+                if (end == std::string::npos) end = text.size();
+                if (end > start) baton->problems.push_back(text.substr(start, end - start));
+                start = end + 1;
+            }
+        }
+        sqlite3_progress_handler(handle, 0, NULL, NULL);
+        if (baton->status == SQLITE_DONE) baton->status = SQLITE_OK;
+    }
+
+    if (baton->problems.size() == 1 && baton->problems[0] == "ok") {
+        baton->problems.clear();
+    }
+    if (misuse) {
+        baton->message = "Pausing an integrity check requires WAL mode";
+    }
+    else if (baton->status != SQLITE_OK) {
+        baton->message = std::string(sqlite3_errmsg(handle));
+    }
+    sqlite3_finalize(stmt);
+
+    // An interrupted check has already rolled back.
+    if (!sqlite3_get_autocommit(handle)) {
+        sqlite3_exec(handle, "COMMIT", NULL, NULL, NULL);
+    }
+
+    sqlite3_mutex_leave(mtx);
+}
+
+// Called every 1000 virtual machine instructions of the check. Ends a slice
+// when enough pages were read since the last one.
+int Database::IntegrityCheckProgress(void* data) {
+    // Note: This function is called in the thread pool.
+    IntegrityCheckBaton* baton = static_cast<IntegrityCheckBaton*>(data);
+    int pages, highwater;
+    sqlite3_db_status(baton->db->_handle, SQLITE_DBSTATUS_CACHE_MISS, &pages, &highwater, 0);
+    if (pages - baton->slice_start < baton->pages_per_slice) return 0;
+
+    baton->slice_start = pages;
+    IntegrityProgress* info = new IntegrityProgress();
+    // Pages that were evicted and read again count twice.
+    info->pages = std::min(pages, baton->total_pages);
+    info->total = baton->total_pages;
+    baton->progress->send(info);
+    if (baton->pause > 0) sqlite3_sleep(baton->pause);
+    return 0;
+}
+
+void Database::IntegrityCheckProgress(Database* db, IntegrityProgress* info) {
+    // Note: This function is called in the main V8 thread.
+    Nan::HandleScope scope;
+
+    Local<Value> argv[] = {
+        Nan::New("integrityProgress").ToLocalChecked(),
+        Nan::New<Integer>(info->pages),
+        Nan::New<Integer>(info->total)
+    };
+    EMIT_EVENT(db->handle(), 3, argv);
+    delete info;
+}
+
+void Database::Work_AfterIntegrityCheck(uv_work_t* req) {
+    Nan::HandleScope scope;
+
+    IntegrityCheckBaton* baton = static_cast<IntegrityCheckBaton*>(req->data);
+    Database* db = baton->db;
+    Local<Function> cb = Nan::New(baton->callback);
+
+    // Delivers the last progress events before the callback.
+    db->events_wait.Add(baton->progress->LockStats());
+    baton->progress->finish();
+    baton->progress = NULL;
+
+    if (baton->status != SQLITE_OK) {
+        EXCEPTION(Nan::New(baton->message.c_str()).ToLocalChecked(), baton->status, exception);
+
+        if (!cb.IsEmpty() && cb->IsFunction()) {
+            Local<Value> argv[] = { exception };
+            TRY_CATCH_CALL(db->handle(), cb, 1, argv);
+        }
+        else {
+            Local<Value> info[] = { Nan::New("error").ToLocalChecked(), exception };
+            EMIT_EVENT(db->handle(), 2, info);
+        }
+    }
+    else if (!cb.IsEmpty() && cb->IsFunction()) {
+        Local<Array> problems = Nan::New<Array>(baton->problems.size());
+        for (unsigned int i = 0; i < baton->problems.size(); i++) {
+            Nan::Set(problems, i, Nan::New(baton->problems[i].c_str()).ToLocalChecked());
+        }
+        Local<Value> argv[] = { Nan::Null(), problems };
+        TRY_CATCH_CALL(db->handle(), cb, 2, argv);
+    }
+
+    db->Process();
+
+    delete baton;
+}
+
+int Database::AuthorizeCallback(void* data, int action, const char* arg1, const char* arg2,
+                                const char* database, const char* trigger) {
+    // Note: This function is called in the thread pool.
+    Database* db = static_cast<Database*>(data);
+    if (db->table_access == NULL) return SQLITE_OK;
+
+    TableAccess access;
+    switch (action) {
+        case SQLITE_READ: access.write = false; break;
+        case SQLITE_INSERT:
+        case SQLITE_UPDATE:
+        case SQLITE_DELETE: access.write = true; break;
+        default: return SQLITE_OK;
+    }
+    access.table = arg1;
+    if (database && strcmp(database, "main") != 0) {
+        access.table = std::string(database) + "." + access.table;
+    }
+    if (arg2) access.column = arg2;
+    db->table_access->push_back(access);
+    return SQLITE_OK;
+}
+
+static Local<Array> ColumnsToJS(const std::set<std::string>& columns) {
+    Local<Array> result = Nan::New<Array>(columns.size());
+    int i = 0;
+    for (std::set<std::string>::const_iterator it = columns.begin(); it != columns.end(); ++it, i++) {
+        Nan::Set(result, i, Nan::New(it->c_str()).ToLocalChecked());
+    }
+    return result;
+}
+
+NAN_METHOD(Database::GetTableStats) {
+    Database* db = Nan::ObjectWrap::Unwrap<Database>(info.This());
+    bool reset = info.Length() > 0 && Nan::To<bool>(info[0]).FromJust();
+
+    Local<Object> result = Nan::New<Object>();
+    for (std::map<std::string, TableStats>::iterator it = db->table_stats.begin();
+            it != db->table_stats.end(); ++it) {
+        TableStats& stats = it->second;
+        Local<Object> table = Nan::New<Object>();
+        Nan::Set(table, Nan::New("reads").ToLocalChecked(), Nan::New<Number>(stats.reads));
+        Nan::Set(table, Nan::New("writes").ToLocalChecked(), Nan::New<Number>(stats.writes));
+        Nan::Set(table, Nan::New("changes").ToLocalChecked(), Nan::New<Number>(stats.changes));
+        Nan::Set(table, Nan::New("fullscanSteps").ToLocalChecked(), Nan::New<Number>(stats.fullscan_steps));
+        Nan::Set(table, Nan::New("sorts").ToLocalChecked(), Nan::New<Number>(stats.sorts));
+        Nan::Set(table, Nan::New("vmSteps").ToLocalChecked(), Nan::New<Number>(stats.vm_steps));
+        Nan::Set(table, Nan::New("readColumns").ToLocalChecked(), ColumnsToJS(stats.read_columns));
+        Nan::Set(table, Nan::New("writtenColumns").ToLocalChecked(), ColumnsToJS(stats.written_columns));
+        Nan::Set(result, Nan::New(it->first.c_str()).ToLocalChecked(), table);
+
+        if (reset) {
+            // Only the counters: statements still point to the entry and
+            // the columns are only collected when preparing.
+            stats.reads = stats.writes = stats.changes = 0;
+            stats.fullscan_steps = stats.sorts = stats.vm_steps = 0;
+        }
+    }
+
+    info.GetReturnValue().Set(result);
+}
+
 void Database::RemoveCallbacks() {
     if (debug_trace) {
+        events_wait.Add(debug_trace->LockStats());
         debug_trace->finish();
         debug_trace = NULL;
     }
     if (debug_profile) {
+        events_wait.Add(debug_profile->LockStats());
         debug_profile->finish();
         debug_profile = NULL;
     }
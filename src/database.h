@@ -5,17 +5,26 @@
 
 #include <string>
 #include <queue>
+#include <map>
+#include <set>
+#include <vector>
 
 #include <sqlite3.h>
 #include <nan.h>
 
 #include "async.h"
+#include "debug_stats.h"
+#include "metrics.h"
+#include "pool.h"
+#include "promise.h"
+#include "timeline.h"
 
 using namespace v8;
 
 namespace node_sqlite3 {
 
 class Database;
+class JSFunction;
 
 
 class Database : public Nan::ObjectWrap {
@@ -31,21 +40,26 @@ public:
     }
 
     struct Baton {
-        uv_work_t request;
+        Timeline::Request request;
         Database* db;
         Nan::Persistent<Function> callback;
+        // Set instead of the callback by promise-returning methods.
+        Nan::Persistent<PromiseResolver> resolver;
         int status;
         std::string message;
 
         Baton(Database* db_, Local<Function> cb_) :
                 db(db_), status(SQLITE_OK) {
+            DebugStats::Count(DebugStats::BATON);
             db->Ref();
             request.data = this;
+            request.Enqueue(&db->operations, db->id);
             callback.Reset(cb_);
         }
         virtual ~Baton() {
             db->Unref();
             callback.Reset();
+            resolver.Reset();
         }
     };
 
@@ -68,11 +82,43 @@ public:
             Baton(db_, cb_), filename(filename_) {}
     };
 
+    struct SnapshotBaton : Baton {
+        Database* source;
+        bool shared;
+        SnapshotBaton(Database* db_, Local<Function> cb_, Database* source_) :
+                Baton(db_, cb_), source(source_), shared(false) {
+            if (source) source->Ref();
+        }
+        virtual ~SnapshotBaton() {
+            if (source) source->Unref();
+        }
+    };
+
+    struct FunctionBaton : Baton {
+        JSFunction* function;
+        int args;
+        FunctionBaton(Database* db_, JSFunction* function_, int args_) :
+            Baton(db_, Local<Function>()), function(function_), args(args_) {}
+    };
+
+    struct MaintenanceBaton : Baton {
+        bool optimized;
+        std::string analyzed;
+        int vacuumed;
+        bool interrupted;
+        bool settled;
+        MaintenanceBaton(Database* db_) :
+            Baton(db_, Local<Function>()), optimized(false), vacuumed(0),
+            interrupted(false), settled(false) {}
+    };
+
     typedef void (*Work_Callback)(Baton* baton);
 
     struct Call {
         Call(Work_Callback cb_, Baton* baton_, bool exclusive_ = false) :
-            callback(cb_), exclusive(exclusive_), baton(baton_) {};
+                callback(cb_), exclusive(exclusive_), baton(baton_) {
+            DebugStats::Count(DebugStats::CALL);
+        };
         Work_Callback callback;
         bool exclusive;
         Baton* baton;
@@ -83,6 +129,29 @@ public:
         sqlite3_int64 nsecs;
     };
 
+    // A table or column named by the authorizer while preparing a statement.
+    struct TableAccess {
+        std::string table;
+        std::string column;
+        bool write;
+    };
+
+    // Accesses of prepared statements to one table. Executions count once
+    // for every table the statement reads or writes; statement counters are
+    // added to all tables the statement touches.
+    struct TableStats {
+        TableStats() : reads(0), writes(0), changes(0),
+            fullscan_steps(0), sorts(0), vm_steps(0) {}
+        sqlite3_int64 reads;
+        sqlite3_int64 writes;
+        sqlite3_int64 changes;
+        sqlite3_int64 fullscan_steps;
+        sqlite3_int64 sorts;
+        sqlite3_int64 vm_steps;
+        std::set<std::string> read_columns;
+        std::set<std::string> written_columns;
+    };
+
     struct UpdateInfo {
         int type;
         std::string database;
@@ -90,18 +159,53 @@ public:
         sqlite3_int64 rowid;
     };
 
+    struct IntegrityProgress {
+        int pages;
+        int total;
+    };
+
     bool IsOpen() { return open; }
     bool IsLocked() { return locked; }
 
     typedef Async<std::string, Database> AsyncTrace;
     typedef Async<ProfileInfo, Database> AsyncProfile;
     typedef Async<UpdateInfo, Database> AsyncUpdate;
+    typedef Async<IntegrityProgress, Database> AsyncIntegrity;
+
+    // Runs integrity_check or quick_check in slices of `pages_per_slice`
+    // pages read, pausing between them in WAL mode and reporting progress
+    // through `progress`.
+    struct IntegrityCheckBaton : Baton {
+        bool quick;
+        int max_errors;
+        int pages_per_slice;
+        int pause;
+        int total_pages;
+        int slice_start;
+        AsyncIntegrity* progress;
+        std::vector<std::string> problems;
+        IntegrityCheckBaton(Database* db_, Local<Function> cb_, bool quick_,
+                            int max_errors_, int pages_per_slice_, int pause_) :
+            Baton(db_, cb_), quick(quick_), max_errors(max_errors_),
+            pages_per_slice(pages_per_slice_), pause(pause_), total_pages(0),
+            slice_start(0), progress(NULL) {}
+    };
 
     friend class Statement;
+    friend class Metrics;
 
 protected:
     Database() : Nan::ObjectWrap(),
         _handle(NULL),
+        id(Timeline::NextConnection()),
+        pooled(false),
+        busy_timeout(1000),
+        busy_retries(0),
+        pending_result_bytes(0),
+        prepared(0),
+        cache_hits(0),
+        cache_misses(0),
+        cache_used(0),
         open(false),
         closing(false),
         locked(false),
@@ -109,14 +213,38 @@ protected:
         serialize(false),
         debug_trace(NULL),
         debug_profile(NULL),
-        update_event(NULL) {
+        update_event(NULL),
+        maintenance_timer(NULL),
+        maintenance_idle(0),
+        maintenance_budget(0),
+        maintenance_vacuum_pages(0),
+        maintenance_table(0),
+        maintenance_running(false),
+        maintenance_settled(false),
+        maintenance_preempt(false),
+        maintenance_deadline(0),
+        maintenance_counting(false),
+        table_access(NULL)
+#ifdef SQLITE_ENABLE_SNAPSHOT
+        , snapshot(NULL)
+#endif
+    {
+        instances.insert(this);
+        uv_mutex_init(&orphans_mutex);
     }
 
     ~Database() {
+        instances.erase(this);
         RemoveCallbacks();
-        sqlite3_close(_handle);
+        StopMaintenance();
+        FreeSnapshot();
+        FinalizeOrphans();
+        if (pooled && _handle) ConnectionPool::Release(_handle, false);
+        else sqlite3_close(_handle);
         _handle = NULL;
         open = false;
+        FreeFunctions();
+        uv_mutex_destroy(&orphans_mutex);
     }
 
     static NAN_METHOD(New);
@@ -130,6 +258,7 @@ protected:
     void Process();
 
     static NAN_METHOD(Exec);
+    static NAN_METHOD(ExecAsync);
     static void Work_BeginExec(Baton* baton);
     static void Work_Exec(uv_work_t* req);
     static void Work_AfterExec(uv_work_t* req);
@@ -138,6 +267,7 @@ protected:
     static void Work_Wait(Baton* baton);
 
     static NAN_METHOD(Close);
+    static NAN_METHOD(CloseAsync);
     static void Work_BeginClose(Baton* baton);
     static void Work_Close(uv_work_t* req);
     static void Work_AfterClose(uv_work_t* req);
@@ -147,6 +277,18 @@ protected:
     static void Work_LoadExtension(uv_work_t* req);
     static void Work_AfterLoadExtension(uv_work_t* req);
 
+    static NAN_METHOD(IntegrityCheck);
+    static void Work_BeginIntegrityCheck(Baton* baton);
+    static void Work_IntegrityCheck(uv_work_t* req);
+    static void Work_AfterIntegrityCheck(uv_work_t* req);
+    static int IntegrityCheckProgress(void* baton);
+    static void IntegrityCheckProgress(Database* db, IntegrityProgress* info);
+
+    static NAN_METHOD(PinSnapshot);
+    static void Work_BeginPinSnapshot(Baton* baton);
+    static void Work_PinSnapshot(uv_work_t* req);
+    static void Work_AfterPinSnapshot(uv_work_t* req);
+
     static NAN_METHOD(Serialize);
     static NAN_METHOD(Parallelize);
 
@@ -156,6 +298,39 @@ protected:
 
     static void SetBusyTimeout(Baton* baton);
 
+    static NAN_METHOD(RegisterFunction);
+    static void Work_RegisterFunction(Baton* baton);
+    void FreeFunctions();
+
+    // Acquires the connection mutex on the main thread. Waits are counted in
+    // main_wait. With JavaScript functions registered, a query holding the
+    // mutex may be waiting for the main thread, so this is only called when
+    // no work is pending on the connection: from exclusive work or for
+    // connections without functions.
+    void LockHandle();
+    void UnlockHandle();
+
+    // Statements handed to the thread pool for finalizing. Whichever of
+    // Statement::Work_FinalizeLater and Work_Close comes first finalizes
+    // each one.
+    void AddOrphan(sqlite3_stmt* handle);
+    void FinalizeOrphan(sqlite3_stmt* handle, LockWait& wait);
+    void FinalizeOrphans();
+
+    void StartMaintenance(int idle, int budget, int vacuum_pages);
+    void StopMaintenance();
+    void ArmMaintenance();
+    void PostponeMaintenance();
+    void StopCounting();
+    static void Work_StopCounting(Baton* baton);
+    static void MaintenanceTimer(uv_timer_t* handle, int status);
+    static void MaintenanceTimerClosed(uv_handle_t* handle);
+    static int MaintenanceProgress(void* db);
+    static int MaintenanceExec(Database* db, const char* sql, LockWait& wait);
+    static void Work_BeginMaintenance(Baton* baton);
+    static void Work_Maintenance(uv_work_t* req);
+    static void Work_AfterMaintenance(uv_work_t* req);
+
     static void RegisterTraceCallback(Baton* baton);
     static void TraceCallback(void* db, const char* sql);
     static void TraceCallback(Database* db, std::string* sql);
@@ -168,10 +343,46 @@ protected:
     static void UpdateCallback(void* db, int type, const char* database, const char* table, sqlite3_int64 rowid);
     static void UpdateCallback(Database* db, UpdateInfo* info);
 
+    static NAN_METHOD(GetTableStats);
+    static int AuthorizeCallback(void* db, int action, const char* arg1, const char* arg2,
+                                 const char* database, const char* trigger);
+    static int BusyHandler(void* db, int count);
+
+    // Results fetched on the thread pool and not yet converted to JavaScript.
+    inline void AddPendingResultBytes(int64_t bytes) {
+        if (bytes) NODE_SQLITE3_ATOMIC_ADD(&pending_result_bytes, bytes);
+    }
+
     void RemoveCallbacks();
+    void FreeSnapshot();
 
 protected:
     sqlite3* _handle;
+    // Identifies the connection in timeline spans.
+    unsigned int id;
+    // Whether _handle is borrowed from the ConnectionPool.
+    bool pooled;
+    std::string filename;
+
+    // Database objects that haven't been garbage collected, for metrics.
+    static std::set<Database*> instances;
+
+    // Milliseconds of the busy timeout, and how often BusyHandler waited.
+    int busy_timeout;
+    volatile int64_t busy_retries;
+    volatile int64_t pending_result_bytes;
+    uint64_t prepared;
+    OperationStats operations;
+    // Waits for the connection mutex in LockHandle().
+    LockWait main_wait;
+    // Waits for the row buffers of finished each() calls and the event
+    // queues of removed trace/profile/update callbacks.
+    LockWait rows_wait;
+    LockWait events_wait;
+    // Last values read from sqlite3_db_status() without blocking.
+    int cache_hits;
+    int cache_misses;
+    int cache_used;
 
     bool open;
     bool closing;
@@ -185,6 +396,41 @@ protected:
     AsyncTrace* debug_trace;
     AsyncProfile* debug_profile;
     AsyncUpdate* update_event;
+
+    // Idle-time maintenance. The timer only exists while it is enabled.
+    uv_timer_t* maintenance_timer;
+    int maintenance_idle;
+    int maintenance_budget;
+    int maintenance_vacuum_pages;
+    unsigned int maintenance_table;
+    bool maintenance_running;
+    bool maintenance_settled;
+    volatile bool maintenance_preempt;
+    uint64_t maintenance_deadline;
+    // Whether UpdateCallback counts rows written to each table of the main
+    // database in maintenance_written. Both are guarded by the connection
+    // mutex, like maintenance_analyzed, which holds the count of each table
+    // when it was last analyzed.
+    bool maintenance_counting;
+    std::map<std::string, int> maintenance_written;
+    std::map<std::string, int> maintenance_analyzed;
+
+    // Functions registered with registerFunction(). Deleted on the main
+    // thread once the connection is closed.
+    std::vector<JSFunction*> functions;
+
+    uv_mutex_t orphans_mutex;
+    std::set<sqlite3_stmt*> orphans;
+
+    // Set by the statement being prepared, while it holds the connection
+    // mutex, to collect the tables it accesses.
+    std::vector<TableAccess>* table_access;
+    // Nodes are never erased, so statements keep pointers to them.
+    std::map<std::string, TableStats> table_stats;
+
+#ifdef SQLITE_ENABLE_SNAPSHOT
+    sqlite3_snapshot* snapshot;
+#endif
 };
 
 }
@@ -0,0 +1,70 @@
+#include <string.h>
+
+#include "debug_stats.h"
+
+using namespace node_sqlite3;
+
+NODE_SQLITE3_THREAD_LOCAL DebugStats::Counters* DebugStats::local = NULL;
+
+static DebugStats::Counters* all_counters = NULL;
+static DebugStats::Counters baseline;
+static uv_once_t init_once = UV_ONCE_INIT;
+static uv_mutex_t mutex;
+
+static void InitMutex() {
+    uv_mutex_init(&mutex);
+}
+
+// Called once per thread. Threads of the pool live as long as the process,
+// so their counters are never freed.
+DebugStats::Counters* DebugStats::Register() {
+    Counters* counters = new Counters();
+    memset(counters, 0, sizeof(*counters));
+
+    uv_once(&init_once, InitMutex);
+    uv_mutex_lock(&mutex);
+    counters->next = all_counters;
+    all_counters = counters;
+    uv_mutex_unlock(&mutex);
+
+    local = counters;
+    return counters;
+}
+
+const char* DebugStats::names[] = { "bind", "row", "convert", "baton", "call" };
+
+void DebugStats::Sum(Counters& total) {
+    // Other threads may be counting; their values are read as they are.
+    memset(&total, 0, sizeof(total));
+    uv_once(&init_once, InitMutex);
+    uv_mutex_lock(&mutex);
+    for (Counters* counters = all_counters; counters; counters = counters->next) {
+        for (int i = 0; i < OPERATIONS; i++) {
+            total.allocations[i] += counters->allocations[i];
+            total.bytes[i] += counters->bytes[i];
+        }
+    }
+    uv_mutex_unlock(&mutex);
+}
+
+NAN_METHOD(DebugStats::Get) {
+    bool reset = info.Length() > 0 && Nan::To<bool>(info[0]).FromJust();
+
+    Counters total;
+    Sum(total);
+
+    Local<Object> result = Nan::New<Object>();
+    for (int i = 0; i < OPERATIONS; i++) {
+        Local<Object> operation = Nan::New<Object>();
+        Nan::Set(operation, Nan::New("allocations").ToLocalChecked(),
+            Nan::New<Number>((double)(total.allocations[i] - baseline.allocations[i])));
+        Nan::Set(operation, Nan::New("bytes").ToLocalChecked(),
+            Nan::New<Number>((double)(total.bytes[i] - baseline.bytes[i])));
+        Nan::Set(result, Nan::New(names[i]).ToLocalChecked(), operation);
+    }
+
+    // Counters only ever grow, so resetting moves the baseline.
+    if (reset) baseline = total;
+
+    info.GetReturnValue().Set(result);
+}
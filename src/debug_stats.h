@@ -0,0 +1,62 @@
+#ifndef NODE_SQLITE3_SRC_DEBUG_STATS_H
+#define NODE_SQLITE3_SRC_DEBUG_STATS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <nan.h>
+
+#include "threading.h"
+
+using namespace v8;
+
+namespace node_sqlite3 {
+
+// Allocations and bytes copied in the data path, by operation:
+//   bind:    fields created for bound parameters and their text/blob copies
+//   row:     fields created for result rows and their text/blob copies
+//   convert: values converted to JavaScript and the bytes copied into them
+//   baton:   batons created for scheduled work
+//   call:    calls queued while a database or statement was busy
+//
+// Every thread counts into its own slots with plain increments; the
+// slots are only summed when the stats are read.
+class DebugStats {
+public:
+    enum Operation {
+        BIND,
+        ROW,
+        CONVERT,
+        BATON,
+        CALL,
+        OPERATIONS
+    };
+
+    struct Counters {
+        uint64_t allocations[OPERATIONS];
+        uint64_t bytes[OPERATIONS];
+        Counters* next;
+    };
+
+    static inline void Count(Operation operation, size_t bytes = 0) {
+        Counters* counters = local ? local : Register();
+        counters->allocations[operation]++;
+        counters->bytes[operation] += bytes;
+    }
+
+    // sqlite3.debugStats([reset])
+    static NAN_METHOD(Get);
+
+    // Counts of all threads since the process started, ignoring resets.
+    static void Sum(Counters& total);
+    static const char* names[OPERATIONS];
+
+private:
+    static Counters* Register();
+
+    static NODE_SQLITE3_THREAD_LOCAL Counters* local;
+};
+
+}
+
+#endif
@@ -0,0 +1,54 @@
+#include <string>
+
+#include "functions.h"
+#include "regexp.h"
+
+namespace node_sqlite3 {
+
+static void DeleteRegexp(void* re) {
+    delete static_cast<Regexp*>(re);
+}
+
+// regexp(pattern, text) implements "text REGEXP pattern" with the syntax of
+// JavaScript regular expressions, matched per code point (see regexp.h).
+// The compiled pattern is cached as auxiliary data, so it is only compiled
+// once per statement as long as the pattern is constant.
+static void RegexpFunction(sqlite3_context* context, int argc, sqlite3_value** argv) {
+    if (sqlite3_value_type(argv[0]) == SQLITE_NULL || sqlite3_value_type(argv[1]) == SQLITE_NULL) {
+        return sqlite3_result_null(context);
+    }
+
+    Regexp* re = static_cast<Regexp*>(sqlite3_get_auxdata(context, 0));
+    bool compiled = false;
+    if (re == NULL) {
+        const char* pattern = (const char*)sqlite3_value_text(argv[0]);
+        int length = sqlite3_value_bytes(argv[0]);
+        std::string error;
+        re = Regexp::Compile(pattern, length, error);
+        if (re == NULL) {
+            std::string message = "invalid regular expression: " + error;
+            return sqlite3_result_error(context, message.c_str(), -1);
+        }
+        compiled = true;
+    }
+
+    const char* text = (const char*)sqlite3_value_text(argv[1]);
+    int length = sqlite3_value_bytes(argv[1]);
+    sqlite3_result_int(context, re->Search(text, length) ? 1 : 0);
+
+    // SQLite may free the pattern right away, so this has to come last.
+    if (compiled) sqlite3_set_auxdata(context, 0, re, DeleteRegexp);
+}
+
+int RegisterFunctions(sqlite3* db) {
+    int status = sqlite3_create_function(db, "regexp", 2, SQLITE_UTF8 | SQLITE_DETERMINISTIC,
+        NULL, RegexpFunction, NULL, NULL);
+    if (status == SQLITE_OK) status = RegisterVectorFunctions(db);
+    if (status == SQLITE_OK) status = RegisterAggregateFunctions(db);
+    if (status == SQLITE_OK) status = RegisterCompressFunctions(db);
+    if (status == SQLITE_OK) status = RegisterCollations(db);
+    if (status == SQLITE_OK) status = RegisterTokenizers(db);
+    return status;
+}
+
+}
@@ -0,0 +1,31 @@
+#ifndef NODE_SQLITE3_SRC_FUNCTIONS_H
+#define NODE_SQLITE3_SRC_FUNCTIONS_H
+
+#include <sqlite3.h>
+
+namespace node_sqlite3 {
+
+// Registers the native SQL functions on a freshly opened connection.
+// Called on the thread pool from Database::Work_Open.
+int RegisterFunctions(sqlite3* db);
+
+// vec_dot, vec_cosine, vec_l2 (and _i8 variants) and vec_topk in vector.cc.
+int RegisterVectorFunctions(sqlite3* db);
+
+// percentile, median, their _approx variants and approx_count_distinct in
+// aggregates.cc.
+int RegisterAggregateFunctions(sqlite3* db);
+
+// compress and decompress in compress.cc.
+int RegisterCompressFunctions(sqlite3* db);
+
+// NATSORT, NATSORT_NOCASE and UNICODE_NOCASE collations in collations.cc.
+int RegisterCollations(sqlite3* db);
+
+// The ngram and fold FTS5 tokenizers in tokenizers.cc. Does nothing if
+// SQLite was built without FTS5.
+int RegisterTokenizers(sqlite3* db);
+
+}
+
+#endif
@@ -0,0 +1,94 @@
+#ifndef NODE_SQLITE3_SRC_HASH_H
+#define NODE_SQLITE3_SRC_HASH_H
+
+#include <cstring>
+#include <stdint.h>
+
+namespace node_sqlite3 {
+
+// 64-bit xxHash (XXH64). Fast, well distributed and stable across runs,
+// so it works both for sketches and for content checksums. Input words
+// are read in host byte order; all supported platforms are little-endian.
+class Hash64 {
+public:
+    static uint64_t Compute(const void* data, size_t length, uint64_t seed = 0) {
+        const unsigned char* p = static_cast<const unsigned char*>(data);
+        const unsigned char* end = p + length;
+        uint64_t h;
+
+        if (length >= 32) {
+            uint64_t v1 = seed + P1 + P2, v2 = seed + P2, v3 = seed, v4 = seed - P1;
+            const unsigned char* limit = end - 32;
+            do {
+                v1 = Round(v1, Read64(p));
+                v2 = Round(v2, Read64(p + 8));
+                v3 = Round(v3, Read64(p + 16));
+                v4 = Round(v4, Read64(p + 24));
+                p += 32;
+            } while (p <= limit);
+            h = Rotate(v1, 1) + Rotate(v2, 7) + Rotate(v3, 12) + Rotate(v4, 18);
+            h = Merge(h, v1);
+            h = Merge(h, v2);
+            h = Merge(h, v3);
+            h = Merge(h, v4);
+        }
+        else {
+            h = seed + P5;
+        }
+
+        h += length;
+        for (; p + 8 <= end; p += 8) {
+            h ^= Round(0, Read64(p));
+            h = Rotate(h, 27) * P1 + P4;
+        }
+        if (p + 4 <= end) {
+            h ^= (uint64_t)Read32(p) * P1;
+            h = Rotate(h, 23) * P2 + P3;
+            p += 4;
+        }
+        for (; p < end; p++) {
+            h ^= *p * P5;
+            h = Rotate(h, 11) * P1;
+        }
+
+        h ^= h >> 33;
+        h *= P2;
+        h ^= h >> 29;
+        h *= P3;
+        h ^= h >> 32;
+        return h;
+    }
+
+private:
+    static const uint64_t P1 = 11400714785074694791ULL;
+    static const uint64_t P2 = 14029467366897019727ULL;
+    static const uint64_t P3 = 1609587929392839161ULL;
+    static const uint64_t P4 = 9650029242287828579ULL;
+    static const uint64_t P5 = 2870177450012600261ULL;
+
+    static inline uint64_t Rotate(uint64_t x, int r) {
+        return (x << r) | (x >> (64 - r));
+    }
+    static inline uint64_t Round(uint64_t acc, uint64_t input) {
+        acc += input * P2;
+        return Rotate(acc, 31) * P1;
+    }
+    static inline uint64_t Merge(uint64_t acc, uint64_t value) {
+        acc ^= Round(0, value);
+        return acc * P1 + P4;
+    }
+    static inline uint64_t Read64(const unsigned char* p) {
+        uint64_t value;
+        memcpy(&value, p, sizeof(value));
+        return value;
+    }
+    static inline uint32_t Read32(const unsigned char* p) {
+        uint32_t value;
+        memcpy(&value, p, sizeof(value));
+        return value;
+    }
+};
+
+}
+
+#endif
@@ -0,0 +1,275 @@
+#include <stdio.h>
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "macros.h"
+#include "database.h"
+#include "metrics.h"
+
+using namespace node_sqlite3;
+
+const double Histogram::bounds[Histogram::BUCKETS] = {
+    0.0001, 0.00025, 0.0005, 0.001, 0.0025, 0.005, 0.01,
+    0.025, 0.05, 0.1, 0.25, 0.5, 1, 2.5
+};
+
+namespace {
+
+std::string Escape(const std::string& value) {
+    std::string result;
+    for (size_t i = 0; i < value.size(); i++) {
+        switch (value[i]) {
+            case '\\': result += "\\\\"; break;
+            case '"':  result += "\\\""; break;
+            case '\n': result += "\\n"; break;
+            default:   result += value[i];
+        }
+    }
+    return result;
+}
+
+std::string Format(double value) {
+    char buffer[32];
+    snprintf(buffer, sizeof(buffer), "%.15g", value);
+    return buffer;
+}
+
+std::string Format(int64_t value) {
+    char buffer[32];
+    snprintf(buffer, sizeof(buffer), "%lld", (long long)value);
+    return buffer;
+}
+
+void Family(std::string& out, const char* name, const char* type, const char* help) {
+    out += "# TYPE "; out += name; out += " "; out += type; out += "\n";
+    out += "# HELP "; out += name; out += " "; out += help; out += "\n";
+}
+
+void Sample(std::string& out, const std::string& name, const std::string& labels,
+            const std::string& value) {
+    out += name;
+    if (!labels.empty()) {
+        out += "{"; out += labels; out += "}";
+    }
+    out += " "; out += value; out += "\n";
+}
+
+}
+
+bool Metrics::ById(Database* a, Database* b) {
+    return a->id < b->id;
+}
+
+// Per-database values that are read together.
+struct DatabaseSample {
+    Database* db;
+    std::string labels;
+};
+
+namespace node_sqlite3 {
+
+struct LockSample {
+    std::string labels;
+    LockWait wait;
+};
+
+}
+
+void Metrics::AddLockSamples(std::vector<LockSample>& locks, Database* db, const std::string& labels) {
+    for (std::map<std::string, LockWait>::iterator it = db->operations.lock_waits.begin();
+            it != db->operations.lock_waits.end(); ++it) {
+        LockSample sample = { labels + ",lock=\"connection\",operation=\"" + it->first + "\"", it->second };
+        locks.push_back(sample);
+    }
+    LockSample main = { labels + ",lock=\"connection\",operation=\"main\"", db->main_wait };
+    locks.push_back(main);
+
+    LockSample rows = { labels + ",lock=\"rows\",operation=\"Statement.Each\"", db->rows_wait };
+    locks.push_back(rows);
+
+    LockSample events = { labels + ",lock=\"events\",operation=\"Database.Events\"", db->events_wait };
+    if (db->debug_trace) events.wait.Add(db->debug_trace->LockStats());
+    if (db->debug_profile) events.wait.Add(db->debug_profile->LockStats());
+    if (db->update_event) events.wait.Add(db->update_event->LockStats());
+    locks.push_back(events);
+}
+
+NAN_METHOD(Metrics::Render) {
+    std::vector<Database*> databases(Database::instances.begin(), Database::instances.end());
+    std::sort(databases.begin(), databases.end(), ById);
+
+    std::vector<DatabaseSample> samples;
+    std::vector<LockSample> locks;
+    for (size_t i = 0; i < databases.size(); i++) {
+        Database* db = databases[i];
+        // Work_Close frees the handle on the thread pool before `open` is
+        // cleared.
+        if (!db->open || db->closing) continue;
+
+        DatabaseSample sample;
+        sample.db = db;
+        sample.labels = "database=\"" + Format((int64_t)db->id) +
+            "\",filename=\"" + Escape(db->filename) + "\"";
+        samples.push_back(sample);
+        AddLockSamples(locks, db, sample.labels);
+
+        // Don't wait for a query on the thread pool to release the
+        // connection; report the values from the last scrape instead.
+        sqlite3_mutex* mutex = sqlite3_db_mutex(db->_handle);
+        if (sqlite3_mutex_try(mutex) == SQLITE_OK) {
+            int highwater;
+            sqlite3_db_status(db->_handle, SQLITE_DBSTATUS_CACHE_HIT, &db->cache_hits, &highwater, 0);
+            sqlite3_db_status(db->_handle, SQLITE_DBSTATUS_CACHE_MISS, &db->cache_misses, &highwater, 0);
+            sqlite3_db_status(db->_handle, SQLITE_DBSTATUS_CACHE_USED, &db->cache_used, &highwater, 0);
+            sqlite3_mutex_leave(mutex);
+        }
+    }
+
+    std::string out;
+
+    Family(out, "sqlite3_queue_depth", "gauge",
+        "Operations waiting in the queue of a database.");
+    for (size_t i = 0; i < samples.size(); i++) {
+        Sample(out, "sqlite3_queue_depth", samples[i].labels,
+            Format((int64_t)samples[i].db->queue.size()));
+    }
+
+    Family(out, "sqlite3_pending_operations", "gauge",
+        "Operations running on the thread pool or waiting for their callback.");
+    for (size_t i = 0; i < samples.size(); i++) {
+        Sample(out, "sqlite3_pending_operations", samples[i].labels,
+            Format((int64_t)samples[i].db->pending));
+    }
+
+    Family(out, "sqlite3_pending_result_bytes", "gauge",
+        "Bytes of result rows fetched but not yet converted to JavaScript.");
+    for (size_t i = 0; i < samples.size(); i++) {
+        Sample(out, "sqlite3_pending_result_bytes", samples[i].labels,
+            Format((int64_t)NODE_SQLITE3_ATOMIC_ADD(&samples[i].db->pending_result_bytes, 0)));
+    }
+
+    Family(out, "sqlite3_busy_retries", "counter",
+        "Times the busy handler waited for another connection's lock.");
+    for (size_t i = 0; i < samples.size(); i++) {
+        Sample(out, "sqlite3_busy_retries_total", samples[i].labels,
+            Format((int64_t)NODE_SQLITE3_ATOMIC_ADD(&samples[i].db->busy_retries, 0)));
+    }
+
+    Family(out, "sqlite3_statements_prepared", "counter",
+        "Statements prepared on a database.");
+    for (size_t i = 0; i < samples.size(); i++) {
+        Sample(out, "sqlite3_statements_prepared_total", samples[i].labels,
+            Format((int64_t)samples[i].db->prepared));
+    }
+
+    Family(out, "sqlite3_page_cache_hits", "counter",
+        "Page cache hits of a connection.");
+    for (size_t i = 0; i < samples.size(); i++) {
+        Sample(out, "sqlite3_page_cache_hits_total", samples[i].labels,
+            Format((int64_t)samples[i].db->cache_hits));
+    }
+
+    Family(out, "sqlite3_page_cache_misses", "counter",
+        "Page cache misses of a connection.");
+    for (size_t i = 0; i < samples.size(); i++) {
+        Sample(out, "sqlite3_page_cache_misses_total", samples[i].labels,
+            Format((int64_t)samples[i].db->cache_misses));
+    }
+
+    Family(out, "sqlite3_page_cache_bytes", "gauge",
+        "Heap memory used by the page cache of a connection.");
+    for (size_t i = 0; i < samples.size(); i++) {
+        Sample(out, "sqlite3_page_cache_bytes", samples[i].labels,
+            Format((int64_t)samples[i].db->cache_used));
+    }
+
+    Family(out, "sqlite3_operation_duration_seconds", "histogram",
+        "Time from queueing an operation to running its callback.");
+    for (size_t i = 0; i < samples.size(); i++) {
+        const Histogram& histogram = samples[i].db->operations.latency;
+        uint64_t cumulative = 0;
+        for (int b = 0; b <= Histogram::BUCKETS; b++) {
+            cumulative += histogram.counts[b];
+            std::string le = b < Histogram::BUCKETS ? Format(Histogram::bounds[b]) : "+Inf";
+            Sample(out, "sqlite3_operation_duration_seconds_bucket",
+                samples[i].labels + ",le=\"" + le + "\"", Format((int64_t)cumulative));
+        }
+        Sample(out, "sqlite3_operation_duration_seconds_count", samples[i].labels,
+            Format((int64_t)histogram.count));
+        Sample(out, "sqlite3_operation_duration_seconds_sum", samples[i].labels,
+            Format(histogram.sum));
+    }
+
+    Family(out, "sqlite3_lock_acquisitions", "counter",
+        "Acquisitions of a mutex, by lock and operation.");
+    for (size_t i = 0; i < locks.size(); i++) {
+        Sample(out, "sqlite3_lock_acquisitions_total", locks[i].labels,
+            Format((int64_t)locks[i].wait.acquisitions));
+    }
+    Family(out, "sqlite3_lock_contentions", "counter",
+        "Acquisitions of a mutex that had to wait, by lock and operation.");
+    for (size_t i = 0; i < locks.size(); i++) {
+        Sample(out, "sqlite3_lock_contentions_total", locks[i].labels,
+            Format((int64_t)locks[i].wait.contentions));
+    }
+    Family(out, "sqlite3_lock_wait_seconds", "counter",
+        "Time spent waiting for a mutex, by lock and operation.");
+    for (size_t i = 0; i < locks.size(); i++) {
+        Sample(out, "sqlite3_lock_wait_seconds_total", locks[i].labels,
+            Format((double)locks[i].wait.nanoseconds / 1e9));
+    }
+
+    static const char* table_counters[][2] = {
+        { "sqlite3_table_reads", "Executions of statements reading a table." },
+        { "sqlite3_table_writes", "Executions of statements writing a table." },
+        { "sqlite3_table_changes", "Rows changed by statements writing a table." },
+        { "sqlite3_table_fullscan_steps", "Full scan steps of statements using a table." },
+        { "sqlite3_table_sorts", "Sorts of statements using a table." },
+        { "sqlite3_table_vm_steps", "Virtual machine steps of statements using a table." }
+    };
+    for (int c = 0; c < 6; c++) {
+        Family(out, table_counters[c][0], "counter", table_counters[c][1]);
+        for (size_t i = 0; i < samples.size(); i++) {
+            std::map<std::string, Database::TableStats>& tables = samples[i].db->table_stats;
+            for (std::map<std::string, Database::TableStats>::iterator it = tables.begin();
+                    it != tables.end(); ++it) {
+                const Database::TableStats& stats = it->second;
+                sqlite3_int64 values[] = { stats.reads, stats.writes, stats.changes,
+                    stats.fullscan_steps, stats.sorts, stats.vm_steps };
+                Sample(out, std::string(table_counters[c][0]) + "_total",
+                    samples[i].labels + ",table=\"" + Escape(it->first) + "\"",
+                    Format((int64_t)values[c]));
+            }
+        }
+    }
+
+    DebugStats::Counters counters;
+    DebugStats::Sum(counters);
+    Family(out, "sqlite3_data_path_allocations", "counter",
+        "Allocations in the data path of all databases, by operation.");
+    for (int i = 0; i < DebugStats::OPERATIONS; i++) {
+        Sample(out, "sqlite3_data_path_allocations_total",
+            std::string("operation=\"") + DebugStats::names[i] + "\"",
+            Format((int64_t)counters.allocations[i]));
+    }
+    Family(out, "sqlite3_data_path_bytes", "counter",
+        "Bytes copied in the data path of all databases, by operation.");
+    for (int i = 0; i < DebugStats::OPERATIONS; i++) {
+        Sample(out, "sqlite3_data_path_bytes_total",
+            std::string("operation=\"") + DebugStats::names[i] + "\"",
+            Format((int64_t)counters.bytes[i]));
+    }
+
+    size_t idle, borrowed;
+    ConnectionPool::Counts(idle, borrowed);
+    Family(out, "sqlite3_pool_idle_connections", "gauge",
+        "Idle connections in the process-wide connection pool.");
+    Sample(out, "sqlite3_pool_idle_connections", "", Format((int64_t)idle));
+    Family(out, "sqlite3_pool_borrowed_connections", "gauge",
+        "Connections borrowed from the process-wide connection pool.");
+    Sample(out, "sqlite3_pool_borrowed_connections", "", Format((int64_t)borrowed));
+
+    out += "# EOF\n";
+    info.GetReturnValue().Set(Nan::New(out).ToLocalChecked());
+}
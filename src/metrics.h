@@ -0,0 +1,109 @@
+#ifndef NODE_SQLITE3_SRC_METRICS_H
+#define NODE_SQLITE3_SRC_METRICS_H
+
+#include <stdint.h>
+#include <map>
+#include <string>
+#include <vector>
+
+#include <nan.h>
+#include <sqlite3.h>
+
+#include "threading.h"
+
+using namespace v8;
+
+namespace node_sqlite3 {
+
+class Database;
+struct LockSample;
+
+// Cumulative histogram with fixed buckets in seconds, as used by
+// Prometheus. Only touched on the main thread.
+struct Histogram {
+    static const int BUCKETS = 14;
+    static const double bounds[BUCKETS];
+
+    Histogram() : sum(0), count(0) {
+        for (int i = 0; i <= BUCKETS; i++) counts[i] = 0;
+    }
+
+    inline void Observe(double seconds) {
+        int i = 0;
+        while (i < BUCKETS && seconds > bounds[i]) i++;
+        counts[i]++;
+        sum += seconds;
+        count++;
+    }
+
+    // The last slot counts observations above all bounds.
+    uint64_t counts[BUCKETS + 1];
+    double sum;
+    uint64_t count;
+};
+
+// Acquisitions of a mutex and the time spent waiting for it. Only written
+// by the thread that holds the mutex or owns the counters.
+struct LockWait {
+    LockWait() : acquisitions(0), contentions(0), nanoseconds(0) {}
+
+    inline void Add(const LockWait& other) {
+        acquisitions += other.acquisitions;
+        contentions += other.contentions;
+        nanoseconds += other.nanoseconds;
+    }
+
+    uint64_t acquisitions;
+    // Acquisitions that had to wait.
+    uint64_t contentions;
+    uint64_t nanoseconds;
+};
+
+// sqlite3_mutex_enter() that counts into `wait`. The clock is only read
+// when the mutex is taken.
+inline void EnterMutex(sqlite3_mutex* mutex, LockWait& wait) {
+    wait.acquisitions++;
+    if (sqlite3_mutex_try(mutex) == SQLITE_OK) return;
+    uint64_t start = uv_hrtime();
+    sqlite3_mutex_enter(mutex);
+    wait.contentions++;
+    wait.nanoseconds += uv_hrtime() - start;
+}
+
+// NODE_SQLITE3_MUTEX_LOCK() that counts into `wait`, which should be
+// protected by the same mutex.
+template <class Mutex> inline void LockMutex(Mutex* mutex, LockWait& wait) {
+    if (NODE_SQLITE3_MUTEX_TRYLOCK(mutex)) {
+        wait.acquisitions++;
+        return;
+    }
+    uint64_t start = uv_hrtime();
+    NODE_SQLITE3_MUTEX_LOCK(mutex)
+    wait.acquisitions++;
+    wait.contentions++;
+    wait.nanoseconds += uv_hrtime() - start;
+}
+
+// What a database's operations report when their callback runs.
+struct OperationStats {
+    // Time from creating the baton to running its callback.
+    Histogram latency;
+    // Waits for the connection mutex on the thread pool, by operation name.
+    std::map<std::string, LockWait> lock_waits;
+};
+
+// sqlite3.metrics(): all counters, gauges and histograms of the driver in
+// the OpenMetrics text format. Per-database samples are labelled with the
+// database's id and filename.
+class Metrics {
+public:
+    static NAN_METHOD(Render);
+
+private:
+    static bool ById(Database* a, Database* b);
+    static void AddLockSamples(std::vector<LockSample>& locks, Database* db, const std::string& labels);
+};
+
+}
+
+#endif
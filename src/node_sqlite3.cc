@@ -18,9 +18,22 @@ NAN_MODULE_INIT(RegisterModule) {
     Database::Init(target);
     Statement::Init(target);
 
+    Nan::SetMethod(target, "debugStats", DebugStats::Get);
+    Nan::SetMethod(target, "poolStats", ConnectionPool::Stats);
+    Nan::SetMethod(target, "drainPool", ConnectionPool::Drain);
+    Nan::SetMethod(target, "startTimeline", Timeline::Start);
+    Nan::SetMethod(target, "stopTimeline", Timeline::Stop);
+    Nan::SetMethod(target, "timelineSpans", Timeline::Spans);
+    Nan::SetMethod(target, "metrics", Metrics::Render);
+
     DEFINE_CONSTANT_INTEGER(target, SQLITE_OPEN_READONLY, OPEN_READONLY);
     DEFINE_CONSTANT_INTEGER(target, SQLITE_OPEN_READWRITE, OPEN_READWRITE);
     DEFINE_CONSTANT_INTEGER(target, SQLITE_OPEN_CREATE, OPEN_CREATE);
+    DEFINE_CONSTANT_INTEGER(target, SQLITE_OPEN_URI, OPEN_URI);
+    DEFINE_CONSTANT_INTEGER(target, SQLITE_OPEN_SHAREDCACHE, OPEN_SHAREDCACHE);
+    DEFINE_CONSTANT_INTEGER(target, SQLITE_OPEN_PRIVATECACHE, OPEN_PRIVATECACHE);
+    DEFINE_CONSTANT_INTEGER(target, SQLITE_OPEN_FULLMUTEX, OPEN_FULLMUTEX);
+    DEFINE_CONSTANT_INTEGER(target, NODE_SQLITE3_OPEN_POOLED, OPEN_POOLED);
     DEFINE_CONSTANT_STRING(target, SQLITE_VERSION, VERSION);
 #ifdef SQLITE_SOURCE_ID
     DEFINE_CONSTANT_STRING(target, SQLITE_SOURCE_ID, SOURCE_ID);
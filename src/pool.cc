@@ -0,0 +1,136 @@
+#include <string.h>
+
+#include "pool.h"
+
+using namespace node_sqlite3;
+
+ConnectionPool::Idle ConnectionPool::idle;
+ConnectionPool::Borrowed ConnectionPool::borrowed;
+
+static uv_once_t init_once = UV_ONCE_INIT;
+static uv_mutex_t mutex;
+
+static void InitMutex() {
+    uv_mutex_init(&mutex);
+}
+
+void ConnectionPool::Lock() {
+    uv_once(&init_once, InitMutex);
+    uv_mutex_lock(&mutex);
+}
+
+void ConnectionPool::Unlock() {
+    uv_mutex_unlock(&mutex);
+}
+
+int ConnectionPool::Acquire(const std::string& filename, int flags, sqlite3** handle, bool* reused) {
+    Key key(filename, flags);
+
+    Lock();
+    Idle::iterator it = idle.find(key);
+    if (it != idle.end() && !it->second.empty()) {
+        *handle = it->second.back();
+        it->second.pop_back();
+        borrowed.insert(std::make_pair(*handle, key));
+        Unlock();
+        *reused = true;
+        return SQLITE_OK;
+    }
+    Unlock();
+
+    *reused = false;
+
+    int status = sqlite3_open_v2(filename.c_str(), handle, flags, NULL);
+    if (status == SQLITE_OK) {
+        Lock();
+        borrowed.insert(std::make_pair(*handle, key));
+        Unlock();
+    }
+    return status;
+}
+
+// Private in-memory and temporary databases must not be handed to another
+// borrower, and neither must state that only the last borrower knows about.
+bool ConnectionPool::Clean(sqlite3* handle) {
+    const char* filename = sqlite3_db_filename(handle, "main");
+    if (filename == NULL || filename[0] == '\0') return false;
+    if (!sqlite3_get_autocommit(handle)) return false;
+
+    sqlite3_stmt* stmt;
+    if (sqlite3_prepare_v2(handle, "PRAGMA database_list", -1, &stmt, NULL) != SQLITE_OK) {
+        return false;
+    }
+    bool clean = true;
+    while (clean && sqlite3_step(stmt) == SQLITE_ROW) {
+        const char* name = (const char*)sqlite3_column_text(stmt, 1);
+        clean = name != NULL && strcmp(name, "main") == 0;
+    }
+    sqlite3_finalize(stmt);
+    return clean;
+}
+
+void ConnectionPool::Release(sqlite3* handle, bool reuse) {
+    Lock();
+    Borrowed::iterator it = borrowed.find(handle);
+    if (it == borrowed.end()) {
+        Unlock();
+        sqlite3_close(handle);
+        return;
+    }
+    Key key = it->second;
+    borrowed.erase(it);
+    Unlock();
+
+    if (reuse && Clean(handle)) {
+        // Callbacks still point to the Database that is going away.
+        sqlite3_trace(handle, NULL, NULL);
+        sqlite3_profile(handle, NULL, NULL);
+        sqlite3_update_hook(handle, NULL, NULL);
+        sqlite3_progress_handler(handle, 0, NULL, NULL);
+        sqlite3_set_authorizer(handle, NULL, NULL);
+        sqlite3_busy_handler(handle, NULL, NULL);
+
+        Lock();
+        std::vector<sqlite3*>& connections = idle[key];
+        if (connections.size() < max_idle) {
+            connections.push_back(handle);
+            handle = NULL;
+        }
+        Unlock();
+    }
+
+    if (handle) sqlite3_close(handle);
+}
+
+void ConnectionPool::Counts(size_t& idle_count, size_t& borrowed_count) {
+    idle_count = 0;
+    Lock();
+    for (Idle::iterator it = idle.begin(); it != idle.end(); ++it) {
+        idle_count += it->second.size();
+    }
+    borrowed_count = borrowed.size();
+    Unlock();
+}
+
+NAN_METHOD(ConnectionPool::Stats) {
+    size_t idle_count, borrowed_count;
+    Counts(idle_count, borrowed_count);
+
+    Local<Object> result = Nan::New<Object>();
+    Nan::Set(result, Nan::New("idle").ToLocalChecked(), Nan::New<Number>((double)idle_count));
+    Nan::Set(result, Nan::New("borrowed").ToLocalChecked(), Nan::New<Number>((double)borrowed_count));
+    info.GetReturnValue().Set(result);
+}
+
+NAN_METHOD(ConnectionPool::Drain) {
+    Idle drained;
+    Lock();
+    drained.swap(idle);
+    Unlock();
+
+    for (Idle::iterator it = drained.begin(); it != drained.end(); ++it) {
+        for (size_t i = 0; i < it->second.size(); i++) {
+            sqlite3_close(it->second[i]);
+        }
+    }
+}
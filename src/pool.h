@@ -0,0 +1,73 @@
+#ifndef NODE_SQLITE3_SRC_POOL_H
+#define NODE_SQLITE3_SRC_POOL_H
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include <sqlite3.h>
+#include <nan.h>
+
+// Not an SQLite flag: makes a Database borrow its connection from the
+// ConnectionPool. It is removed before the flags reach sqlite3_open_v2().
+#define NODE_SQLITE3_OPEN_POOLED 0x40000000
+
+using namespace v8;
+
+namespace node_sqlite3 {
+
+// Connections owned by the process instead of by a single Database object.
+// A Database opened with OPEN_POOLED borrows an idle connection to the same
+// file with the same flags, and hands it back when it is closed, so that
+// the page cache and parsed schema outlive the Database. Connections are
+// only kept when they are back in their initial state: no open transaction,
+// no attached databases and no JavaScript functions. Settings changed with
+// PRAGMAs stay with the connection.
+class ConnectionPool {
+public:
+    // Called on the thread pool. Sets `reused` if the connection was
+    // borrowed before, so that it already has the native functions.
+    static int Acquire(const std::string& filename, int flags, sqlite3** handle, bool* reused);
+    // Keeps the connection for the next borrower if `reuse` is set and the
+    // connection is clean; closes it otherwise. There must not be any
+    // unfinalized statements.
+    static void Release(sqlite3* handle, bool reuse);
+
+    static void Counts(size_t& idle, size_t& borrowed);
+
+    // sqlite3.poolStats()
+    static NAN_METHOD(Stats);
+    // sqlite3.drainPool(): closes all idle connections.
+    static NAN_METHOD(Drain);
+
+    // Idle connections kept per file and flags.
+    static const size_t max_idle = 4;
+
+private:
+    struct Key {
+        Key(const std::string& filename_, int flags_) :
+            filename(filename_), flags(flags_) {}
+
+        bool operator<(const Key& other) const {
+            return flags < other.flags ||
+                (flags == other.flags && filename < other.filename);
+        }
+
+        std::string filename;
+        int flags;
+    };
+
+    typedef std::map<Key, std::vector<sqlite3*> > Idle;
+    typedef std::map<sqlite3*, Key> Borrowed;
+
+    static bool Clean(sqlite3* handle);
+    static void Lock();
+    static void Unlock();
+
+    static Idle idle;
+    static Borrowed borrowed;
+};
+
+}
+
+#endif
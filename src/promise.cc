@@ -0,0 +1,51 @@
+#include "macros.h"
+#include "promise.h"
+
+using namespace node_sqlite3;
+
+#ifdef NODE_SQLITE3_PROMISES
+
+static Nan::Persistent<Function> noop;
+
+static NAN_METHOD(Noop) {}
+
+Local<PromiseResolver> node_sqlite3::NewResolver() {
+#if NODE_MODULE_VERSION >= NODE_4_0_MODULE_VERSION
+    return PromiseResolver::New(Nan::GetCurrentContext()).ToLocalChecked();
+#else
+    return PromiseResolver::New(Isolate::GetCurrent());
+#endif
+}
+
+void node_sqlite3::SettlePromise(Local<Object> context, Nan::Persistent<PromiseResolver>& persistent,
+                                 Local<Value> value, bool rejected) {
+    Nan::HandleScope scope;
+
+    Local<PromiseResolver> resolver = Nan::New(persistent);
+    persistent.Reset();
+
+#if NODE_MODULE_VERSION >= NODE_4_0_MODULE_VERSION
+    if (rejected) resolver->Reject(Nan::GetCurrentContext(), value).FromJust();
+    else resolver->Resolve(Nan::GetCurrentContext(), value).FromJust();
+#else
+    if (rejected) resolver->Reject(value);
+    else resolver->Resolve(value);
+#endif
+
+    // Node only runs the microtask queue after a callback into JavaScript,
+    // so enter one: at the top of the stack, this runs the reactions right
+    // away instead of after the next unrelated callback.
+    if (noop.IsEmpty()) {
+        noop.Reset(Nan::GetFunction(Nan::New<FunctionTemplate>(Noop)).ToLocalChecked());
+    }
+    TRY_CATCH_CALL(context, Nan::New(noop), 0, NULL);
+}
+
+#else
+
+void node_sqlite3::SettlePromise(Local<Object> context, Nan::Persistent<PromiseResolver>& resolver,
+                                 Local<Value> value, bool rejected) {
+    resolver.Reset();
+}
+
+#endif
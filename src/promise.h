@@ -0,0 +1,31 @@
+#ifndef NODE_SQLITE3_SRC_PROMISE_H
+#define NODE_SQLITE3_SRC_PROMISE_H
+
+#include <nan.h>
+
+using namespace v8;
+
+namespace node_sqlite3 {
+
+// Promise-returning methods need V8 promises (Node 0.12 and newer). On
+// older versions they are not registered and batons never hold a resolver.
+#if NODE_MODULE_VERSION >= NODE_0_12_MODULE_VERSION
+#define NODE_SQLITE3_PROMISES
+typedef Promise::Resolver PromiseResolver;
+#else
+typedef Object PromiseResolver;
+#endif
+
+#ifdef NODE_SQLITE3_PROMISES
+Local<PromiseResolver> NewResolver();
+#endif
+
+// Resolves or rejects the promise of a baton and releases the resolver.
+// Called from Work_After* like a callback; reactions run once the
+// current callback from the event loop returns.
+void SettlePromise(Local<Object> context, Nan::Persistent<PromiseResolver>& resolver,
+                   Local<Value> value, bool rejected = false);
+
+}
+
+#endif
@@ -0,0 +1,631 @@
+#include <algorithm>
+
+#include "regexp.h"
+#include "unicode.h"
+
+namespace node_sqlite3 {
+
+namespace {
+
+const uint32_t MAX_CODE_POINT = 0x10FFFF;
+// Bounds the size of the program, and with it the work per character, for
+// patterns like "(a{1000}){1000}".
+const size_t MAX_INSTRUCTIONS = 20000;
+const int MAX_DEPTH = 200;
+
+typedef Regexp::Ranges Ranges;
+
+void Normalize(Ranges& ranges) {
+    std::sort(ranges.begin(), ranges.end());
+    Ranges merged;
+    for (size_t i = 0; i < ranges.size(); i++) {
+        if (!merged.empty() && ranges[i].first <= merged.back().second + 1) {
+            merged.back().second = std::max(merged.back().second, ranges[i].second);
+        }
+        else {
+            merged.push_back(ranges[i]);
+        }
+    }
+    ranges.swap(merged);
+}
+
+Ranges Complement(const Ranges& ranges) {
+    Ranges result;
+    uint32_t next = 0;
+    for (size_t i = 0; i < ranges.size(); i++) {
+        if (ranges[i].first > next) result.push_back(std::make_pair(next, ranges[i].first - 1));
+        next = ranges[i].second + 1;
+    }
+    if (next <= MAX_CODE_POINT) result.push_back(std::make_pair(next, MAX_CODE_POINT));
+    return result;
+}
+
+void AddRange(Ranges& ranges, uint32_t first, uint32_t last) {
+    ranges.push_back(std::make_pair(first, last));
+}
+
+Ranges Digits() {
+    Ranges ranges;
+    AddRange(ranges, '0', '9');
+    return ranges;
+}
+
+Ranges WordCharacters() {
+    Ranges ranges;
+    AddRange(ranges, '0', '9');
+    AddRange(ranges, 'A', 'Z');
+    AddRange(ranges, '_', '_');
+    AddRange(ranges, 'a', 'z');
+    return ranges;
+}
+
+// White space and line terminators as defined by ECMAScript.
+Ranges Spaces() {
+    Ranges ranges;
+    AddRange(ranges, 0x09, 0x0D);
+    AddRange(ranges, 0x20, 0x20);
+    AddRange(ranges, 0xA0, 0xA0);
+    AddRange(ranges, 0x1680, 0x1680);
+    AddRange(ranges, 0x2000, 0x200A);
+    AddRange(ranges, 0x2028, 0x2029);
+    AddRange(ranges, 0x202F, 0x202F);
+    AddRange(ranges, 0x205F, 0x205F);
+    AddRange(ranges, 0x3000, 0x3000);
+    AddRange(ranges, 0xFEFF, 0xFEFF);
+    return ranges;
+}
+
+bool IsWordCharacter(uint32_t c) {
+    return (c >= '0' && c <= '9') || (c >= 'A' && c <= 'Z') || c == '_' || (c >= 'a' && c <= 'z');
+}
+
+bool IsLineTerminator(uint32_t c) {
+    return c == '\n' || c == '\r' || c == 0x2028 || c == 0x2029;
+}
+
+int HexValue(uint32_t c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+struct Node {
+    enum Kind { EMPTY, CHAR, ANY, CLASS, ASSERTION, CONCAT, ALTERNATE, REPEAT };
+
+    Node(Kind kind_) : kind(kind_), value(0), min(0), max(0) {}
+    ~Node() {
+        for (size_t i = 0; i < children.size(); i++) delete children[i];
+    }
+
+    Kind kind;
+    // The character of CHAR, the class of CLASS or the Op of ASSERTION.
+    uint32_t value;
+    int min;
+    // -1 for no upper bound.
+    int max;
+    std::vector<Node*> children;
+};
+
+// Recursive descent over the pattern, which is short; the depth of groups
+// is limited.
+class Parser {
+public:
+    Parser(const std::vector<uint32_t>& pattern_, std::vector<Ranges>& classes_) :
+        pattern(pattern_), classes(classes_), pos(0), depth(0) {}
+
+    Node* Parse(std::string& error_) {
+        Node* node = Alternation();
+        if (node && pos < pattern.size()) {
+            delete node;
+            node = NULL;
+            Fail(pattern[pos] == ')' ? "unmatched ')'" : "unexpected character");
+        }
+        error_ = error;
+        return node;
+    }
+
+private:
+    bool AtEnd() const { return pos >= pattern.size(); }
+    uint32_t Peek() const { return pattern[pos]; }
+
+    Node* Fail(const char* message) {
+        if (error.empty()) error = message;
+        return NULL;
+    }
+
+    Node* Alternation() {
+        if (++depth > MAX_DEPTH) return Fail("groups are nested too deeply");
+        Node* node = Sequence();
+        while (node && !AtEnd() && Peek() == '|') {
+            pos++;
+            Node* next = Sequence();
+            if (!next) {
+                delete node;
+                node = NULL;
+                break;
+            }
+            if (node->kind != Node::ALTERNATE) {
+                Node* alternate = new Node(Node::ALTERNATE);
+                alternate->children.push_back(node);
+                node = alternate;
+            }
+            node->children.push_back(next);
+        }
+        depth--;
+        return node;
+    }
+
+    Node* Sequence() {
+        Node* sequence = new Node(Node::CONCAT);
+        while (!AtEnd() && Peek() != '|' && Peek() != ')') {
+            Node* atom = Atom();
+            if (atom) atom = Quantified(atom);
+            if (!atom) {
+                delete sequence;
+                return NULL;
+            }
+            sequence->children.push_back(atom);
+        }
+        return sequence;
+    }
+
+    // Parses "{n}", "{n,}" or "{n,m}" at pos. Anything else is a literal
+    // brace, as in JavaScript.
+    bool Braces(int& min, int& max) {
+        size_t start = pos;
+        pos++;
+        if (!Number(min)) {
+            pos = start;
+            return false;
+        }
+        max = min;
+        if (!AtEnd() && Peek() == ',') {
+            pos++;
+            max = -1;
+            if (!AtEnd() && Peek() != '}' && !Number(max)) {
+                pos = start;
+                return false;
+            }
+        }
+        if (AtEnd() || Peek() != '}') {
+            pos = start;
+            return false;
+        }
+        pos++;
+        return true;
+    }
+
+    bool Number(int& value) {
+        if (AtEnd() || Peek() < '0' || Peek() > '9') return false;
+        value = 0;
+        while (!AtEnd() && Peek() >= '0' && Peek() <= '9') {
+            // Larger counts exceed the size limit anyway.
+            value = std::min(value * 10 + (int)(Peek() - '0'), 100000);
+            pos++;
+        }
+        return true;
+    }
+
+    Node* Quantified(Node* atom) {
+        while (!AtEnd()) {
+            int min, max;
+            uint32_t c = Peek();
+            if (c == '*') { min = 0; max = -1; pos++; }
+            else if (c == '+') { min = 1; max = -1; pos++; }
+            else if (c == '?') { min = 0; max = 1; pos++; }
+            else if (c == '{' && Braces(min, max)) {}
+            else break;
+
+            if (max != -1 && max < min) {
+                delete atom;
+                return Fail("numbers out of order in {} quantifier");
+            }
+            if (atom->kind == Node::ASSERTION || atom->kind == Node::REPEAT) {
+                delete atom;
+                return Fail("nothing to repeat");
+            }
+            // Lazy quantifiers match the same texts.
+            if (!AtEnd() && Peek() == '?') pos++;
+
+            Node* repeat = new Node(Node::REPEAT);
+            repeat->min = min;
+            repeat->max = max;
+            repeat->children.push_back(atom);
+            atom = repeat;
+        }
+        return atom;
+    }
+
+    Node* Character(uint32_t c) {
+        Node* node = new Node(Node::CHAR);
+        node->value = c;
+        return node;
+    }
+
+    Node* Class(const Ranges& ranges) {
+        Node* node = new Node(Node::CLASS);
+        node->value = classes.size();
+        classes.push_back(ranges);
+        return node;
+    }
+
+    Node* Atom() {
+        uint32_t c = pattern[pos++];
+        switch (c) {
+            case '.': {
+                Node* node = new Node(Node::ANY);
+                return node;
+            }
+            case '^':
+            case '$': {
+                Node* node = new Node(Node::ASSERTION);
+                node->value = c == '^' ? Regexp::LINE_START : Regexp::LINE_END;
+                return node;
+            }
+            case '*':
+            case '+':
+            case '?':
+                return Fail("nothing to repeat");
+            case '{': {
+                int min, max;
+                pos--;
+                if (Braces(min, max)) return Fail("nothing to repeat");
+                pos++;
+                return Character(c);
+            }
+            case '(': {
+                if (!AtEnd() && Peek() == '?') {
+                    if (pos + 1 < pattern.size() && pattern[pos + 1] == ':') {
+                        pos += 2;
+                    }
+                    else {
+                        return Fail("lookarounds are not supported");
+                    }
+                }
+                Node* node = Alternation();
+                if (!node) return NULL;
+                if (AtEnd() || Peek() != ')') {
+                    delete node;
+                    return Fail("missing ')'");
+                }
+                pos++;
+                return node;
+            }
+            case '[':
+                return Bracket();
+            case '\\':
+                return Escape();
+            default:
+                return Character(c);
+        }
+    }
+
+    // Parses the escape after a backslash into a character or class.
+    // Returns false on errors; `ranges` is set for class escapes.
+    bool EscapeValue(bool in_class, uint32_t& c, Ranges& ranges, bool& is_class) {
+        if (AtEnd()) {
+            Fail("\\ at end of pattern");
+            return false;
+        }
+        is_class = false;
+        c = pattern[pos++];
+        switch (c) {
+            case 'd': ranges = Digits(); is_class = true; break;
+            case 'D': ranges = Complement(Digits()); is_class = true; break;
+            case 'w': ranges = WordCharacters(); is_class = true; break;
+            case 'W': ranges = Complement(WordCharacters()); is_class = true; break;
+            case 's': ranges = Spaces(); is_class = true; break;
+            case 'S': ranges = Complement(Spaces()); is_class = true; break;
+            case 'n': c = '\n'; break;
+            case 'r': c = '\r'; break;
+            case 't': c = '\t'; break;
+            case 'v': c = '\v'; break;
+            case 'f': c = '\f'; break;
+            case 'b': c = '\b'; break;  // Only reached inside classes.
+            case '0': c = 0; break;
+            case 'c':
+                if (!AtEnd() && ((Peek() >= 'a' && Peek() <= 'z') || (Peek() >= 'A' && Peek() <= 'Z'))) {
+                    c = pattern[pos++] % 32;
+                }
+                else {
+                    c = '\\';
+                    pos--;
+                }
+                break;
+            case 'x':
+            case 'u': {
+                int digits = c == 'x' ? 2 : 4;
+                uint32_t value = 0;
+                int i = 0;
+                for (; i < digits && pos + i < pattern.size(); i++) {
+                    int digit = HexValue(pattern[pos + i]);
+                    if (digit < 0) break;
+                    value = value * 16 + digit;
+                }
+                // Like JavaScript, an incomplete escape is the letter itself.
+                if (i == digits) {
+                    c = value;
+                    pos += digits;
+                }
+                break;
+            }
+            default:
+                if (c >= '1' && c <= '9' && !in_class) {
+                    Fail("backreferences are not supported");
+                    return false;
+                }
+                break;
+        }
+        return true;
+    }
+
+    Node* Escape() {
+        if (!AtEnd() && (Peek() == 'b' || Peek() == 'B')) {
+            Node* node = new Node(Node::ASSERTION);
+            node->value = Peek() == 'b' ? Regexp::WORD_BOUNDARY : Regexp::NOT_WORD_BOUNDARY;
+            pos++;
+            return node;
+        }
+        uint32_t c;
+        Ranges ranges;
+        bool is_class;
+        if (!EscapeValue(false, c, ranges, is_class)) return NULL;
+        return is_class ? Class(ranges) : Character(c);
+    }
+
+    Node* Bracket() {
+        bool negate = false;
+        if (!AtEnd() && Peek() == '^') {
+            negate = true;
+            pos++;
+        }
+        Ranges ranges;
+        while (true) {
+            if (AtEnd()) return Fail("missing ']'");
+            if (Peek() == ']') {
+                pos++;
+                break;
+            }
+
+            uint32_t first;
+            if (!ClassAtom(first, ranges)) {
+                if (!error.empty()) return NULL;
+                continue;
+            }
+            if (pos + 1 < pattern.size() && Peek() == '-' && pattern[pos + 1] != ']') {
+                pos++;
+                uint32_t last;
+                if (!ClassAtom(last, ranges)) {
+                    if (!error.empty()) return NULL;
+                    // A class escape after "-" makes the dash literal.
+                    AddRange(ranges, first, first);
+                    AddRange(ranges, '-', '-');
+                    continue;
+                }
+                if (last < first) return Fail("range out of order in character class");
+                AddRange(ranges, first, last);
+            }
+            else {
+                AddRange(ranges, first, first);
+            }
+        }
+        Normalize(ranges);
+        return Class(negate ? Complement(ranges) : ranges);
+    }
+
+    // Reads one member of a class. Returns false after adding a class
+    // escape like \d to `ranges`, or on errors.
+    bool ClassAtom(uint32_t& c, Ranges& ranges) {
+        c = pattern[pos++];
+        if (c != '\\') return true;
+        Ranges escaped;
+        bool is_class;
+        if (!EscapeValue(true, c, escaped, is_class)) return false;
+        if (!is_class) return true;
+        ranges.insert(ranges.end(), escaped.begin(), escaped.end());
+        return false;
+    }
+
+    const std::vector<uint32_t>& pattern;
+    std::vector<Ranges>& classes;
+    size_t pos;
+    int depth;
+    std::string error;
+};
+
+class Compiler {
+public:
+    Compiler(std::vector<Regexp::Instruction>& program_) : program(program_) {}
+
+    bool Emit(const Node* node) {
+        if (program.size() > MAX_INSTRUCTIONS) return false;
+        switch (node->kind) {
+            case Node::EMPTY:
+                break;
+            case Node::CHAR:
+                Add(Regexp::CHAR, node->value);
+                break;
+            case Node::ANY:
+                Add(Regexp::ANY);
+                break;
+            case Node::CLASS:
+                Add(Regexp::CLASS, node->value);
+                break;
+            case Node::ASSERTION:
+                Add((Regexp::Op)node->value);
+                break;
+            case Node::CONCAT:
+                for (size_t i = 0; i < node->children.size(); i++) {
+                    if (!Emit(node->children[i])) return false;
+                }
+                break;
+            case Node::ALTERNATE: {
+                std::vector<int> jumps;
+                for (size_t i = 0; i + 1 < node->children.size(); i++) {
+                    int split = Add(Regexp::SPLIT);
+                    program[split].x = program.size();
+                    if (!Emit(node->children[i])) return false;
+                    jumps.push_back(Add(Regexp::JUMP));
+                    program[split].y = program.size();
+                }
+                if (!Emit(node->children.back())) return false;
+                for (size_t i = 0; i < jumps.size(); i++) program[jumps[i]].x = program.size();
+            } break;
+            case Node::REPEAT: {
+                const Node* child = node->children[0];
+                for (int i = 0; i < node->min; i++) {
+                    if (!Emit(child)) return false;
+                }
+                if (node->max == -1) {
+                    int split = Add(Regexp::SPLIT);
+                    program[split].x = program.size();
+                    if (!Emit(child)) return false;
+                    program[Add(Regexp::JUMP)].x = split;
+                    program[split].y = program.size();
+                }
+                else {
+                    std::vector<int> splits;
+                    for (int i = node->min; i < node->max; i++) {
+                        int split = Add(Regexp::SPLIT);
+                        splits.push_back(split);
+                        program[split].x = program.size();
+                        if (!Emit(child)) return false;
+                    }
+                    for (size_t i = 0; i < splits.size(); i++) program[splits[i]].y = program.size();
+                }
+            } break;
+        }
+        return program.size() <= MAX_INSTRUCTIONS;
+    }
+
+    int Add(Regexp::Op op, uint32_t arg = 0) {
+        Regexp::Instruction inst = { op, arg, 0, 0 };
+        program.push_back(inst);
+        return program.size() - 1;
+    }
+
+private:
+    std::vector<Regexp::Instruction>& program;
+};
+
+}
+
+Regexp* Regexp::Compile(const char* pattern, int length, std::string& error) {
+    std::vector<uint32_t> chars;
+    const unsigned char* p = (const unsigned char*)pattern;
+    const unsigned char* end = p + length;
+    while (p < end) chars.push_back(DecodeUtf8(p, end));
+
+    Regexp* re = new Regexp();
+    Parser parser(chars, re->classes);
+    Node* root = parser.Parse(error);
+    if (root == NULL) {
+        delete re;
+        return NULL;
+    }
+
+    Compiler compiler(re->program);
+    bool compiled = compiler.Emit(root);
+    delete root;
+    if (!compiled) {
+        error = "regular expression is too large";
+        delete re;
+        return NULL;
+    }
+    compiler.Add(MATCH);
+    re->marks.assign(re->program.size(), -1);
+    return re;
+}
+
+bool Regexp::Matches(const Instruction& inst, uint32_t c) const {
+    switch (inst.op) {
+        case CHAR:
+            return c == inst.arg;
+        case ANY:
+            return !IsLineTerminator(c);
+        case CLASS: {
+            const Ranges& ranges = classes[inst.arg];
+            Ranges::const_iterator it = std::upper_bound(ranges.begin(), ranges.end(),
+                std::make_pair(c, MAX_CODE_POINT + 1));
+            return it != ranges.begin() && (--it)->second >= c;
+        }
+        default:
+            return false;
+    }
+}
+
+void Regexp::Follow(int pc, std::vector<int>& list, int generation,
+                    uint32_t previous, uint32_t next, bool start, bool end) {
+    stack.push_back(pc);
+    while (!stack.empty()) {
+        pc = stack.back();
+        stack.pop_back();
+        if (marks[pc] == generation) continue;
+        marks[pc] = generation;
+
+        const Instruction& inst = program[pc];
+        switch (inst.op) {
+            case JUMP:
+                stack.push_back(inst.x);
+                break;
+            case SPLIT:
+                stack.push_back(inst.y);
+                stack.push_back(inst.x);
+                break;
+            case LINE_START:
+                if (start) stack.push_back(pc + 1);
+                break;
+            case LINE_END:
+                if (end) stack.push_back(pc + 1);
+                break;
+            case WORD_BOUNDARY:
+            case NOT_WORD_BOUNDARY: {
+                bool boundary = (!start && IsWordCharacter(previous)) != (!end && IsWordCharacter(next));
+                if (boundary == (inst.op == WORD_BOUNDARY)) stack.push_back(pc + 1);
+            } break;
+            default:
+                list.push_back(pc);
+        }
+    }
+}
+
+bool Regexp::Search(const char* text, int length) {
+    const unsigned char* p = (const unsigned char*)text;
+    const unsigned char* end = p + length;
+
+    std::vector<int> current, next;
+    std::fill(marks.begin(), marks.end(), -1);
+    int generation = 0;
+
+    uint32_t previous = 0;
+    const unsigned char* after = p;
+    uint32_t c = p < end ? DecodeUtf8(after, end) : 0;
+    bool start = true;
+    while (true) {
+        bool at_end = p >= end;
+        // Every position may start a match.
+        Follow(0, current, generation, previous, c, start, at_end);
+        for (size_t i = 0; i < current.size(); i++) {
+            if (program[current[i]].op == MATCH) return true;
+        }
+        if (at_end) return false;
+
+        generation++;
+        next.clear();
+        p = after;
+        uint32_t following = p < end ? DecodeUtf8(after, end) : 0;
+        for (size_t i = 0; i < current.size(); i++) {
+            const Instruction& inst = program[current[i]];
+            if (Matches(inst, c)) {
+                Follow(current[i] + 1, next, generation, c, following, false, p >= end);
+            }
+        }
+        current.swap(next);
+        previous = c;
+        c = following;
+        start = false;
+    }
+}
+
+}
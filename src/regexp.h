@@ -0,0 +1,71 @@
+#ifndef NODE_SQLITE3_SRC_REGEXP_H
+#define NODE_SQLITE3_SRC_REGEXP_H
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+namespace node_sqlite3 {
+
+// Regular expressions for the REGEXP operator in the syntax of JavaScript
+// without flags: literals, ".", classes, the \d \w \s \b escapes and their
+// negations, "^" and "$", groups, alternation and all quantifiers.
+// Backreferences and lookaheads are rejected, as they need backtracking.
+//
+// Patterns compile to a Thompson NFA that Search() simulates one code point
+// of UTF-8 text at a time, without recursion and in time linear in the
+// length of the text, so no input can exhaust the stack of the thread
+// pool or backtrack for minutes.
+class Regexp {
+public:
+    // Returns NULL and sets `error` if the pattern is invalid.
+    static Regexp* Compile(const char* pattern, int length, std::string& error);
+
+    // Whether the pattern matches anywhere in `text`. Not thread-safe: uses
+    // scratch space of the object.
+    bool Search(const char* text, int length);
+
+    enum Op {
+        CHAR,
+        ANY,
+        CLASS,
+        LINE_START,
+        LINE_END,
+        WORD_BOUNDARY,
+        NOT_WORD_BOUNDARY,
+        SPLIT,
+        JUMP,
+        MATCH
+    };
+
+    struct Instruction {
+        Op op;
+        // The character of CHAR, the class of CLASS or the jump targets.
+        uint32_t arg;
+        int x;
+        int y;
+    };
+
+    // Sorted, non-overlapping ranges of code points.
+    typedef std::vector<std::pair<uint32_t, uint32_t> > Ranges;
+
+private:
+    Regexp() {}
+
+    bool Matches(const Instruction& inst, uint32_t c) const;
+    // Adds the state `pc` and all states reachable from it without
+    // consuming a character to `list`.
+    void Follow(int pc, std::vector<int>& list, int generation,
+                uint32_t previous, uint32_t next, bool start, bool end);
+
+    std::vector<Instruction> program;
+    std::vector<Ranges> classes;
+
+    // Scratch space of Search().
+    std::vector<int> marks;
+    std::vector<int> stack;
+};
+
+}
+
+#endif
@@ -1,10 +1,13 @@
+#include <stdio.h>
 #include <string.h>
+#include <algorithm>
 #include <node.h>
 #include <node_buffer.h>
 #include <node_version.h>
 
 #include "macros.h"
 #include "database.h"
+#include "hash.h"
 #include "statement.h"
 
 using namespace node_sqlite3;
@@ -22,10 +25,21 @@ NAN_MODULE_INIT(Statement::Init) {
     Nan::SetPrototypeMethod(t, "bind", Bind);
     Nan::SetPrototypeMethod(t, "get", Get);
     Nan::SetPrototypeMethod(t, "run", Run);
+    Nan::SetPrototypeMethod(t, "runBatch", RunBatch);
     Nan::SetPrototypeMethod(t, "all", All);
     Nan::SetPrototypeMethod(t, "each", Each);
+    Nan::SetPrototypeMethod(t, "hash", Hash);
+    Nan::SetPrototypeMethod(t, "allPacked", AllPacked);
     Nan::SetPrototypeMethod(t, "reset", Reset);
     Nan::SetPrototypeMethod(t, "finalize", Finalize);
+    Nan::SetPrototypeMethod(t, "lockStats", GetLockStats);
+#ifdef NODE_SQLITE3_PROMISES
+    Nan::SetPrototypeMethod(t, "bindAsync", BindAsync);
+    Nan::SetPrototypeMethod(t, "getAsync", GetAsync);
+    Nan::SetPrototypeMethod(t, "runAsync", RunAsync);
+    Nan::SetPrototypeMethod(t, "allAsync", AllAsync);
+    Nan::SetPrototypeMethod(t, "finalizeAsync", FinalizeAsync);
+#endif
 
     constructor_template.Reset(t);
     Nan::Set(target, Nan::New("Statement").ToLocalChecked(),
@@ -47,6 +61,8 @@ void Statement::Process() {
 }
 
 void Statement::Schedule(Work_Callback callback, Baton* baton) {
+    db->PostponeMaintenance();
+
     if (finalized) {
         queue.push(new Call(callback, baton));
         CleanQueue();
@@ -59,6 +75,84 @@ void Statement::Schedule(Work_Callback callback, Baton* baton) {
     }
 }
 
+#ifdef SQLITE_ENABLE_UNLOCK_NOTIFY
+struct UnlockNotification {
+    bool fired;
+    uv_mutex_t mutex;
+    uv_cond_t cond;
+};
+
+static void UnlockNotify(void** args, int count) {
+    for (int i = 0; i < count; i++) {
+        UnlockNotification* notification = static_cast<UnlockNotification*>(args[i]);
+        uv_mutex_lock(&notification->mutex);
+        notification->fired = true;
+        uv_cond_signal(&notification->cond);
+        uv_mutex_unlock(&notification->mutex);
+    }
+}
+
+// Blocks until the connection holding the shared-cache lock that made the
+// last call on `db` fail with SQLITE_LOCKED_SHAREDCACHE finishes its
+// transaction. The caller holds the connection mutex once; it is released
+// while waiting so that the main thread can keep using this connection.
+// Returns SQLITE_LOCKED if waiting would deadlock.
+int Statement::WaitForUnlock(sqlite3* db) {
+    UnlockNotification notification;
+    notification.fired = false;
+    uv_mutex_init(&notification.mutex);
+    uv_cond_init(&notification.cond);
+
+    int status = sqlite3_unlock_notify(db, UnlockNotify, &notification);
+    assert(status == SQLITE_LOCKED || status == SQLITE_OK);
+
+    if (status == SQLITE_OK) {
+        sqlite3_mutex* mtx = sqlite3_db_mutex(db);
+        sqlite3_mutex_leave(mtx);
+        uv_mutex_lock(&notification.mutex);
+        while (!notification.fired) {
+            uv_cond_wait(&notification.cond, &notification.mutex);
+        }
+        uv_mutex_unlock(&notification.mutex);
+        sqlite3_mutex_enter(mtx);
+    }
+
+    uv_cond_destroy(&notification.cond);
+    uv_mutex_destroy(&notification.mutex);
+    return status;
+}
+#endif
+
+// sqlite3_step() that waits for shared-cache locks held by other
+// connections instead of failing with SQLITE_LOCKED.
+int Statement::Step(sqlite3_stmt* handle) {
+    int status = sqlite3_step(handle);
+#ifdef SQLITE_ENABLE_UNLOCK_NOTIFY
+    sqlite3* db = sqlite3_db_handle(handle);
+    while (status == SQLITE_LOCKED &&
+            sqlite3_extended_errcode(db) == SQLITE_LOCKED_SHAREDCACHE) {
+        if (WaitForUnlock(db) != SQLITE_OK) break;
+        sqlite3_reset(handle);
+        status = sqlite3_step(handle);
+    }
+#endif
+    return status;
+}
+
+// sqlite3_prepare_v2() that waits for shared-cache schema locks held by
+// other connections.
+int Statement::Prepare(sqlite3* db, const std::string& sql, sqlite3_stmt** handle) {
+    int status = sqlite3_prepare_v2(db, sql.c_str(), sql.size(), handle, NULL);
+#ifdef SQLITE_ENABLE_UNLOCK_NOTIFY
+    while (status == SQLITE_LOCKED &&
+            sqlite3_extended_errcode(db) == SQLITE_LOCKED_SHAREDCACHE) {
+        if (WaitForUnlock(db) != SQLITE_OK) break;
+        status = sqlite3_prepare_v2(db, sql.c_str(), sql.size(), handle, NULL);
+    }
+#endif
+    return status;
+}
+
 template <class T> void Statement::Error(T* baton) {
     Nan::HandleScope scope;
 
@@ -69,7 +163,10 @@ template <class T> void Statement::Error(T* baton) {
 
     Local<Function> cb = Nan::New(baton->callback);
 
-    if (!cb.IsEmpty() && cb->IsFunction()) {
+    if (!baton->resolver.IsEmpty()) {
+        SettlePromise(stmt->handle(), baton->resolver, exception, true);
+    }
+    else if (!cb.IsEmpty() && cb->IsFunction()) {
         Local<Value> argv[] = { exception };
         TRY_CATCH_CALL(stmt->handle(), cb, 1, argv);
     }
@@ -115,8 +212,8 @@ NAN_METHOD(Statement::New) {
 void Statement::Work_BeginPrepare(Database::Baton* baton) {
     assert(baton->db->open);
     baton->db->pending++;
-    int status = uv_queue_work(uv_default_loop(),
-        &baton->request, Work_Prepare, (uv_after_work_cb)Work_AfterPrepare);
+    int status = Timeline::Queue(&baton->request, "Statement.Prepare",
+        Work_Prepare, (uv_after_work_cb)Work_AfterPrepare);
     assert(status == 0);
 }
 
@@ -126,15 +223,11 @@ void Statement::Work_Prepare(uv_work_t* req) {
     // In case preparing fails, we use a mutex to make sure we get the associated
     // error message.
     sqlite3_mutex* mtx = sqlite3_db_mutex(baton->db->_handle);
-    sqlite3_mutex_enter(mtx);
+    EnterMutex(mtx, baton->request.lock_wait);
 
-    stmt->status = sqlite3_prepare_v2(
-        baton->db->_handle,
-        baton->sql.c_str(),
-        baton->sql.size(),
-        &stmt->_handle,
-        NULL
-    );
+    baton->db->table_access = &stmt->access;
+    stmt->status = Prepare(baton->db->_handle, baton->sql, &stmt->_handle);
+    baton->db->table_access = NULL;
 
     if (stmt->status != SQLITE_OK) {
         stmt->message = std::string(sqlite3_errmsg(baton->db->_handle));
@@ -155,6 +248,8 @@ void Statement::Work_AfterPrepare(uv_work_t* req) {
     }
     else {
         stmt->prepared = true;
+        stmt->db->prepared++;
+        stmt->CollectTableStats();
         Local<Function> cb = Nan::New(baton->callback);
         if (!cb.IsEmpty() && cb->IsFunction()) {
             Local<Value> argv[] = { Nan::Null() };
@@ -165,29 +260,74 @@ void Statement::Work_AfterPrepare(uv_work_t* req) {
     STATEMENT_END();
 }
 
+void Statement::CollectTableStats() {
+    for (std::vector<Database::TableAccess>::iterator it = access.begin(); it < access.end(); ++it) {
+        Database::TableStats* stats = &db->table_stats[it->table];
+        std::vector<Database::TableStats*>& tables = it->write ? written_tables : read_tables;
+        if (std::find(tables.begin(), tables.end(), stats) == tables.end()) {
+            tables.push_back(stats);
+        }
+        if (!it->column.empty()) {
+            (it->write ? stats->written_columns : stats->read_columns).insert(it->column);
+        }
+    }
+    access.clear();
+}
+
+// Adds executions of this statement and its status counters since the last
+// call to the statistics of the tables it accesses.
+void Statement::CountExecutions(int executions, int changes) {
+    if (read_tables.empty() && written_tables.empty()) return;
+
+    int fullscan_steps = sqlite3_stmt_status(_handle, SQLITE_STMTSTATUS_FULLSCAN_STEP, 1);
+    int sorts = sqlite3_stmt_status(_handle, SQLITE_STMTSTATUS_SORT, 1);
+    int vm_steps = sqlite3_stmt_status(_handle, SQLITE_STMTSTATUS_VM_STEP, 1);
+
+    for (std::vector<Database::TableStats*>::iterator it = read_tables.begin(); it < read_tables.end(); ++it) {
+        (*it)->reads += executions;
+        (*it)->fullscan_steps += fullscan_steps;
+        (*it)->sorts += sorts;
+        (*it)->vm_steps += vm_steps;
+    }
+    for (std::vector<Database::TableStats*>::iterator it = written_tables.begin(); it < written_tables.end(); ++it) {
+        (*it)->writes += executions;
+        (*it)->changes += changes;
+        if (std::find(read_tables.begin(), read_tables.end(), *it) == read_tables.end()) {
+            (*it)->vm_steps += vm_steps;
+        }
+    }
+}
+
 template <class T> Values::Field*
                    Statement::BindParameter(const Local<Value> source, T pos) {
     if (source->IsString() || source->IsRegExp()) {
         Nan::Utf8String val(source);
+        DebugStats::Count(DebugStats::BIND, val.length());
         return new Values::Text(pos, val.length(), *val);
     }
     else if (source->IsInt32()) {
+        DebugStats::Count(DebugStats::BIND);
         return new Values::Integer(pos, Nan::To<int32_t>(source).FromJust());
     }
     else if (source->IsNumber()) {
+        DebugStats::Count(DebugStats::BIND);
         return new Values::Float(pos, Nan::To<double>(source).FromJust());
     }
     else if (source->IsBoolean()) {
+        DebugStats::Count(DebugStats::BIND);
         return new Values::Integer(pos, Nan::To<bool>(source).FromJust() ? 1 : 0);
     }
     else if (source->IsNull()) {
+        DebugStats::Count(DebugStats::BIND);
         return new Values::Null(pos);
     }
     else if (Buffer::HasInstance(source)) {
         Local<Object> buffer = Nan::To<Object>(source).ToLocalChecked();
+        DebugStats::Count(DebugStats::BIND, Buffer::Length(buffer));
         return new Values::Blob(pos, Buffer::Length(buffer), Buffer::Data(buffer));
     }
     else if (source->IsDate()) {
+        DebugStats::Count(DebugStats::BIND);
         return new Values::Float(pos, Nan::To<double>(source).FromJust());
     }
     else {
@@ -326,7 +466,7 @@ void Statement::Work_Bind(uv_work_t* req) {
     STATEMENT_INIT(Baton);
 
     sqlite3_mutex* mtx = sqlite3_db_mutex(stmt->db->_handle);
-    sqlite3_mutex_enter(mtx);
+    EnterMutex(mtx, baton->request.lock_wait);
     stmt->Bind(baton->parameters);
     sqlite3_mutex_leave(mtx);
 }
@@ -339,6 +479,9 @@ void Statement::Work_AfterBind(uv_work_t* req) {
     if (stmt->status != SQLITE_OK) {
         Error(baton);
     }
+    else if (!baton->resolver.IsEmpty()) {
+        SettlePromise(stmt->handle(), baton->resolver, stmt->handle());
+    }
     else {
         // Fire callbacks.
         Local<Function> cb = Nan::New(baton->callback);
@@ -375,10 +518,10 @@ void Statement::Work_Get(uv_work_t* req) {
 
     if (stmt->status != SQLITE_DONE || baton->parameters.size()) {
         sqlite3_mutex* mtx = sqlite3_db_mutex(stmt->db->_handle);
-        sqlite3_mutex_enter(mtx);
+        EnterMutex(mtx, baton->request.lock_wait);
 
         if (stmt->Bind(baton->parameters)) {
-            stmt->status = sqlite3_step(stmt->_handle);
+            stmt->status = Step(stmt->_handle);
 
             if (!(stmt->status == SQLITE_ROW || stmt->status == SQLITE_DONE)) {
                 stmt->message = std::string(sqlite3_errmsg(stmt->db->_handle));
@@ -389,7 +532,8 @@ void Statement::Work_Get(uv_work_t* req) {
 
         if (stmt->status == SQLITE_ROW) {
             // Acquire one result row before returning.
-            GetRow(&baton->row, stmt->_handle);
+            baton->result_bytes = GetRow(&baton->row, stmt->_handle);
+            stmt->db->AddPendingResultBytes(baton->result_bytes);
         }
     }
 }
@@ -402,6 +546,11 @@ void Statement::Work_AfterGet(uv_work_t* req) {
     if (stmt->status != SQLITE_ROW && stmt->status != SQLITE_DONE) {
         Error(baton);
     }
+    else if (!baton->resolver.IsEmpty()) {
+        Local<Value> row = stmt->status == SQLITE_ROW ?
+            Local<Value>(RowToJS(&baton->row)) : Local<Value>(Nan::Undefined());
+        SettlePromise(stmt->handle(), baton->resolver, row);
+    }
     else {
         // Fire callbacks.
         Local<Function> cb = Nan::New(baton->callback);
@@ -418,6 +567,8 @@ void Statement::Work_AfterGet(uv_work_t* req) {
         }
     }
 
+    stmt->CountExecutions(1);
+
     STATEMENT_END();
 }
 
@@ -442,7 +593,7 @@ void Statement::Work_Run(uv_work_t* req) {
     STATEMENT_INIT(RunBaton);
 
     sqlite3_mutex* mtx = sqlite3_db_mutex(stmt->db->_handle);
-    sqlite3_mutex_enter(mtx);
+    EnterMutex(mtx, baton->request.lock_wait);
 
     // Make sure that we also reset when there are no parameters.
     if (!baton->parameters.size()) {
@@ -450,7 +601,7 @@ void Statement::Work_Run(uv_work_t* req) {
     }
 
     if (stmt->Bind(baton->parameters)) {
-        stmt->status = sqlite3_step(stmt->_handle);
+        stmt->status = Step(stmt->_handle);
 
         if (!(stmt->status == SQLITE_ROW || stmt->status == SQLITE_DONE)) {
             stmt->message = std::string(sqlite3_errmsg(stmt->db->_handle));
@@ -472,6 +623,12 @@ void Statement::Work_AfterRun(uv_work_t* req) {
     if (stmt->status != SQLITE_ROW && stmt->status != SQLITE_DONE) {
         Error(baton);
     }
+    else if (!baton->resolver.IsEmpty()) {
+        Local<Object> result = Nan::New<Object>();
+        Nan::Set(result, Nan::New("lastID").ToLocalChecked(), Nan::New<Number>(baton->inserted_id));
+        Nan::Set(result, Nan::New("changes").ToLocalChecked(), Nan::New(baton->changes));
+        SettlePromise(stmt->handle(), baton->resolver, result);
+    }
     else {
         // Fire callbacks.
         Local<Function> cb = Nan::New(baton->callback);
@@ -484,6 +641,126 @@ void Statement::Work_AfterRun(uv_work_t* req) {
         }
     }
 
+    stmt->CountExecutions(1, baton->changes);
+
+    STATEMENT_END();
+}
+
+// Converts one element of a batch into parameters: an array binds by
+// position, a plain object by name and any other value to the first parameter.
+// Returns false if a value has an unsupported type, including undefined.
+bool Statement::ParseParameters(Local<Value> source, Parameters& parameters) {
+    if (source->IsArray()) {
+        Local<Array> array = Local<Array>::Cast(source);
+        int length = array->Length();
+        for (int i = 0, pos = 1; i < length; i++, pos++) {
+            Values::Field* field = BindParameter(Nan::Get(array, i).ToLocalChecked(), pos);
+            if (field == NULL) return false;
+            parameters.push_back(field);
+        }
+    }
+    else if (source->IsObject() && !source->IsRegExp() && !source->IsDate() && !Buffer::HasInstance(source)) {
+        Local<Object> object = Local<Object>::Cast(source);
+        Local<Array> array = Nan::GetPropertyNames(object).ToLocalChecked();
+        int length = array->Length();
+        for (int i = 0; i < length; i++) {
+            Local<Value> name = Nan::Get(array, i).ToLocalChecked();
+
+            Values::Field* field;
+            if (name->IsInt32()) {
+                field = BindParameter(Nan::Get(object, name).ToLocalChecked(), Nan::To<int32_t>(name).FromJust());
+            }
+            else {
+                field = BindParameter(Nan::Get(object, name).ToLocalChecked(), *Nan::Utf8String(name));
+            }
+            if (field == NULL) return false;
+            parameters.push_back(field);
+        }
+    }
+    else {
+        Values::Field* field = BindParameter(source, 1);
+        if (field == NULL) return false;
+        parameters.push_back(field);
+    }
+    return true;
+}
+
+// Runs the statement once for every element of an array of parameter sets
+// in a single trip to the thread pool.
+NAN_METHOD(Statement::RunBatch) {
+    Statement* stmt = Nan::ObjectWrap::Unwrap<Statement>(info.This());
+
+    if (info.Length() <= 0 || !info[0]->IsArray()) {
+        return Nan::ThrowTypeError("Argument 0 must be an array");
+    }
+    OPTIONAL_ARGUMENT_FUNCTION(1, callback);
+
+    RunBatchBaton* baton = new RunBatchBaton(stmt, callback);
+    Local<Array> rows = Local<Array>::Cast(info[0]);
+    int length = rows->Length();
+    baton->batch.resize(length);
+    for (int i = 0; i < length; i++) {
+        if (!stmt->ParseParameters(Nan::Get(rows, i).ToLocalChecked(), baton->batch[i])) {
+            delete baton;
+            return Nan::ThrowError("Data type is not supported");
+        }
+    }
+
+    stmt->Schedule(Work_BeginRunBatch, baton);
+    info.GetReturnValue().Set(info.This());
+}
+
+void Statement::Work_BeginRunBatch(Baton* baton) {
+    STATEMENT_BEGIN(RunBatch);
+}
+
+void Statement::Work_RunBatch(uv_work_t* req) {
+    STATEMENT_INIT(RunBatchBaton);
+
+    sqlite3_mutex* mtx = sqlite3_db_mutex(stmt->db->_handle);
+    EnterMutex(mtx, baton->request.lock_wait);
+
+    stmt->status = SQLITE_DONE;
+    for (unsigned int i = 0; i < baton->batch.size(); i++) {
+        // Bind() leaves the previous row's values when a row has none.
+        sqlite3_reset(stmt->_handle);
+        sqlite3_clear_bindings(stmt->_handle);
+        if (!stmt->Bind(baton->batch[i])) break;
+
+        stmt->status = Step(stmt->_handle);
+        if (!(stmt->status == SQLITE_ROW || stmt->status == SQLITE_DONE)) {
+            stmt->message = std::string(sqlite3_errmsg(stmt->db->_handle));
+            break;
+        }
+        baton->changes += sqlite3_changes(stmt->db->_handle);
+    }
+    baton->inserted_id = sqlite3_last_insert_rowid(stmt->db->_handle);
+
+    sqlite3_mutex_leave(mtx);
+}
+
+void Statement::Work_AfterRunBatch(uv_work_t* req) {
+    Nan::HandleScope scope;
+
+    STATEMENT_INIT(RunBatchBaton);
+
+    if (stmt->status != SQLITE_ROW && stmt->status != SQLITE_DONE) {
+        Error(baton);
+    }
+    else {
+        // Fire callbacks.
+        Local<Function> cb = Nan::New(baton->callback);
+        if (!cb.IsEmpty() && cb->IsFunction()) {
+            Nan::Set(stmt->handle(), Nan::New("lastID").ToLocalChecked(), Nan::New<Number>(baton->inserted_id));
+            Nan::Set(stmt->handle(), Nan::New("changes").ToLocalChecked(), Nan::New(baton->changes));
+
+            Local<Value> argv[] = { Nan::Null() };
+            TRY_CATCH_CALL(stmt->handle(), cb, 1, argv);
+        }
+    }
+
+    stmt->CountExecutions(baton->batch.size(), baton->changes);
+
     STATEMENT_END();
 }
 
@@ -508,7 +785,7 @@ void Statement::Work_All(uv_work_t* req) {
     STATEMENT_INIT(RowsBaton);
 
     sqlite3_mutex* mtx = sqlite3_db_mutex(stmt->db->_handle);
-    sqlite3_mutex_enter(mtx);
+    EnterMutex(mtx, baton->request.lock_wait);
 
     // Make sure that we also reset when there are no parameters.
     if (!baton->parameters.size()) {
@@ -516,9 +793,9 @@ void Statement::Work_All(uv_work_t* req) {
     }
 
     if (stmt->Bind(baton->parameters)) {
-        while ((stmt->status = sqlite3_step(stmt->_handle)) == SQLITE_ROW) {
+        while ((stmt->status = Step(stmt->_handle)) == SQLITE_ROW) {
             Row* row = new Row();
-            GetRow(row, stmt->_handle);
+            baton->result_bytes += GetRow(row, stmt->_handle);
             baton->rows.push_back(row);
         }
 
@@ -528,6 +805,7 @@ void Statement::Work_All(uv_work_t* req) {
     }
 
     sqlite3_mutex_leave(mtx);
+    stmt->db->AddPendingResultBytes(baton->result_bytes);
 }
 
 void Statement::Work_AfterAll(uv_work_t* req) {
@@ -538,6 +816,17 @@ void Statement::Work_AfterAll(uv_work_t* req) {
     if (stmt->status != SQLITE_DONE) {
         Error(baton);
     }
+    else if (!baton->resolver.IsEmpty()) {
+        Local<Array> result(Nan::New<Array>(baton->rows.size()));
+        Rows::const_iterator it = baton->rows.begin();
+        Rows::const_iterator end = baton->rows.end();
+        for (int i = 0; it < end; ++it, i++) {
+            Nan::Set(result, i, RowToJS(*it));
+            delete *it;
+        }
+        baton->rows.clear();
+        SettlePromise(stmt->handle(), baton->resolver, result);
+    }
     else {
         // Fire callbacks.
         Local<Function> cb = Nan::New(baton->callback);
@@ -566,6 +855,292 @@ void Statement::Work_AfterAll(uv_work_t* req) {
         }
     }
 
+    stmt->CountExecutions(1);
+
+    STATEMENT_END();
+}
+
+NAN_METHOD(Statement::Hash) {
+    Statement* stmt = Nan::ObjectWrap::Unwrap<Statement>(info.This());
+
+    Baton* baton = stmt->Bind<HashBaton>(info);
+    if (baton == NULL) {
+        return Nan::ThrowError("Data type is not supported");
+    }
+    else {
+        stmt->Schedule(Work_BeginHash, baton);
+        info.GetReturnValue().Set(info.This());
+    }
+}
+
+void Statement::Work_BeginHash(Baton* baton) {
+    STATEMENT_BEGIN(Hash);
+}
+
+// Appends a value to the row encoding: its type, then the value itself, with
+// the length in front of text and blobs so that no two rows encode alike.
+template <class T>
+static void EncodeColumn(T& buffer, sqlite3_stmt* stmt, int i) {
+    int type = sqlite3_column_type(stmt, i);
+    buffer.push_back((char)type);
+    switch (type) {
+        case SQLITE_INTEGER: {
+            sqlite3_int64 value = sqlite3_column_int64(stmt, i);
+            buffer.append((const char*)&value, sizeof(value));
+        } break;
+        case SQLITE_FLOAT: {
+            double value = sqlite3_column_double(stmt, i);
+            buffer.append((const char*)&value, sizeof(value));
+        } break;
+        case SQLITE_TEXT:
+        case SQLITE_BLOB: {
+            const char* data = type == SQLITE_TEXT ?
+                (const char*)sqlite3_column_text(stmt, i) :
+                (const char*)sqlite3_column_blob(stmt, i);
+            int32_t length = sqlite3_column_bytes(stmt, i);
+            buffer.append((const char*)&length, sizeof(length));
+            if (length > 0) buffer.append(data, length);
+        } break;
+    }
+}
+
+void Statement::Work_Hash(uv_work_t* req) {
+    STATEMENT_INIT(HashBaton);
+
+    sqlite3_mutex* mtx = sqlite3_db_mutex(stmt->db->_handle);
+    EnterMutex(mtx, baton->request.lock_wait);
+
+    // Make sure that we also reset when there are no parameters.
+    if (!baton->parameters.size()) {
+        sqlite3_reset(stmt->_handle);
+    }
+
+    if (stmt->Bind(baton->parameters)) {
+        // Column names go first, so renaming a column changes the hash. Each
+        // row is then hashed with the previous hash as its seed; the row
+        // encoding is the only memory the result needs.
+        std::string buffer;
+        int columns = sqlite3_column_count(stmt->_handle);
+        for (int i = 0; i < columns; i++) {
+            const char* name = sqlite3_column_name(stmt->_handle, i);
+            buffer.append(name, strlen(name) + 1);
+        }
+        uint64_t hash = Hash64::Compute(buffer.data(), buffer.size());
+
+        while ((stmt->status = Step(stmt->_handle)) == SQLITE_ROW) {
+            buffer.clear();
+            for (int i = 0; i < columns; i++) {
+                EncodeColumn(buffer, stmt->_handle, i);
+            }
+            hash = Hash64::Compute(buffer.data(), buffer.size(), hash);
+            baton->rows++;
+        }
+        baton->hash = hash;
+
+        if (stmt->status != SQLITE_DONE) {
+            stmt->message = std::string(sqlite3_errmsg(stmt->db->_handle));
+        }
+    }
+
+    sqlite3_mutex_leave(mtx);
+}
+
+void Statement::Work_AfterHash(uv_work_t* req) {
+    Nan::HandleScope scope;
+
+    STATEMENT_INIT(HashBaton);
+
+    if (stmt->status != SQLITE_DONE) {
+        Error(baton);
+    }
+    else {
+        // Fire callbacks.
+        Local<Function> cb = Nan::New(baton->callback);
+        if (!cb.IsEmpty() && cb->IsFunction()) {
+            // 64 bits don't fit into a Number, so the hash is a hex string.
+            char hex[17];
+            snprintf(hex, sizeof(hex), "%08x%08x",
+                (unsigned int)(baton->hash >> 32), (unsigned int)baton->hash);
+
+            Local<Object> result = Nan::New<Object>();
+            Nan::Set(result, Nan::New("hash").ToLocalChecked(), Nan::New(hex).ToLocalChecked());
+            Nan::Set(result, Nan::New("rows").ToLocalChecked(), Nan::New<Number>(baton->rows));
+
+            Local<Value> argv[] = { Nan::Null(), result };
+            TRY_CATCH_CALL(stmt->handle(), cb, 2, argv);
+        }
+    }
+
+    stmt->CountExecutions(1);
+
+    STATEMENT_END();
+}
+
+NAN_METHOD(Statement::AllPacked) {
+    Statement* stmt = Nan::ObjectWrap::Unwrap<Statement>(info.This());
+
+    Baton* baton = stmt->Bind<PackedBaton>(info);
+    if (baton == NULL) {
+        return Nan::ThrowError("Data type is not supported");
+    }
+    else {
+        stmt->Schedule(Work_BeginAllPacked, baton);
+        info.GetReturnValue().Set(info.This());
+    }
+}
+
+void Statement::Work_BeginAllPacked(Baton* baton) {
+    STATEMENT_BEGIN(AllPacked);
+}
+
+// A malloc()ed buffer that grows like std::string but can be handed to a
+// Buffer without another copy of the whole result. Appending fails once the
+// buffer would exceed `limit` or memory runs out.
+class PackedBuffer {
+public:
+    PackedBuffer(size_t limit_) :
+        data(NULL), size(0), capacity(0), limit(limit_), status(SQLITE_OK) {}
+    ~PackedBuffer() { free(data); }
+
+    void push_back(char c) {
+        append(&c, 1);
+    }
+
+    void append(const char* bytes, size_t length) {
+        if (status != SQLITE_OK) return;
+        if (length > limit - size) {
+            status = SQLITE_TOOBIG;
+            return;
+        }
+        if (size + length > capacity) {
+            size_t grown = std::max(std::min(capacity * 2, limit), std::max(size + length, (size_t)4096));
+            char* moved = (char*)realloc(data, grown);
+            if (moved == NULL) {
+                status = SQLITE_NOMEM;
+                return;
+            }
+            data = moved;
+            capacity = grown;
+        }
+        memcpy(data + size, bytes, length);
+        size += length;
+    }
+
+    void AppendUint32(uint32_t value) {
+        append((const char*)&value, sizeof(value));
+    }
+
+    // Hands the memory over to the caller.
+    char* Release() {
+        // Give back the slack of the last doubling if realloc() can.
+        char* released = (char*)realloc(data, size);
+        if (released == NULL) released = data;
+        data = NULL;
+        size = capacity = 0;
+        return released;
+    }
+
+    char* data;
+    size_t size;
+    size_t capacity;
+    size_t limit;
+    int status;
+};
+
+// Packs the result into one buffer that lib/resultset.js decodes lazily.
+// In native byte order:
+//   uint32 rows, uint32 columns, uint32 offset of the row index
+//   for every column: uint32 length, UTF-8 name
+//   for every row: its values as encoded by EncodeColumn()
+//   row index: uint32 offset of every row
+void Statement::Work_AllPacked(uv_work_t* req) {
+    STATEMENT_INIT(PackedBaton);
+
+    sqlite3_mutex* mtx = sqlite3_db_mutex(stmt->db->_handle);
+    EnterMutex(mtx, baton->request.lock_wait);
+
+    // Make sure that we also reset when there are no parameters.
+    if (!baton->parameters.size()) {
+        sqlite3_reset(stmt->_handle);
+    }
+
+    if (stmt->Bind(baton->parameters)) {
+        // Offsets are 32 bits, and the result has to fit into a Buffer.
+        PackedBuffer buffer(std::min((size_t)node::Buffer::kMaxLength, (size_t)0xffffffffu));
+        std::vector<uint32_t> offsets;
+        int columns = sqlite3_column_count(stmt->_handle);
+        buffer.AppendUint32(0);
+        buffer.AppendUint32(columns);
+        buffer.AppendUint32(0);
+        for (int i = 0; i < columns; i++) {
+            const char* name = sqlite3_column_name(stmt->_handle, i);
+            buffer.AppendUint32(strlen(name));
+            buffer.append(name, strlen(name));
+        }
+
+        while (buffer.status == SQLITE_OK &&
+               (stmt->status = Step(stmt->_handle)) == SQLITE_ROW) {
+            offsets.push_back(buffer.size);
+            for (int i = 0; i < columns; i++) {
+                EncodeColumn(buffer, stmt->_handle, i);
+            }
+        }
+
+        if (stmt->status == SQLITE_DONE) {
+            for (size_t i = 0; i < offsets.size(); i++) {
+                buffer.AppendUint32(offsets[i]);
+            }
+        }
+
+        if (buffer.status != SQLITE_OK) {
+            stmt->status = buffer.status;
+            stmt->message = buffer.status == SQLITE_TOOBIG ?
+                "Result is too large to pack" : "Out of memory";
+        }
+        else if (stmt->status == SQLITE_DONE) {
+            uint32_t rows = offsets.size();
+            uint32_t index = buffer.size - 4 * offsets.size();
+            memcpy(buffer.data, &rows, sizeof(rows));
+            memcpy(buffer.data + 8, &index, sizeof(index));
+
+            baton->size = buffer.size;
+            baton->data = buffer.Release();
+            baton->result_bytes = baton->size;
+            DebugStats::Count(DebugStats::ROW, baton->size);
+        }
+        else {
+            stmt->message = std::string(sqlite3_errmsg(stmt->db->_handle));
+        }
+    }
+
+    sqlite3_mutex_leave(mtx);
+    stmt->db->AddPendingResultBytes(baton->result_bytes);
+}
+
+void Statement::Work_AfterAllPacked(uv_work_t* req) {
+    Nan::HandleScope scope;
+
+    STATEMENT_INIT(PackedBaton);
+
+    if (stmt->status != SQLITE_DONE) {
+        Error(baton);
+    }
+    else {
+        // Fire callbacks.
+        Local<Function> cb = Nan::New(baton->callback);
+        if (!cb.IsEmpty() && cb->IsFunction()) {
+            // The buffer takes over the memory.
+            Local<Object> buffer = Nan::NewBuffer(baton->data, baton->size).ToLocalChecked();
+            baton->data = NULL;
+            DebugStats::Count(DebugStats::CONVERT);
+
+            Local<Value> argv[] = { Nan::Null(), buffer };
+            TRY_CATCH_CALL(stmt->handle(), cb, 2, argv);
+        }
+    }
+
+    stmt->CountExecutions(1);
+
     STATEMENT_END();
 }
 
@@ -617,14 +1192,16 @@ void Statement::Work_Each(uv_work_t* req) {
 
     if (stmt->Bind(baton->parameters)) {
         while (true) {
-            sqlite3_mutex_enter(mtx);
-            stmt->status = sqlite3_step(stmt->_handle);
+            EnterMutex(mtx, baton->request.lock_wait);
+            stmt->status = Step(stmt->_handle);
             if (stmt->status == SQLITE_ROW) {
                 sqlite3_mutex_leave(mtx);
                 Row* row = new Row();
-                GetRow(row, stmt->_handle);
-                NODE_SQLITE3_MUTEX_LOCK(&async->mutex)
+                size_t bytes = GetRow(row, stmt->_handle);
+                stmt->db->AddPendingResultBytes(bytes);
+                LockMutex(&async->mutex, async->lock_wait);
                 async->data.push_back(row);
+                async->pending_bytes += bytes;
                 retrieved++;
                 NODE_SQLITE3_MUTEX_UNLOCK(&async->mutex)
 
@@ -648,6 +1225,8 @@ void Statement::CloseCallback(uv_handle_t* handle) {
     assert(handle != NULL);
     assert(handle->data != NULL);
     Async* async = static_cast<Async*>(handle->data);
+    async->stmt->rows_wait.Add(async->lock_wait);
+    async->stmt->db->rows_wait.Add(async->lock_wait);
     delete async;
 }
 
@@ -659,13 +1238,16 @@ void Statement::AsyncEach(uv_async_t* handle, int status) {
     while (true) {
         // Get the contents out of the data cache for us to process in the JS callback.
         Rows rows;
-        NODE_SQLITE3_MUTEX_LOCK(&async->mutex)
+        LockMutex(&async->mutex, async->lock_wait);
         rows.swap(async->data);
+        int64_t bytes = async->pending_bytes;
+        async->pending_bytes = 0;
         NODE_SQLITE3_MUTEX_UNLOCK(&async->mutex)
 
         if (rows.empty()) {
             break;
         }
+        async->stmt->db->AddPendingResultBytes(-bytes);
 
         Local<Function> cb = Nan::New(async->item_cb);
         if (!cb.IsEmpty() && cb->IsFunction()) {
@@ -706,6 +1288,8 @@ void Statement::Work_AfterEach(uv_work_t* req) {
         Error(baton);
     }
 
+    stmt->CountExecutions(1);
+
     STATEMENT_END();
 }
 
@@ -761,18 +1345,23 @@ Local<Object> Statement::RowToJS(Row* row) {
         switch (field->type) {
             case SQLITE_INTEGER: {
                 value = Nan::New<Number>(((Values::Integer*)field)->value);
+                DebugStats::Count(DebugStats::CONVERT);
             } break;
             case SQLITE_FLOAT: {
                 value = Nan::New<Number>(((Values::Float*)field)->value);
+                DebugStats::Count(DebugStats::CONVERT);
             } break;
             case SQLITE_TEXT: {
                 value = Nan::New<String>(((Values::Text*)field)->value.c_str(), ((Values::Text*)field)->value.size()).ToLocalChecked();
+                DebugStats::Count(DebugStats::CONVERT, ((Values::Text*)field)->value.size());
             } break;
             case SQLITE_BLOB: {
                 value = Nan::CopyBuffer(((Values::Blob*)field)->value, ((Values::Blob*)field)->length).ToLocalChecked();
+                DebugStats::Count(DebugStats::CONVERT, ((Values::Blob*)field)->length);
             } break;
             case SQLITE_NULL: {
                 value = Nan::Null();
+                DebugStats::Count(DebugStats::CONVERT);
             } break;
         }
 
@@ -784,28 +1373,36 @@ Local<Object> Statement::RowToJS(Row* row) {
     return scope.Escape(result);
 }
 
-void Statement::GetRow(Row* row, sqlite3_stmt* stmt) {
+size_t Statement::GetRow(Row* row, sqlite3_stmt* stmt) {
     int rows = sqlite3_column_count(stmt);
+    size_t bytes = 0;
 
     for (int i = 0; i < rows; i++) {
         int type = sqlite3_column_type(stmt, i);
         const char* name = sqlite3_column_name(stmt, i);
+        if (type != SQLITE_TEXT && type != SQLITE_BLOB) DebugStats::Count(DebugStats::ROW);
         switch (type) {
             case SQLITE_INTEGER: {
                 row->push_back(new Values::Integer(name, sqlite3_column_int64(stmt, i)));
+                bytes += sizeof(sqlite3_int64);
             }   break;
             case SQLITE_FLOAT: {
                 row->push_back(new Values::Float(name, sqlite3_column_double(stmt, i)));
+                bytes += sizeof(double);
             }   break;
             case SQLITE_TEXT: {
                 const char* text = (const char*)sqlite3_column_text(stmt, i);
                 int length = sqlite3_column_bytes(stmt, i);
+                DebugStats::Count(DebugStats::ROW, length);
                 row->push_back(new Values::Text(name, length, text));
+                bytes += length;
             } break;
             case SQLITE_BLOB: {
                 const void* blob = sqlite3_column_blob(stmt, i);
                 int length = sqlite3_column_bytes(stmt, i);
+                DebugStats::Count(DebugStats::ROW, length);
                 row->push_back(new Values::Blob(name, length, blob));
+                bytes += length;
             }   break;
             case SQLITE_NULL: {
                 row->push_back(new Values::Null(name));
@@ -814,6 +1411,8 @@ void Statement::GetRow(Row* row, sqlite3_stmt* stmt) {
                 assert(false);
         }
     }
+
+    return bytes;
 }
 
 NAN_METHOD(Statement::Finalize) {
@@ -826,6 +1425,84 @@ NAN_METHOD(Statement::Finalize) {
     info.GetReturnValue().Set(stmt->db->handle());
 }
 
+static Local<Object> LockWaitToJS(const LockWait& wait) {
+    Local<Object> result = Nan::New<Object>();
+    Nan::Set(result, Nan::New("acquisitions").ToLocalChecked(), Nan::New<Number>((double)wait.acquisitions));
+    Nan::Set(result, Nan::New("contentions").ToLocalChecked(), Nan::New<Number>((double)wait.contentions));
+    Nan::Set(result, Nan::New("waitTime").ToLocalChecked(), Nan::New<Number>((double)wait.nanoseconds / 1e6));
+    return result;
+}
+
+// Waits for the connection mutex by operations that completed, and for the
+// row buffers of each() calls that completed, in milliseconds.
+NAN_METHOD(Statement::GetLockStats) {
+    Statement* stmt = Nan::ObjectWrap::Unwrap<Statement>(info.This());
+    bool reset = info.Length() > 0 && Nan::To<bool>(info[0]).FromJust();
+
+    Local<Object> result = Nan::New<Object>();
+    Nan::Set(result, Nan::New("connection").ToLocalChecked(), LockWaitToJS(stmt->connection_wait));
+    Nan::Set(result, Nan::New("rows").ToLocalChecked(), LockWaitToJS(stmt->rows_wait));
+
+    if (reset) {
+        stmt->connection_wait = LockWait();
+        stmt->rows_wait = LockWait();
+    }
+
+    info.GetReturnValue().Set(result);
+}
+
+#ifdef NODE_SQLITE3_PROMISES
+
+// Promise variants of the methods above. They schedule the same work with a
+// resolver in place of the callback and return its promise.
+template <class T> void Statement::SchedulePromise(Nan::NAN_METHOD_ARGS_TYPE info, Work_Callback callback) {
+    Local<PromiseResolver> resolver = NewResolver();
+    info.GetReturnValue().Set(resolver->GetPromise());
+
+    T* baton = Bind<T>(info);
+    if (baton == NULL) {
+        Nan::Persistent<PromiseResolver> persistent(resolver);
+        SettlePromise(handle(), persistent, Exception::Error(
+            Nan::New("Data type is not supported").ToLocalChecked()), true);
+        return;
+    }
+    baton->resolver.Reset(resolver);
+    Schedule(callback, baton);
+}
+
+NAN_METHOD(Statement::BindAsync) {
+    Statement* stmt = Nan::ObjectWrap::Unwrap<Statement>(info.This());
+    stmt->SchedulePromise<Baton>(info, Work_BeginBind);
+}
+
+NAN_METHOD(Statement::GetAsync) {
+    Statement* stmt = Nan::ObjectWrap::Unwrap<Statement>(info.This());
+    stmt->SchedulePromise<RowBaton>(info, Work_BeginGet);
+}
+
+NAN_METHOD(Statement::RunAsync) {
+    Statement* stmt = Nan::ObjectWrap::Unwrap<Statement>(info.This());
+    stmt->SchedulePromise<RunBaton>(info, Work_BeginRun);
+}
+
+NAN_METHOD(Statement::AllAsync) {
+    Statement* stmt = Nan::ObjectWrap::Unwrap<Statement>(info.This());
+    stmt->SchedulePromise<RowsBaton>(info, Work_BeginAll);
+}
+
+NAN_METHOD(Statement::FinalizeAsync) {
+    Statement* stmt = Nan::ObjectWrap::Unwrap<Statement>(info.This());
+    Local<PromiseResolver> resolver = NewResolver();
+
+    Baton* baton = new Baton(stmt, Local<Function>());
+    baton->resolver.Reset(resolver);
+    stmt->Schedule(Finalize, baton);
+
+    info.GetReturnValue().Set(resolver->GetPromise());
+}
+
+#endif
+
 void Statement::Finalize(Baton* baton) {
     Nan::HandleScope scope;
 
@@ -833,7 +1510,10 @@ void Statement::Finalize(Baton* baton) {
 
     // Fire callback in case there was one.
     Local<Function> cb = Nan::New(baton->callback);
-    if (!cb.IsEmpty() && cb->IsFunction()) {
+    if (!baton->resolver.IsEmpty()) {
+        SettlePromise(baton->stmt->handle(), baton->resolver, Nan::Undefined());
+    }
+    else if (!cb.IsEmpty() && cb->IsFunction()) {
         TRY_CATCH_CALL(baton->stmt->handle(), cb, 0, NULL);
     }
 
@@ -844,13 +1524,46 @@ void Statement::Finalize() {
     assert(!finalized);
     finalized = true;
     CleanQueue();
+    // A query on the thread pool may hold the connection while it waits for
+    // the main thread to run a JavaScript function.
+    if (!db->functions.empty()) return FinalizeLater();
     // Finalize returns the status code of the last operation. We already fired
     // error events in case those failed.
+    db->LockHandle();
     sqlite3_finalize(_handle);
+    db->UnlockHandle();
     _handle = NULL;
     db->Unref();
 }
 
+// Finalizes in the thread pool, where waiting for the connection doesn't
+// block JavaScript functions. The statement's reference to the database is
+// handed to the baton. This may run during garbage collection, so it leaves
+// the database's queue alone; Work_Close finalizes the statement instead if
+// it comes first.
+void Statement::FinalizeLater() {
+    FinalizeBaton* baton = new FinalizeBaton(this);
+    db->AddOrphan(_handle);
+    _handle = NULL;
+    int status = Timeline::Queue(&baton->request, "Statement.Finalize",
+        Work_FinalizeLater, (uv_after_work_cb)Work_AfterFinalizeLater);
+    assert(status == 0);
+}
+
+void Statement::Work_FinalizeLater(uv_work_t* req) {
+    FinalizeBaton* baton = static_cast<FinalizeBaton*>(req->data);
+    baton->db->FinalizeOrphan(baton->handle, baton->request.lock_wait);
+}
+
+void Statement::Work_AfterFinalizeLater(uv_work_t* req) {
+    Nan::HandleScope scope;
+
+    FinalizeBaton* baton = static_cast<FinalizeBaton*>(req->data);
+    baton->db->Unref();
+
+    delete baton;
+}
+
 void Statement::CleanQueue() {
     Nan::HandleScope scope;
 
@@ -868,7 +1581,11 @@ void Statement::CleanQueue() {
 
             Local<Function> cb = Nan::New(call->baton->callback);
 
-            if (prepared && !cb.IsEmpty() &&
+            if (!call->baton->resolver.IsEmpty()) {
+                SettlePromise(handle(), call->baton->resolver, exception, true);
+                called = true;
+            }
+            else if (prepared && !cb.IsEmpty() &&
                 cb->IsFunction()) {
                 TRY_CATCH_CALL(handle(), cb, 1, argv);
                 called = true;
@@ -889,10 +1606,16 @@ void Statement::CleanQueue() {
     }
     else while (!queue.empty()) {
         // Just delete all items in the queue; we already fired an event when
-        // preparing the statement failed.
+        // preparing the statement failed. Promises have no other way to
+        // learn about it, so they are rejected with the same error.
         Call* call = queue.front();
         queue.pop();
 
+        if (!call->baton->resolver.IsEmpty()) {
+            EXCEPTION(Nan::New(message.c_str()).ToLocalChecked(), status, exception);
+            SettlePromise(handle(), call->baton->resolver, exception, true);
+        }
+
         // We don't call the actual callback, so we have to make sure that
         // the baton gets destroyed.
         delete call->baton;
@@ -79,14 +79,21 @@ public:
     static NAN_METHOD(New);
 
     struct Baton {
-        uv_work_t request;
+        Timeline::Request request;
         Statement* stmt;
         Nan::Persistent<Function> callback;
+        // Set instead of the callback by promise-returning methods.
+        Nan::Persistent<PromiseResolver> resolver;
         Parameters parameters;
+        // Bytes of fetched rows, counted as pending results until the baton
+        // is deleted.
+        int64_t result_bytes;
 
-        Baton(Statement* stmt_, Local<Function> cb_) : stmt(stmt_) {
+        Baton(Statement* stmt_, Local<Function> cb_) : stmt(stmt_), result_bytes(0) {
+            DebugStats::Count(DebugStats::BATON);
             stmt->Ref();
             request.data = this;
+            request.Enqueue(&stmt->db->operations, stmt->db->id, stmt->id, &stmt->connection_wait);
             callback.Reset(cb_);
         }
         virtual ~Baton() {
@@ -94,8 +101,21 @@ public:
                 Values::Field* field = parameters[i];
                 DELETE_FIELD(field);
             }
+            stmt->db->AddPendingResultBytes(-result_bytes);
             stmt->Unref();
             callback.Reset();
+            resolver.Reset();
+        }
+    };
+
+    struct FinalizeBaton {
+        Timeline::Request request;
+        Database* db;
+        sqlite3_stmt* handle;
+
+        FinalizeBaton(Statement* stmt_) : db(stmt_->db), handle(stmt_->_handle) {
+            request.data = this;
+            request.Enqueue(&db->operations, db->id, stmt_->id);
         }
     };
 
@@ -112,12 +132,47 @@ public:
         int changes;
     };
 
+    struct RunBatchBaton : Baton {
+        RunBatchBaton(Statement* stmt_, Local<Function> cb_) :
+            Baton(stmt_, cb_), inserted_id(0), changes(0) {}
+        virtual ~RunBatchBaton() {
+            for (unsigned int i = 0; i < batch.size(); i++) {
+                for (unsigned int j = 0; j < batch[i].size(); j++) {
+                    Values::Field* field = batch[i][j];
+                    DELETE_FIELD(field);
+                }
+            }
+        }
+        std::vector<Parameters> batch;
+        sqlite3_int64 inserted_id;
+        int changes;
+    };
+
     struct RowsBaton : Baton {
         RowsBaton(Statement* stmt_, Local<Function> cb_) :
             Baton(stmt_, cb_) {}
         Rows rows;
     };
 
+    // Result rows packed into one malloc()ed buffer, which is handed to a
+    // Buffer without copying.
+    struct PackedBaton : Baton {
+        PackedBaton(Statement* stmt_, Local<Function> cb_) :
+            Baton(stmt_, cb_), data(NULL), size(0) {}
+        virtual ~PackedBaton() {
+            free(data);
+        }
+        char* data;
+        size_t size;
+    };
+
+    struct HashBaton : Baton {
+        HashBaton(Statement* stmt_, Local<Function> cb_) :
+            Baton(stmt_, cb_), hash(0), rows(0) {}
+        uint64_t hash;
+        sqlite3_int64 rows;
+    };
+
     struct Async;
 
     struct EachBaton : Baton {
@@ -137,6 +192,8 @@ public:
         PrepareBaton(Database* db_, Local<Function> cb_, Statement* stmt_) :
             Baton(db_, cb_), stmt(stmt_) {
             stmt->Ref();
+            request.span.statement = stmt->id;
+            request.statement_wait = &stmt->connection_wait;
         }
         virtual ~PrepareBaton() {
             stmt->Unref();
@@ -151,7 +208,9 @@ public:
     typedef void (*Work_Callback)(Baton* baton);
 
     struct Call {
-        Call(Work_Callback cb_, Baton* baton_) : callback(cb_), baton(baton_) {};
+        Call(Work_Callback cb_, Baton* baton_) : callback(cb_), baton(baton_) {
+            DebugStats::Count(DebugStats::CALL);
+        };
         Work_Callback callback;
         Baton* baton;
     };
@@ -163,6 +222,10 @@ public:
         NODE_SQLITE3_MUTEX_t;
         bool completed;
         int retrieved;
+        // Bytes of the rows in `data`.
+        int64_t pending_bytes;
+        // Waits for `mutex` on both sides, protected by it.
+        LockWait lock_wait;
 
         // Store the callbacks here because we don't have
         // access to the baton in the async callback.
@@ -170,7 +233,7 @@ public:
         Nan::Persistent<Function> completed_cb;
 
         Async(Statement* st, uv_async_cb async_cb) :
-                stmt(st), completed(false), retrieved(0) {
+                stmt(st), completed(false), retrieved(0), pending_bytes(0) {
             watcher.data = this;
             NODE_SQLITE3_MUTEX_INIT
             stmt->Ref();
@@ -187,6 +250,7 @@ public:
 
     Statement(Database* db_) : Nan::ObjectWrap(),
             db(db_),
+            id(Timeline::NextStatement()),
             _handle(NULL),
             status(SQLITE_OK),
             prepared(false),
@@ -202,11 +266,21 @@ public:
     WORK_DEFINITION(Bind);
     WORK_DEFINITION(Get);
     WORK_DEFINITION(Run);
+    WORK_DEFINITION(RunBatch);
     WORK_DEFINITION(All);
     WORK_DEFINITION(Each);
+    WORK_DEFINITION(Hash);
+    WORK_DEFINITION(AllPacked);
     WORK_DEFINITION(Reset);
 
     static NAN_METHOD(Finalize);
+    static NAN_METHOD(GetLockStats);
+
+    static NAN_METHOD(BindAsync);
+    static NAN_METHOD(GetAsync);
+    static NAN_METHOD(RunAsync);
+    static NAN_METHOD(AllAsync);
+    static NAN_METHOD(FinalizeAsync);
 
 protected:
     static void Work_BeginPrepare(Database::Baton* baton);
@@ -218,12 +292,26 @@ protected:
 
     static void Finalize(Baton* baton);
     void Finalize();
+    void FinalizeLater();
+    static void Work_FinalizeLater(uv_work_t* req);
+    static void Work_AfterFinalizeLater(uv_work_t* req);
 
     template <class T> inline Values::Field* BindParameter(const Local<Value> source, T pos);
     template <class T> T* Bind(Nan::NAN_METHOD_ARGS_TYPE info, int start = 0, int end = -1);
+    template <class T> void SchedulePromise(Nan::NAN_METHOD_ARGS_TYPE info, Work_Callback callback);
+    bool ParseParameters(Local<Value> source, Parameters& parameters);
+    void CollectTableStats();
+    void CountExecutions(int executions, int changes = 0);
     bool Bind(const Parameters &parameters);
 
-    static void GetRow(Row* row, sqlite3_stmt* stmt);
+    static int Step(sqlite3_stmt* handle);
+    static int Prepare(sqlite3* db, const std::string& sql, sqlite3_stmt** handle);
+#ifdef SQLITE_ENABLE_UNLOCK_NOTIFY
+    static int WaitForUnlock(sqlite3* db);
+#endif
+
+    // Returns the bytes of the values that were copied.
+    static size_t GetRow(Row* row, sqlite3_stmt* stmt);
     static Local<Object> RowToJS(Row* row);
     void Schedule(Work_Callback callback, Baton* baton);
     void Process();
@@ -232,6 +320,8 @@ protected:
 
 protected:
     Database* db;
+    // Identifies the statement in timeline spans.
+    unsigned int id;
 
     sqlite3_stmt* _handle;
     int status;
@@ -241,6 +331,17 @@ protected:
     bool locked;
     bool finalized;
     std::queue<Call*> queue;
+
+    // Collected by the authorizer while preparing, then resolved to the
+    // statistics of the tables read and written.
+    std::vector<Database::TableAccess> access;
+    std::vector<Database::TableStats*> read_tables;
+    std::vector<Database::TableStats*> written_tables;
+
+    // Waits of this statement's operations for the connection mutex and
+    // of its each() calls for their row buffers.
+    LockWait connection_wait;
+    LockWait rows_wait;
 };
 
 }
@@ -12,6 +12,8 @@
 
     #define NODE_SQLITE3_MUTEX_LOCK(m) WaitForSingleObject(*m, INFINITE);
 
+    #define NODE_SQLITE3_MUTEX_TRYLOCK(m) (WaitForSingleObject(*m, 0) == WAIT_OBJECT_0)
+
     #define NODE_SQLITE3_MUTEX_UNLOCK(m) ReleaseMutex(*m);
 
     #define NODE_SQLITE3_MUTEX_DESTROY CloseHandle(mutex);
@@ -26,6 +28,8 @@
 
     #define NODE_SQLITE3_MUTEX_LOCK(m) (*m).lock();
 
+    #define NODE_SQLITE3_MUTEX_TRYLOCK(m) (*m).try_lock()
+
     #define NODE_SQLITE3_MUTEX_UNLOCK(m) (*m).unlock();
 
     #define NODE_SQLITE3_MUTEX_DESTROY mutex.unlock();
@@ -38,6 +42,8 @@
 
     #define NODE_SQLITE3_MUTEX_LOCK(m) pthread_mutex_lock(m);
 
+    #define NODE_SQLITE3_MUTEX_TRYLOCK(m) (pthread_mutex_trylock(m) == 0)
+
     #define NODE_SQLITE3_MUTEX_UNLOCK(m) pthread_mutex_unlock(m);
 
     #define NODE_SQLITE3_MUTEX_DESTROY pthread_mutex_destroy(&mutex);
@@ -45,4 +51,21 @@
 #endif
 
 
+#ifdef _MSC_VER
+    #define NODE_SQLITE3_THREAD_LOCAL __declspec(thread)
+#else
+    #define NODE_SQLITE3_THREAD_LOCAL __thread
+#endif
+
+
+// Adds to an int64_t and returns its previous value.
+#ifdef _MSC_VER
+    #define NODE_SQLITE3_ATOMIC_ADD(ptr, value) \
+        InterlockedExchangeAdd64((volatile LONGLONG*)(ptr), (LONGLONG)(value))
+#else
+    #define NODE_SQLITE3_ATOMIC_ADD(ptr, value) \
+        __sync_fetch_and_add((ptr), (int64_t)(value))
+#endif
+
+
 #endif // NODE_SQLITE3_SRC_THREADING_H
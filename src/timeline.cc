@@ -0,0 +1,114 @@
+#include "timeline.h"
+
+using namespace node_sqlite3;
+
+bool Timeline::recording = false;
+uint64_t Timeline::last_id = 0;
+uint64_t Timeline::origin = 0;
+unsigned int Timeline::last_connection = 0;
+unsigned int Timeline::last_statement = 0;
+std::vector<Span> Timeline::spans;
+size_t Timeline::next = 0;
+size_t Timeline::count = 0;
+
+int Timeline::Queue(Request* request, const char* name, uv_work_cb work, uv_after_work_cb after) {
+    if (!recording) request->span.id = 0;
+    request->span.name = name;
+    request->span.dequeued = uv_hrtime();
+    request->work = work;
+    request->after = after;
+    return uv_queue_work(uv_default_loop(), request, Work, After);
+}
+
+void Timeline::Work(uv_work_t* req) {
+    Request* request = static_cast<Request*>(req);
+    request->span.work_start = uv_hrtime();
+    request->work(req);
+    request->span.work_end = uv_hrtime();
+}
+
+void Timeline::After(uv_work_t* req, int status) {
+    Request* request = static_cast<Request*>(req);
+    // The callback deletes the baton that owns the request.
+    Span span = request->span;
+    uv_after_work_cb after = request->after;
+
+    span.after_start = uv_hrtime();
+    span.lock_wait = request->lock_wait.nanoseconds;
+    if (request->stats) {
+        request->stats->latency.Observe((double)(span.after_start - span.enqueued) / 1e9);
+        if (request->lock_wait.acquisitions) {
+            request->stats->lock_waits[span.name].Add(request->lock_wait);
+        }
+    }
+    if (request->statement_wait) {
+        request->statement_wait->Add(request->lock_wait);
+    }
+    after(req, status);
+
+    if (span.id) {
+        span.after_end = uv_hrtime();
+        Record(span);
+    }
+}
+
+void Timeline::Record(const Span& span) {
+    // Spans that started before the timeline was (re)started are dropped.
+    if (!recording || spans.empty() || span.enqueued < origin) return;
+    spans[next] = span;
+    next = (next + 1) % spans.size();
+    if (count < spans.size()) count++;
+}
+
+NAN_METHOD(Timeline::Start) {
+    int capacity = 10000;
+    if (info.Length() > 0 && info[0]->IsInt32()) {
+        capacity = Nan::To<int>(info[0]).FromJust();
+    }
+    if (capacity <= 0) {
+        return Nan::ThrowRangeError("Timeline capacity must be positive");
+    }
+
+    spans.assign(capacity, Span());
+    next = 0;
+    count = 0;
+    origin = uv_hrtime();
+    recording = true;
+}
+
+NAN_METHOD(Timeline::Stop) {
+    recording = false;
+}
+
+static inline Local<Number> Microseconds(uint64_t time, uint64_t origin) {
+    return Nan::New<Number>((double)(time - origin) / 1000.0);
+}
+
+NAN_METHOD(Timeline::Spans) {
+    bool clear = info.Length() > 0 && Nan::To<bool>(info[0]).FromJust();
+
+    Local<Array> result = Nan::New<Array>(count);
+    for (size_t i = 0; i < count; i++) {
+        const Span& span = spans[(next + spans.size() - count + i) % spans.size()];
+        Local<Object> item = Nan::New<Object>();
+        Nan::Set(item, Nan::New("id").ToLocalChecked(), Nan::New<Number>((double)span.id));
+        Nan::Set(item, Nan::New("name").ToLocalChecked(), Nan::New(span.name).ToLocalChecked());
+        Nan::Set(item, Nan::New("connection").ToLocalChecked(), Nan::New<Number>(span.connection));
+        Nan::Set(item, Nan::New("statement").ToLocalChecked(), Nan::New<Number>(span.statement));
+        Nan::Set(item, Nan::New("enqueued").ToLocalChecked(), Microseconds(span.enqueued, origin));
+        Nan::Set(item, Nan::New("dequeued").ToLocalChecked(), Microseconds(span.dequeued, origin));
+        Nan::Set(item, Nan::New("workStart").ToLocalChecked(), Microseconds(span.work_start, origin));
+        Nan::Set(item, Nan::New("workEnd").ToLocalChecked(), Microseconds(span.work_end, origin));
+        Nan::Set(item, Nan::New("afterStart").ToLocalChecked(), Microseconds(span.after_start, origin));
+        Nan::Set(item, Nan::New("afterEnd").ToLocalChecked(), Microseconds(span.after_end, origin));
+        Nan::Set(item, Nan::New("lockWait").ToLocalChecked(), Nan::New<Number>((double)span.lock_wait / 1000.0));
+        Nan::Set(result, i, item);
+    }
+
+    if (clear) {
+        next = 0;
+        count = 0;
+    }
+
+    info.GetReturnValue().Set(result);
+}
@@ -0,0 +1,101 @@
+#ifndef NODE_SQLITE3_SRC_TIMELINE_H
+#define NODE_SQLITE3_SRC_TIMELINE_H
+
+#include <stdint.h>
+#include <vector>
+
+#include <nan.h>
+
+#include "metrics.h"
+
+using namespace v8;
+
+namespace node_sqlite3 {
+
+// Phases of one operation, as uv_hrtime() timestamps:
+//   enqueued: the baton was created, e.g. by db.run()
+//   dequeued: Database::Process() or Statement::Process() let it run
+//   work:     it ran on the thread pool
+//   after:    its callback ran on the main thread
+struct Span {
+    uint64_t id;
+    const char* name;
+    unsigned int connection;
+    unsigned int statement;
+    uint64_t enqueued;
+    uint64_t dequeued;
+    uint64_t work_start;
+    uint64_t work_end;
+    uint64_t after_start;
+    uint64_t after_end;
+    // Time the work phase waited for the connection mutex.
+    uint64_t lock_wait;
+};
+
+// Records the spans of operations while sqlite3.timeline is started. The
+// most recent spans are kept in a buffer of fixed capacity. Except for the
+// work phase, everything happens on the main thread.
+class Timeline {
+public:
+    // The uv_work_t of a baton. Work queued with Timeline::Queue() reports
+    // its latency and `lock_wait` to `stats` and `statement_wait`, and
+    // records its span when the timeline is started.
+    struct Request : uv_work_t {
+        Request() : work(NULL), after(NULL), stats(NULL), statement_wait(NULL) {
+            span.id = 0;
+        }
+
+        // Called when the baton is created.
+        inline void Enqueue(OperationStats* stats_, unsigned int connection,
+                            unsigned int statement = 0, LockWait* statement_wait_ = NULL) {
+            stats = stats_;
+            statement_wait = statement_wait_;
+            span.id = recording ? ++last_id : 0;
+            span.connection = connection;
+            span.statement = statement;
+            span.enqueued = uv_hrtime();
+            span.dequeued = span.enqueued;
+        }
+
+        Span span;
+        uv_work_cb work;
+        uv_after_work_cb after;
+        OperationStats* stats;
+        LockWait* statement_wait;
+        // Filled in by the work function.
+        LockWait lock_wait;
+    };
+
+    // Replaces uv_queue_work() for batons.
+    static int Queue(Request* request, const char* name, uv_work_cb work, uv_after_work_cb after);
+
+    static unsigned int NextConnection() { return ++last_connection; }
+    static unsigned int NextStatement() { return ++last_statement; }
+
+    // sqlite3.startTimeline([capacity])
+    static NAN_METHOD(Start);
+    // sqlite3.stopTimeline()
+    static NAN_METHOD(Stop);
+    // sqlite3.timelineSpans([clear])
+    static NAN_METHOD(Spans);
+
+private:
+    static void Work(uv_work_t* req);
+    static void After(uv_work_t* req, int status);
+    static void Record(const Span& span);
+
+    static bool recording;
+    static uint64_t last_id;
+    static uint64_t origin;
+    static unsigned int last_connection;
+    static unsigned int last_statement;
+
+    // Ring buffer of the most recent spans.
+    static std::vector<Span> spans;
+    static size_t next;
+    static size_t count;
+};
+
+}
+
+#endif
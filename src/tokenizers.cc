@@ -0,0 +1,178 @@
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "functions.h"
+#include "unicode.h"
+
+namespace node_sqlite3 {
+
+// Two FTS5 tokenizers that fold case and, by default, diacritics:
+//
+//   tokenize = "ngram [n N] [remove_diacritics 0|1]"
+//       Emits every run of N (default 3) consecutive characters of each
+//       word, so MATCH finds arbitrary substrings of at least N characters.
+//       Use n 2 for CJK text, which has no spaces between words. Words
+//       shorter than N are emitted whole.
+//
+//   tokenize = "fold [remove_diacritics 0|1]"
+//       Emits whole words, like unicode61, but also strips the accents
+//       of Greek and of the Vietnamese and other Latin Extended letters.
+//
+// Words are runs of letters and digits; ASCII punctuation, Latin-1
+// symbols, general and CJK punctuation separate them.
+struct FoldTokenizer {
+    FoldTokenizer() : ngram(0), remove_diacritics(true) {}
+    int ngram;
+    bool remove_diacritics;
+};
+
+// A folded character and the byte range it came from.
+struct TokenChar {
+    uint32_t c;
+    int start;
+    int end;
+};
+
+typedef int (*TokenCallback)(void* context, int flags, const char* token, int length, int start, int end);
+
+static bool IsSeparator(uint32_t c) {
+    if (c < 0x80) {
+        return !((c >= '0' && c <= '9') || (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z'));
+    }
+    return (c < 0xC0 && c != 0xAA && c != 0xB5 && c != 0xBA) || c == 0xD7 || c == 0xF7 ||
+        (c >= 0x2000 && c <= 0x206F) || (c >= 0x3000 && c <= 0x303F) ||
+        (c >= 0xFF00 && c <= 0xFF0F) || (c >= 0xFF1A && c <= 0xFF20) ||
+        (c >= 0xFF3B && c <= 0xFF40) || (c >= 0xFF5B && c <= 0xFF65);
+}
+
+static int EmitToken(const std::vector<TokenChar>& word, size_t first, size_t count,
+                     std::string& buffer, void* context, TokenCallback callback) {
+    char bytes[4];
+    buffer.clear();
+    for (size_t i = first; i < first + count; i++) {
+        buffer.append(bytes, EncodeUtf8(word[i].c, bytes));
+    }
+    return callback(context, 0, buffer.data(), (int)buffer.size(),
+        word[first].start, word[first + count - 1].end);
+}
+
+static int EmitWord(FoldTokenizer* tokenizer, const std::vector<TokenChar>& word,
+                    std::string& buffer, void* context, TokenCallback callback) {
+    size_t n = tokenizer->ngram;
+    if (word.empty()) return SQLITE_OK;
+    if (n == 0 || word.size() <= n) {
+        return EmitToken(word, 0, word.size(), buffer, context, callback);
+    }
+    int status = SQLITE_OK;
+    for (size_t i = 0; i + n <= word.size() && status == SQLITE_OK; i++) {
+        status = EmitToken(word, i, n, buffer, context, callback);
+    }
+    return status;
+}
+
+static int FoldTokenize(Fts5Tokenizer* instance, void* context, int flags,
+                        const char* text, int length, TokenCallback callback) {
+    FoldTokenizer* tokenizer = reinterpret_cast<FoldTokenizer*>(instance);
+    const unsigned char* start = (const unsigned char*)text;
+    const unsigned char* end = start + length;
+    const unsigned char* p = start;
+    std::vector<TokenChar> word;
+    std::string buffer;
+    int status = SQLITE_OK;
+
+    while (p < end && status == SQLITE_OK) {
+        int offset = (int)(p - start);
+        uint32_t c = DecodeUtf8(p, end);
+
+        if (IsCombiningMark(c)) {
+            // Marks belong to the previous character; without diacritics
+            // they only widen its byte range.
+            if (tokenizer->remove_diacritics) {
+                if (!word.empty()) word.back().end = (int)(p - start);
+                continue;
+            }
+        }
+        else if (IsSeparator(c)) {
+            status = EmitWord(tokenizer, word, buffer, context, callback);
+            word.clear();
+            continue;
+        }
+
+        c = FoldCase(c);
+        // Fold again: some base letters (e.g. of Greek title case) are
+        // uppercase.
+        if (tokenizer->remove_diacritics) c = FoldCase(RemoveDiacritic(c));
+        TokenChar token = { c, offset, (int)(p - start) };
+        word.push_back(token);
+    }
+    if (status == SQLITE_OK) status = EmitWord(tokenizer, word, buffer, context, callback);
+    return status;
+}
+
+static int CreateFoldTokenizer(void* context, const char** args, int count, Fts5Tokenizer** out) {
+    FoldTokenizer* tokenizer = new FoldTokenizer();
+    bool ngram = context != NULL;
+    if (ngram) tokenizer->ngram = 3;
+
+    for (int i = 0; i < count; i += 2) {
+        const char* value = i + 1 < count ? args[i + 1] : NULL;
+        bool valid = false;
+        if (ngram && value && strcmp(args[i], "n") == 0) {
+            tokenizer->ngram = atoi(value);
+            valid = tokenizer->ngram >= 1 && tokenizer->ngram <= 16;
+        }
+        else if (value && strcmp(args[i], "remove_diacritics") == 0) {
+            valid = strcmp(value, "0") == 0 || strcmp(value, "1") == 0;
+            tokenizer->remove_diacritics = value[0] == '1';
+        }
+        if (!valid) {
+            delete tokenizer;
+            return SQLITE_ERROR;
+        }
+    }
+
+    *out = reinterpret_cast<Fts5Tokenizer*>(tokenizer);
+    return SQLITE_OK;
+}
+
+static void DeleteFoldTokenizer(Fts5Tokenizer* instance) {
+    delete reinterpret_cast<FoldTokenizer*>(instance);
+}
+
+// FTS5 hands out its API through a special function. Up to SQLite 3.19
+// the pointer is returned as a blob; newer versions only pass it through
+// sqlite3_bind_pointer(). Returns NULL if FTS5 isn't available.
+static fts5_api* GetFts5Api(sqlite3* db) {
+    fts5_api* api = NULL;
+    sqlite3_stmt* stmt = NULL;
+#if SQLITE_VERSION_NUMBER >= 3020000
+    if (sqlite3_prepare_v2(db, "SELECT fts5(?1)", -1, &stmt, NULL) != SQLITE_OK) return NULL;
+    sqlite3_bind_pointer(stmt, 1, (void*)&api, "fts5_api_ptr", NULL);
+    sqlite3_step(stmt);
+#else
+    if (sqlite3_prepare_v2(db, "SELECT fts5()", -1, &stmt, NULL) != SQLITE_OK) return NULL;
+    if (sqlite3_step(stmt) == SQLITE_ROW && sqlite3_column_bytes(stmt, 0) == sizeof(api)) {
+        memcpy(&api, sqlite3_column_blob(stmt, 0), sizeof(api));
+    }
+#endif
+    sqlite3_finalize(stmt);
+    return api;
+}
+
+int RegisterTokenizers(sqlite3* db) {
+    fts5_api* api = GetFts5Api(db);
+    if (api == NULL) return SQLITE_OK;
+
+    fts5_tokenizer tokenizer = { CreateFoldTokenizer, DeleteFoldTokenizer, FoldTokenize };
+    // The context only tells the two tokenizers apart.
+    static int ngram = 1;
+    int status = api->xCreateTokenizer(api, "ngram", &ngram, &tokenizer, NULL);
+    if (status == SQLITE_OK) {
+        status = api->xCreateTokenizer(api, "fold", NULL, &tokenizer, NULL);
+    }
+    return status;
+}
+
+}
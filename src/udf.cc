@@ -0,0 +1,468 @@
+#include <string.h>
+
+#include "macros.h"
+#include "udf.h"
+
+using namespace node_sqlite3;
+
+// Deterministic results kept per function before the cache starts over.
+#define FUNCTION_CACHE_SIZE 4096
+// Aggregate rows buffered in the thread pool before they are handed to the
+// main thread.
+#define AGGREGATE_BATCH_SIZE 1024
+
+static void DeleteRow(Row* row) {
+    for (Row::iterator it = row->begin(); it < row->end(); ++it) {
+        DELETE_FIELD(*it);
+    }
+    delete row;
+}
+
+AggregateState::~AggregateState() {
+    for (std::vector<Row*>::iterator it = rows.begin(); it < rows.end(); ++it) {
+        DeleteRow(*it);
+    }
+}
+
+FunctionCall::~FunctionCall() {
+    for (std::vector<Row*>::iterator it = rows.begin(); it < rows.end(); ++it) {
+        DeleteRow(*it);
+    }
+    DELETE_FIELD(result);
+}
+
+FunctionQueue::FunctionQueue() {
+    uv_mutex_init(&mutex);
+    uv_cond_init(&done_cond);
+    watcher.data = this;
+    uv_async_init(uv_default_loop(), &watcher, reinterpret_cast<uv_async_cb>(Listener));
+    // Only queries waiting for a call keep the process alive.
+    uv_unref(reinterpret_cast<uv_handle_t*>(&watcher));
+}
+
+FunctionQueue* FunctionQueue::Instance() {
+    // Lives as long as the process, like the default loop it belongs to.
+    static FunctionQueue* queue = new FunctionQueue();
+    return queue;
+}
+
+void FunctionQueue::Listener(uv_async_t* handle, int status) {
+    static_cast<FunctionQueue*>(handle->data)->Serve();
+}
+
+void FunctionQueue::Call(FunctionCall* call) {
+    uv_mutex_lock(&mutex);
+    pending.push_back(call);
+    uv_mutex_unlock(&mutex);
+
+    // Wakes up the main thread if it is in the event loop. Sends that
+    // arrive before it runs are coalesced into one wakeup.
+    uv_async_send(&watcher);
+
+    uv_mutex_lock(&mutex);
+    while (!call->done) {
+        uv_cond_wait(&done_cond, &mutex);
+    }
+    uv_mutex_unlock(&mutex);
+}
+
+void FunctionQueue::Serve() {
+    std::vector<FunctionCall*> calls;
+
+    uv_mutex_lock(&mutex);
+    calls.swap(pending);
+    uv_mutex_unlock(&mutex);
+
+    if (calls.empty()) return;
+
+    for (std::vector<FunctionCall*>::iterator it = calls.begin(); it < calls.end(); ++it) {
+        (*it)->function->Run(*it);
+    }
+
+    uv_mutex_lock(&mutex);
+    for (std::vector<FunctionCall*>::iterator it = calls.begin(); it < calls.end(); ++it) {
+        (*it)->done = true;
+    }
+    uv_cond_broadcast(&done_cond);
+    uv_mutex_unlock(&mutex);
+}
+
+JSFunction::JSFunction(const std::string& name_, bool deterministic_, Local<Function> fn_) :
+        name(name_), deterministic(deterministic_), aggregate(false),
+        queue(FunctionQueue::Instance()) {
+    fn.Reset(fn_);
+    uv_mutex_init(&cache_mutex);
+}
+
+JSFunction::JSFunction(const std::string& name_, bool deterministic_, Local<Value> start_,
+                       Local<Function> step_, Local<Value> result_) :
+        name(name_), deterministic(deterministic_), aggregate(true),
+        queue(FunctionQueue::Instance()) {
+    start.Reset(start_);
+    step.Reset(step_);
+    if (result_->IsFunction()) result.Reset(result_.As<Function>());
+    uv_mutex_init(&cache_mutex);
+}
+
+JSFunction::~JSFunction() {
+    ClearCache();
+    uv_mutex_destroy(&cache_mutex);
+    fn.Reset();
+    start.Reset();
+    step.Reset();
+    result.Reset();
+}
+
+void JSFunction::ClearCache() {
+    for (std::map<std::string, Values::Field*>::iterator it = cache.begin(); it != cache.end(); ++it) {
+        DELETE_FIELD(it->second);
+    }
+    cache.clear();
+}
+
+int JSFunction::Register(sqlite3* db, int args) {
+    int flags = SQLITE_UTF8;
+#ifdef SQLITE_DETERMINISTIC
+    if (deterministic) flags |= SQLITE_DETERMINISTIC;
+#endif
+    if (aggregate) {
+        return sqlite3_create_function_v2(db, name.c_str(), args, flags, this,
+            NULL, Step, Final, NULL);
+    }
+    return sqlite3_create_function_v2(db, name.c_str(), args, flags, this,
+        Scalar, NULL, NULL, NULL);
+}
+
+static Row* ArgumentsToRow(int argc, sqlite3_value** argv) {
+    Row* row = new Row();
+    row->reserve(argc);
+    for (int i = 0; i < argc; i++) {
+        switch (sqlite3_value_type(argv[i])) {
+            case SQLITE_INTEGER: {
+                row->push_back(new Values::Integer(i, sqlite3_value_int64(argv[i])));
+            } break;
+            case SQLITE_FLOAT: {
+                row->push_back(new Values::Float(i, sqlite3_value_double(argv[i])));
+            } break;
+            case SQLITE_TEXT: {
+                const char* text = (const char*)sqlite3_value_text(argv[i]);
+                row->push_back(new Values::Text(i, sqlite3_value_bytes(argv[i]), text));
+            } break;
+            case SQLITE_BLOB: {
+                const void* blob = sqlite3_value_blob(argv[i]);
+                row->push_back(new Values::Blob(i, sqlite3_value_bytes(argv[i]), blob));
+            } break;
+            default: {
+                row->push_back(new Values::Null(i));
+            } break;
+        }
+    }
+    return row;
+}
+
+// Encodes the arguments of a call as a cache key: a type byte per argument
+// followed by its value, with the length in front of text and blobs.
+static std::string CacheKey(int argc, sqlite3_value** argv) {
+    std::string key;
+    for (int i = 0; i < argc; i++) {
+        int type = sqlite3_value_type(argv[i]);
+        key.push_back((char)type);
+        switch (type) {
+            case SQLITE_INTEGER: {
+                sqlite3_int64 value = sqlite3_value_int64(argv[i]);
+                key.append((const char*)&value, sizeof(value));
+            } break;
+            case SQLITE_FLOAT: {
+                double value = sqlite3_value_double(argv[i]);
+                key.append((const char*)&value, sizeof(value));
+            } break;
+            case SQLITE_TEXT:
+            case SQLITE_BLOB: {
+                const char* data = type == SQLITE_TEXT ?
+                    (const char*)sqlite3_value_text(argv[i]) :
+                    (const char*)sqlite3_value_blob(argv[i]);
+                int length = sqlite3_value_bytes(argv[i]);
+                key.append((const char*)&length, sizeof(length));
+                if (length > 0) key.append(data, length);
+            } break;
+        }
+    }
+    return key;
+}
+
+static void SetResult(sqlite3_context* context, Values::Field* field) {
+    switch (field->type) {
+        case SQLITE_INTEGER: {
+            sqlite3_result_int64(context, ((Values::Integer*)field)->value);
+        } break;
+        case SQLITE_FLOAT: {
+            sqlite3_result_double(context, ((Values::Float*)field)->value);
+        } break;
+        case SQLITE_TEXT: {
+            Values::Text* text = (Values::Text*)field;
+            sqlite3_result_text(context, text->value.c_str(), text->value.size(), SQLITE_TRANSIENT);
+        } break;
+        case SQLITE_BLOB: {
+            Values::Blob* blob = (Values::Blob*)field;
+            sqlite3_result_blob(context, blob->value, blob->length, SQLITE_TRANSIENT);
+        } break;
+        default: {
+            sqlite3_result_null(context);
+        } break;
+    }
+}
+
+static Values::Field* CopyField(Values::Field* field) {
+    switch (field->type) {
+        case SQLITE_INTEGER: return new Values::Integer(0, ((Values::Integer*)field)->value);
+        case SQLITE_FLOAT: return new Values::Float(0, ((Values::Float*)field)->value);
+        case SQLITE_TEXT: {
+            Values::Text* text = (Values::Text*)field;
+            return new Values::Text(0, text->value.size(), text->value.data());
+        }
+        case SQLITE_BLOB: {
+            Values::Blob* blob = (Values::Blob*)field;
+            return new Values::Blob(0, blob->length, blob->value);
+        }
+        default: return new Values::Null(0);
+    }
+}
+
+void JSFunction::Scalar(sqlite3_context* context, int argc, sqlite3_value** argv) {
+    // Note: This function is called in the thread pool.
+    JSFunction* function = static_cast<JSFunction*>(sqlite3_user_data(context));
+
+    std::string key;
+    if (function->deterministic) {
+        key = CacheKey(argc, argv);
+        uv_mutex_lock(&function->cache_mutex);
+        std::map<std::string, Values::Field*>::iterator it = function->cache.find(key);
+        if (it != function->cache.end()) {
+            SetResult(context, it->second);
+            uv_mutex_unlock(&function->cache_mutex);
+            return;
+        }
+        uv_mutex_unlock(&function->cache_mutex);
+    }
+
+    FunctionCall call(function);
+    call.rows.push_back(ArgumentsToRow(argc, argv));
+    function->queue->Call(&call);
+
+    if (!call.error.empty()) {
+        sqlite3_result_error(context, call.error.c_str(), -1);
+        return;
+    }
+    SetResult(context, call.result);
+
+    if (function->deterministic) {
+        uv_mutex_lock(&function->cache_mutex);
+        if (function->cache.size() >= FUNCTION_CACHE_SIZE) function->ClearCache();
+        Values::Field*& cached = function->cache[key];
+        if (cached == NULL) cached = CopyField(call.result);
+        uv_mutex_unlock(&function->cache_mutex);
+    }
+}
+
+void JSFunction::Step(sqlite3_context* context, int argc, sqlite3_value** argv) {
+    // Note: This function is called in the thread pool.
+    JSFunction* function = static_cast<JSFunction*>(sqlite3_user_data(context));
+    AggregateState** slot = static_cast<AggregateState**>(
+        sqlite3_aggregate_context(context, sizeof(AggregateState*)));
+    if (slot == NULL) {
+        sqlite3_result_error_nomem(context);
+        return;
+    }
+    if (*slot == NULL) *slot = new AggregateState();
+    AggregateState* state = *slot;
+
+    if (!state->error.empty()) return;
+    state->rows.push_back(ArgumentsToRow(argc, argv));
+    if (state->rows.size() < AGGREGATE_BATCH_SIZE) return;
+
+    FunctionCall call(function, state);
+    call.rows.swap(state->rows);
+    function->queue->Call(&call);
+
+    if (!call.error.empty()) {
+        state->error = call.error;
+        sqlite3_result_error(context, state->error.c_str(), -1);
+    }
+}
+
+void JSFunction::Final(sqlite3_context* context) {
+    // Note: This function is called in the thread pool.
+    JSFunction* function = static_cast<JSFunction*>(sqlite3_user_data(context));
+    AggregateState** slot = static_cast<AggregateState**>(sqlite3_aggregate_context(context, 0));
+
+    // Groups without rows still get result(start).
+    AggregateState empty;
+    AggregateState* state = slot && *slot ? *slot : &empty;
+
+    // Also sent after an error, to release the accumulator.
+    FunctionCall call(function, state, true);
+    call.rows.swap(state->rows);
+    function->queue->Call(&call);
+
+    if (!state->error.empty()) {
+        sqlite3_result_error(context, state->error.c_str(), -1);
+    }
+    else if (!call.error.empty()) {
+        sqlite3_result_error(context, call.error.c_str(), -1);
+    }
+    else {
+        SetResult(context, call.result);
+    }
+
+    if (state != &empty) delete state;
+}
+
+static Local<Value> FieldToJS(Values::Field* field) {
+    switch (field->type) {
+        case SQLITE_INTEGER: {
+            return Nan::New<Number>(((Values::Integer*)field)->value);
+        }
+        case SQLITE_FLOAT: {
+            return Nan::New<Number>(((Values::Float*)field)->value);
+        }
+        case SQLITE_TEXT: {
+            return Nan::New<String>(((Values::Text*)field)->value.c_str(), ((Values::Text*)field)->value.size()).ToLocalChecked();
+        }
+        case SQLITE_BLOB: {
+            return Nan::CopyBuffer(((Values::Blob*)field)->value, ((Values::Blob*)field)->length).ToLocalChecked();
+        }
+        default: {
+            return Nan::Null();
+        }
+    }
+}
+
+// Same conversions as for bound parameters; undefined also becomes NULL.
+static Values::Field* FieldFromJS(Local<Value> source) {
+    if (source->IsString() || source->IsRegExp()) {
+        Nan::Utf8String val(source);
+        return new Values::Text(0, val.length(), *val);
+    }
+    else if (source->IsInt32()) {
+        return new Values::Integer(0, Nan::To<int32_t>(source).FromJust());
+    }
+    else if (source->IsNumber()) {
+        return new Values::Float(0, Nan::To<double>(source).FromJust());
+    }
+    else if (source->IsBoolean()) {
+        return new Values::Integer(0, Nan::To<bool>(source).FromJust() ? 1 : 0);
+    }
+    else if (source->IsNull() || source->IsUndefined()) {
+        return new Values::Null(0);
+    }
+    else if (Buffer::HasInstance(source)) {
+        Local<Object> buffer = Nan::To<Object>(source).ToLocalChecked();
+        return new Values::Blob(0, Buffer::Length(buffer), Buffer::Data(buffer));
+    }
+    else if (source->IsDate()) {
+        return new Values::Float(0, Nan::To<double>(source).FromJust());
+    }
+    else {
+        return NULL;
+    }
+}
+
+static std::string ExceptionMessage(Nan::TryCatch& try_catch) {
+    Nan::Utf8String message(try_catch.Exception());
+    return *message ? std::string(*message) : std::string("Error");
+}
+
+void JSFunction::Run(FunctionCall* call) {
+    Nan::HandleScope scope;
+    if (aggregate) RunAggregate(call);
+    else RunScalar(call);
+}
+
+void JSFunction::RunScalar(FunctionCall* call) {
+    Nan::TryCatch try_catch;
+    Row* row = call->rows[0];
+
+    std::vector<Local<Value> > argv;
+    argv.reserve(row->size());
+    for (Row::iterator it = row->begin(); it < row->end(); ++it) {
+        argv.push_back(FieldToJS(*it));
+    }
+
+    Nan::MaybeLocal<Value> value = Nan::Call(Nan::New(fn), Nan::GetCurrentContext()->Global(),
+        argv.size(), argv.empty() ? NULL : &argv[0]);
+    if (try_catch.HasCaught()) {
+        call->error = ExceptionMessage(try_catch);
+        return;
+    }
+
+    call->result = FieldFromJS(value.ToLocalChecked());
+    if (call->result == NULL) {
+        call->error = "Unsupported return type of function " + name;
+    }
+}
+
+void JSFunction::RunAggregate(FunctionCall* call) {
+    AggregateState* state = call->aggregate;
+    if (!state->error.empty()) {
+        state->accumulator.Reset();
+        return;
+    }
+
+    Nan::TryCatch try_catch;
+    Local<Object> recv = Nan::GetCurrentContext()->Global();
+    Local<Value> accumulator;
+    if (state->started) {
+        accumulator = Nan::New(state->accumulator);
+    }
+    else {
+        // A function as start creates a fresh accumulator for each group.
+        Local<Value> initial = Nan::New(start);
+        if (initial->IsFunction()) {
+            Nan::MaybeLocal<Value> value = Nan::Call(initial.As<Function>(), recv, 0, NULL);
+            if (!try_catch.HasCaught()) accumulator = value.ToLocalChecked();
+        }
+        else {
+            accumulator = initial;
+        }
+        state->started = true;
+    }
+
+    Local<Function> step_fn = Nan::New(step);
+    std::vector<Local<Value> > argv;
+    for (std::vector<Row*>::iterator row = call->rows.begin();
+            row < call->rows.end() && !try_catch.HasCaught(); ++row) {
+        argv.clear();
+        argv.push_back(accumulator);
+        for (Row::iterator it = (*row)->begin(); it < (*row)->end(); ++it) {
+            argv.push_back(FieldToJS(*it));
+        }
+        Nan::MaybeLocal<Value> value = Nan::Call(step_fn, recv, argv.size(), &argv[0]);
+        if (!try_catch.HasCaught()) accumulator = value.ToLocalChecked();
+    }
+
+    if (!try_catch.HasCaught() && call->final) {
+        Local<Value> value = accumulator;
+        if (!result.IsEmpty()) {
+            Local<Value> args[] = { accumulator };
+            Nan::MaybeLocal<Value> maybe = Nan::Call(Nan::New(result), recv, 1, args);
+            if (!try_catch.HasCaught()) value = maybe.ToLocalChecked();
+        }
+        if (!try_catch.HasCaught()) {
+            call->result = FieldFromJS(value);
+            if (call->result == NULL) {
+                call->error = "Unsupported return type of aggregate " + name;
+            }
+        }
+    }
+
+    if (try_catch.HasCaught()) {
+        call->error = ExceptionMessage(try_catch);
+    }
+
+    if (call->final || !call->error.empty()) {
+        state->accumulator.Reset();
+    }
+    else {
+        state->accumulator.Reset(accumulator);
+    }
+}
@@ -0,0 +1,113 @@
+#ifndef NODE_SQLITE3_SRC_UDF_H
+#define NODE_SQLITE3_SRC_UDF_H
+
+#include <string>
+#include <vector>
+#include <map>
+
+#include <sqlite3.h>
+#include <nan.h>
+
+#include "statement.h"
+
+using namespace v8;
+
+namespace node_sqlite3 {
+
+class JSFunction;
+
+// State of one group of a JavaScript aggregate. The accumulator is only
+// touched on the main thread.
+struct AggregateState {
+    AggregateState() : started(false) {}
+    ~AggregateState();
+
+    bool started;
+    std::string error;
+    std::vector<Row*> rows;
+    Nan::Persistent<Value> accumulator;
+};
+
+// A batch of invocations handed from a thread pool thread to the main
+// thread. Scalar calls carry one row of arguments; aggregate calls carry
+// all rows buffered since the last batch.
+struct FunctionCall {
+    FunctionCall(JSFunction* function_, AggregateState* aggregate_ = NULL, bool final_ = false) :
+        function(function_), aggregate(aggregate_), final(final_), result(NULL), done(false) {}
+    ~FunctionCall();
+
+    JSFunction* function;
+    AggregateState* aggregate;
+    bool final;
+    std::vector<Row*> rows;
+    Values::Field* result;
+    std::string error;
+    bool done;
+};
+
+// Runs JavaScript functions on the main thread for queries on the thread
+// pool. The calling thread blocks until its call has run; calls from all
+// threads that arrive meanwhile are served by the same wakeup.
+class FunctionQueue {
+public:
+    // Must first be called on the main thread.
+    static FunctionQueue* Instance();
+
+    // Called on the thread pool.
+    void Call(FunctionCall* call);
+
+    // Runs the pending calls on the main thread.
+    void Serve();
+
+private:
+    FunctionQueue();
+    static void Listener(uv_async_t* handle, int status);
+
+    uv_async_t watcher;
+    uv_mutex_t mutex;
+    uv_cond_t done_cond;
+    std::vector<FunctionCall*> pending;
+};
+
+// A function registered with Database#function or Database#aggregate.
+// Instances are owned by the Database and deleted on the main thread after
+// the connection has been closed.
+class JSFunction {
+public:
+    JSFunction(const std::string& name_, bool deterministic_, Local<Function> fn_);
+    JSFunction(const std::string& name_, bool deterministic_, Local<Value> start_,
+               Local<Function> step_, Local<Value> result_);
+    ~JSFunction();
+
+    int Register(sqlite3* db, int args);
+
+    // Called on the main thread by the FunctionQueue.
+    void Run(FunctionCall* call);
+
+private:
+    static void Scalar(sqlite3_context* context, int argc, sqlite3_value** argv);
+    static void Step(sqlite3_context* context, int argc, sqlite3_value** argv);
+    static void Final(sqlite3_context* context);
+
+    void RunScalar(FunctionCall* call);
+    void RunAggregate(FunctionCall* call);
+    void ClearCache();
+
+    std::string name;
+    bool deterministic;
+    bool aggregate;
+    FunctionQueue* queue;
+
+    Nan::Persistent<Function> fn;
+    Nan::Persistent<Value> start;
+    Nan::Persistent<Function> step;
+    Nan::Persistent<Function> result;
+
+    // Results of deterministic functions by their encoded arguments.
+    uv_mutex_t cache_mutex;
+    std::map<std::string, Values::Field*> cache;
+};
+
+}
+
+#endif
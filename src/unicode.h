@@ -0,0 +1,75 @@
+#ifndef NODE_SQLITE3_SRC_UNICODE_H
+#define NODE_SQLITE3_SRC_UNICODE_H
+
+#include <stdint.h>
+
+namespace node_sqlite3 {
+
+// Decodes the UTF-8 sequence at `p` and advances it. Invalid or truncated
+// sequences decode to their first byte, so every input is accepted and
+// comparisons stay consistent.
+inline uint32_t DecodeUtf8(const unsigned char*& p, const unsigned char* end) {
+    uint32_t c = *p++;
+    if (c < 0x80) return c;
+
+    int extra;
+    uint32_t min;
+    if (c >= 0xF8 || c < 0xC0) return c;
+    else if (c >= 0xF0) { extra = 3; c &= 0x07; min = 0x10000; }
+    else if (c >= 0xE0) { extra = 2; c &= 0x0F; min = 0x800; }
+    else { extra = 1; c &= 0x1F; min = 0x80; }
+
+    if (end - p < extra) return p[-1];
+    uint32_t result = c;
+    for (int i = 0; i < extra; i++) {
+        if ((p[i] & 0xC0) != 0x80) return p[-1];
+        result = (result << 6) | (p[i] & 0x3F);
+    }
+    if (result < min || result > 0x10FFFF) return p[-1];
+    p += extra;
+    return result;
+}
+
+// Appends the UTF-8 encoding of `c` to `out` and returns its length.
+inline int EncodeUtf8(uint32_t c, char* out) {
+    if (c < 0x80) {
+        out[0] = (char)c;
+        return 1;
+    }
+    if (c < 0x800) {
+        out[0] = (char)(0xC0 | (c >> 6));
+        out[1] = (char)(0x80 | (c & 0x3F));
+        return 2;
+    }
+    if (c < 0x10000) {
+        out[0] = (char)(0xE0 | (c >> 12));
+        out[1] = (char)(0x80 | ((c >> 6) & 0x3F));
+        out[2] = (char)(0x80 | (c & 0x3F));
+        return 3;
+    }
+    out[0] = (char)(0xF0 | (c >> 18));
+    out[1] = (char)(0x80 | ((c >> 12) & 0x3F));
+    out[2] = (char)(0x80 | ((c >> 6) & 0x3F));
+    out[3] = (char)(0x80 | (c & 0x3F));
+    return 4;
+}
+
+inline bool IsCombiningMark(uint32_t c) {
+    return (c >= 0x0300 && c <= 0x036F) || (c >= 0x1AB0 && c <= 0x1AFF) ||
+        (c >= 0x1DC0 && c <= 0x1DFF) || (c >= 0x20D0 && c <= 0x20FF) ||
+        (c >= 0xFE20 && c <= 0xFE2F);
+}
+
+// Simple Unicode case folding (one code point to one code point) for the
+// Latin, Greek, Cyrillic, Armenian, Georgian and fullwidth blocks and a few
+// other bicameral scripts. Code points outside these blocks are returned
+// unchanged.
+uint32_t FoldCase(uint32_t c);
+
+// Maps precomposed Latin and Greek letters with diacritics (and a few
+// letters with strokes, like "ø" and "ł") to their base letter.
+uint32_t RemoveDiacritic(uint32_t c);
+
+}
+
+#endif
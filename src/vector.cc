@@ -0,0 +1,316 @@
+#include <cmath>
+#include <cstring>
+#include <queue>
+#include <vector>
+#include <functional>
+#include <string>
+#include <stdint.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define NODE_SQLITE3_AVX2 1
+#define NODE_SQLITE3_SSE 1
+#define NODE_SQLITE3_TARGET_AVX2 __attribute__((target("avx2,fma")))
+#elif defined(_MSC_VER) && (defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1))
+#include <intrin.h>
+#define NODE_SQLITE3_SSE 1
+#endif
+
+#include "functions.h"
+
+namespace node_sqlite3 {
+
+// Partial sums of one pass over two vectors: the dot product and both
+// squared norms, or the squared distance.
+struct VectorSums {
+    double dot;
+    double norm_a;
+    double norm_b;
+    double distance;
+};
+
+// Blobs don't guarantee any alignment, so all kernels use unaligned loads and
+// the scalar code copies each element.
+static inline float LoadFloat(const unsigned char* p) {
+    float value;
+    memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+static void SumsFloatScalar(const unsigned char* a, const unsigned char* b, int n, VectorSums* sums, int start) {
+    for (int i = start; i < n; i++) {
+        float x = LoadFloat(a + i * 4), y = LoadFloat(b + i * 4);
+        sums->dot += x * y;
+        sums->norm_a += x * x;
+        sums->norm_b += y * y;
+        sums->distance += (x - y) * (x - y);
+    }
+}
+
+static void SumsInt8Scalar(const unsigned char* a, const unsigned char* b, int n, VectorSums* sums, int start) {
+    int64_t dot = 0, norm_a = 0, norm_b = 0, distance = 0;
+    for (int i = start; i < n; i++) {
+        int x = (int8_t)a[i], y = (int8_t)b[i];
+        dot += x * y;
+        norm_a += x * x;
+        norm_b += y * y;
+        distance += (x - y) * (x - y);
+    }
+    sums->dot += dot;
+    sums->norm_a += norm_a;
+    sums->norm_b += norm_b;
+    sums->distance += distance;
+}
+
+#ifdef NODE_SQLITE3_SSE
+static inline double HorizontalSum(__m128 v) {
+    float lanes[4];
+    _mm_storeu_ps(lanes, v);
+    return (double)lanes[0] + lanes[1] + lanes[2] + lanes[3];
+}
+
+static void SumsFloatSSE(const unsigned char* a, const unsigned char* b, int n, VectorSums* sums) {
+    __m128 dot = _mm_setzero_ps(), norm_a = _mm_setzero_ps();
+    __m128 norm_b = _mm_setzero_ps(), distance = _mm_setzero_ps();
+    int i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m128 x = _mm_loadu_ps((const float*)(a + i * 4));
+        __m128 y = _mm_loadu_ps((const float*)(b + i * 4));
+        __m128 d = _mm_sub_ps(x, y);
+        dot = _mm_add_ps(dot, _mm_mul_ps(x, y));
+        norm_a = _mm_add_ps(norm_a, _mm_mul_ps(x, x));
+        norm_b = _mm_add_ps(norm_b, _mm_mul_ps(y, y));
+        distance = _mm_add_ps(distance, _mm_mul_ps(d, d));
+    }
+    sums->dot = HorizontalSum(dot);
+    sums->norm_a = HorizontalSum(norm_a);
+    sums->norm_b = HorizontalSum(norm_b);
+    sums->distance = HorizontalSum(distance);
+    SumsFloatScalar(a, b, n, sums, i);
+}
+#endif
+
+#ifdef NODE_SQLITE3_AVX2
+NODE_SQLITE3_TARGET_AVX2
+static double HorizontalSum256(__m256 v) {
+    float lanes[8];
+    _mm256_storeu_ps(lanes, v);
+    double sum = 0;
+    for (int i = 0; i < 8; i++) sum += lanes[i];
+    return sum;
+}
+
+NODE_SQLITE3_TARGET_AVX2
+static void SumsFloatAVX2(const unsigned char* a, const unsigned char* b, int n, VectorSums* sums) {
+    __m256 dot = _mm256_setzero_ps(), norm_a = _mm256_setzero_ps();
+    __m256 norm_b = _mm256_setzero_ps(), distance = _mm256_setzero_ps();
+    int i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m256 x = _mm256_loadu_ps((const float*)(a + i * 4));
+        __m256 y = _mm256_loadu_ps((const float*)(b + i * 4));
+        __m256 d = _mm256_sub_ps(x, y);
+        dot = _mm256_fmadd_ps(x, y, dot);
+        norm_a = _mm256_fmadd_ps(x, x, norm_a);
+        norm_b = _mm256_fmadd_ps(y, y, norm_b);
+        distance = _mm256_fmadd_ps(d, d, distance);
+    }
+    sums->dot = HorizontalSum256(dot);
+    sums->norm_a = HorizontalSum256(norm_a);
+    sums->norm_b = HorizontalSum256(norm_b);
+    sums->distance = HorizontalSum256(distance);
+    SumsFloatScalar(a, b, n, sums, i);
+}
+
+NODE_SQLITE3_TARGET_AVX2
+static int64_t HorizontalSumEpi32(__m256i v) {
+    int32_t lanes[8];
+    _mm256_storeu_si256((__m256i*)lanes, v);
+    int64_t sum = 0;
+    for (int i = 0; i < 8; i++) sum += lanes[i];
+    return sum;
+}
+
+NODE_SQLITE3_TARGET_AVX2
+static void SumsInt8AVX2(const unsigned char* a, const unsigned char* b, int n, VectorSums* sums) {
+    __m256i dot = _mm256_setzero_si256(), norm_a = _mm256_setzero_si256();
+    __m256i norm_b = _mm256_setzero_si256(), distance = _mm256_setzero_si256();
+    int i = 0;
+    // Each 32-bit lane gains at most 2 * 255 * 255 per iteration, so the
+    // accumulators can't overflow for vectors below 2^18 dimensions.
+    for (; i + 16 <= n; i += 16) {
+        __m256i x = _mm256_cvtepi8_epi16(_mm_loadu_si128((const __m128i*)(a + i)));
+        __m256i y = _mm256_cvtepi8_epi16(_mm_loadu_si128((const __m128i*)(b + i)));
+        __m256i d = _mm256_sub_epi16(x, y);
+        dot = _mm256_add_epi32(dot, _mm256_madd_epi16(x, y));
+        norm_a = _mm256_add_epi32(norm_a, _mm256_madd_epi16(x, x));
+        norm_b = _mm256_add_epi32(norm_b, _mm256_madd_epi16(y, y));
+        distance = _mm256_add_epi32(distance, _mm256_madd_epi16(d, d));
+    }
+    sums->dot = (double)HorizontalSumEpi32(dot);
+    sums->norm_a = (double)HorizontalSumEpi32(norm_a);
+    sums->norm_b = (double)HorizontalSumEpi32(norm_b);
+    sums->distance = (double)HorizontalSumEpi32(distance);
+    SumsInt8Scalar(a, b, n, sums, i);
+}
+
+static bool HasAVX2() {
+    static int supported = -1;
+    if (supported < 0) {
+        __builtin_cpu_init();
+        supported = __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+    }
+    return supported == 1;
+}
+#endif
+
+static void SumsFloat(const unsigned char* a, const unsigned char* b, int n, VectorSums* sums) {
+#ifdef NODE_SQLITE3_AVX2
+    if (HasAVX2()) return SumsFloatAVX2(a, b, n, sums);
+#endif
+#ifdef NODE_SQLITE3_SSE
+    SumsFloatSSE(a, b, n, sums);
+#else
+    SumsFloatScalar(a, b, n, sums, 0);
+#endif
+}
+
+static void SumsInt8(const unsigned char* a, const unsigned char* b, int n, VectorSums* sums) {
+#ifdef NODE_SQLITE3_AVX2
+    if (HasAVX2() && n < (1 << 18)) return SumsInt8AVX2(a, b, n, sums);
+#endif
+    SumsInt8Scalar(a, b, n, sums, 0);
+}
+
+enum VectorMetric { METRIC_DOT, METRIC_COSINE, METRIC_L2 };
+enum VectorType { VECTOR_FLOAT32, VECTOR_INT8 };
+
+// The metric and element type are packed into the function's user data.
+static void VectorFunction(sqlite3_context* context, int argc, sqlite3_value** argv) {
+    intptr_t config = (intptr_t)sqlite3_user_data(context);
+    VectorMetric metric = (VectorMetric)(config & 0xff);
+    VectorType type = (VectorType)(config >> 8);
+
+    if (sqlite3_value_type(argv[0]) == SQLITE_NULL || sqlite3_value_type(argv[1]) == SQLITE_NULL) {
+        return sqlite3_result_null(context);
+    }
+
+    const unsigned char* a = (const unsigned char*)sqlite3_value_blob(argv[0]);
+    int bytes = sqlite3_value_bytes(argv[0]);
+    const unsigned char* b = (const unsigned char*)sqlite3_value_blob(argv[1]);
+    if (bytes != sqlite3_value_bytes(argv[1])) {
+        return sqlite3_result_error(context, "vectors have different dimensions", -1);
+    }
+
+    VectorSums sums = { 0, 0, 0, 0 };
+    if (type == VECTOR_FLOAT32) {
+        if (bytes % 4) {
+            return sqlite3_result_error(context, "float32 vector size must be a multiple of 4 bytes", -1);
+        }
+        SumsFloat(a, b, bytes / 4, &sums);
+    }
+    else {
+        SumsInt8(a, b, bytes, &sums);
+    }
+
+    switch (metric) {
+        case METRIC_DOT:
+            sqlite3_result_double(context, sums.dot);
+            break;
+        case METRIC_COSINE:
+            if (sums.norm_a == 0 || sums.norm_b == 0) return sqlite3_result_null(context);
+            sqlite3_result_double(context, sums.dot / (std::sqrt(sums.norm_a) * std::sqrt(sums.norm_b)));
+            break;
+        case METRIC_L2:
+            sqlite3_result_double(context, std::sqrt(sums.distance));
+            break;
+    }
+}
+
+// vec_topk(id, score, k) keeps the k rows with the highest scores in a
+// min-heap instead of sorting all rows and returns them as a JSON array of
+// {"id", "score"} objects, best first. Use -vec_l2(...) as the score to find
+// the nearest neighbours by distance.
+typedef std::pair<double, sqlite3_int64> ScoredId;
+typedef std::priority_queue<ScoredId, std::vector<ScoredId>, std::greater<ScoredId> > TopKHeap;
+
+struct TopK {
+    int k;
+    TopKHeap heap;
+};
+
+static void TopKStep(sqlite3_context* context, int argc, sqlite3_value** argv) {
+    TopK** state = static_cast<TopK**>(sqlite3_aggregate_context(context, sizeof(TopK*)));
+    if (state == NULL) return sqlite3_result_error_nomem(context);
+
+    if (*state == NULL) {
+        int k = sqlite3_value_int(argv[2]);
+        if (k <= 0) return sqlite3_result_error(context, "k must be a positive integer", -1);
+        *state = new TopK();
+        (*state)->k = k;
+    }
+    if (sqlite3_value_type(argv[1]) == SQLITE_NULL) return;
+
+    TopK* topk = *state;
+    ScoredId item(sqlite3_value_double(argv[1]), sqlite3_value_int64(argv[0]));
+    if (std::isnan(item.first)) return;
+    if ((int)topk->heap.size() < topk->k) {
+        topk->heap.push(item);
+    }
+    else if (item.first > topk->heap.top().first) {
+        topk->heap.pop();
+        topk->heap.push(item);
+    }
+}
+
+static void TopKFinal(sqlite3_context* context) {
+    TopK** state = static_cast<TopK**>(sqlite3_aggregate_context(context, 0));
+    TopK* topk = state ? *state : NULL;
+
+    std::vector<ScoredId> items;
+    if (topk) {
+        while (!topk->heap.empty()) {
+            items.push_back(topk->heap.top());
+            topk->heap.pop();
+        }
+        delete topk;
+    }
+
+    std::string json("[");
+    for (int i = (int)items.size() - 1; i >= 0; i--) {
+        char* entry = sqlite3_mprintf("%s{\"id\":%lld,\"score\":%.15g}",
+            i == (int)items.size() - 1 ? "" : ",", items[i].second, items[i].first);
+        json += entry;
+        sqlite3_free(entry);
+    }
+    json += "]";
+    sqlite3_result_text(context, json.c_str(), json.size(), SQLITE_TRANSIENT);
+}
+
+int RegisterVectorFunctions(sqlite3* db) {
+    static const struct {
+        const char* name;
+        VectorMetric metric;
+        VectorType type;
+    } functions[] = {
+        { "vec_dot", METRIC_DOT, VECTOR_FLOAT32 },
+        { "vec_cosine", METRIC_COSINE, VECTOR_FLOAT32 },
+        { "vec_l2", METRIC_L2, VECTOR_FLOAT32 },
+        { "vec_dot_i8", METRIC_DOT, VECTOR_INT8 },
+        { "vec_cosine_i8", METRIC_COSINE, VECTOR_INT8 },
+        { "vec_l2_i8", METRIC_L2, VECTOR_INT8 }
+    };
+
+    int status = SQLITE_OK;
+    for (unsigned int i = 0; i < sizeof(functions) / sizeof(functions[0]) && status == SQLITE_OK; i++) {
+        intptr_t config = functions[i].metric | (functions[i].type << 8);
+        status = sqlite3_create_function(db, functions[i].name, 2, SQLITE_UTF8 | SQLITE_DETERMINISTIC,
+            (void*)config, VectorFunction, NULL, NULL);
+    }
+    if (status == SQLITE_OK) {
+        status = sqlite3_create_function(db, "vec_topk", 3, SQLITE_UTF8,
+            NULL, NULL, TopKStep, TopKFinal);
+    }
+    return status;
+}
+
+}
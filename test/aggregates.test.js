@@ -0,0 +1,74 @@
+var sqlite3 = require('..');
+var assert = require('assert');
+
+describe('aggregate functions', function() {
+    var db;
+    before(function(done) {
+        db = new sqlite3.Database(':memory:', function(err) {
+            if (err) throw err;
+            db.exec("CREATE TABLE events (latency INTEGER, user INTEGER);" +
+                "WITH RECURSIVE c(i) AS (SELECT 1 UNION ALL SELECT i + 1 FROM c WHERE i < 10000) " +
+                "INSERT INTO events SELECT i, i % 2500 FROM c;" +
+                "INSERT INTO events VALUES (NULL, NULL);", done);
+        });
+    });
+
+    it('should compute exact percentiles', function(done) {
+        db.get("SELECT percentile(latency, 95) AS p95, median(latency) AS p50, percentile(latency, 0) AS p0 FROM events",
+                function(err, row) {
+            if (err) throw err;
+            assert.deepEqual(row, { p95: 9500.05, p50: 5000.5, p0: 1 });
+            done();
+        });
+    });
+
+    it('should interpolate between values', function(done) {
+        db.get("SELECT percentile(x, 25) AS p FROM (SELECT 1 AS x UNION ALL SELECT 2 UNION ALL SELECT 3 UNION ALL SELECT 4)",
+                function(err, row) {
+            if (err) throw err;
+            assert.equal(row.p, 1.75);
+            done();
+        });
+    });
+
+    it('should approximate percentiles with a t-digest', function(done) {
+        db.get("SELECT percentile_approx(latency, 99) AS p99, median_approx(latency) AS p50 FROM events",
+                function(err, row) {
+            if (err) throw err;
+            assert.ok(Math.abs(row.p99 - 9900) < 50);
+            assert.ok(Math.abs(row.p50 - 5000) < 100);
+            done();
+        });
+    });
+
+    it('should estimate distinct counts', function(done) {
+        db.get("SELECT approx_count_distinct(user) AS users, approx_count_distinct(latency) AS latencies FROM events",
+                function(err, row) {
+            if (err) throw err;
+            assert.ok(Math.abs(row.users - 2500) < 2500 * 0.03);
+            assert.ok(Math.abs(row.latencies - 10000) < 10000 * 0.03);
+            done();
+        });
+    });
+
+    it('should return NULL and 0 for empty groups', function(done) {
+        db.get("SELECT median(latency) AS m, percentile_approx(latency, 50) AS a, approx_count_distinct(user) AS d " +
+                "FROM events WHERE latency < 0", function(err, row) {
+            if (err) throw err;
+            assert.deepEqual(row, { m: null, a: null, d: 0 });
+            done();
+        });
+    });
+
+    it('should reject invalid percentiles', function(done) {
+        db.get("SELECT percentile(latency, 101) FROM events", function(err) {
+            assert.ok(err);
+            assert.ok(/between 0 and 100/.test(err.message));
+            done();
+        });
+    });
+
+    after(function(done) {
+        db.close(done);
+    });
+});
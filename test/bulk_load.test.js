@@ -0,0 +1,165 @@
+var sqlite3 = require('..');
+var assert = require('assert');
+var helper = require('./support/helper');
+
+describe('bulk load', function() {
+    var db;
+    before(function(done) {
+        helper.deleteFile('test/tmp/test_bulk_load.db');
+        helper.ensureExists('test/tmp');
+        db = new sqlite3.Database('test/tmp/test_bulk_load.db', function(err) {
+            if (err) throw err;
+            db.serialize(function() {
+                db.run("CREATE TABLE foo (id INTEGER PRIMARY KEY, txt TEXT)");
+                db.run("CREATE INDEX foo_txt ON foo (txt)", done);
+            });
+        });
+    });
+
+    it('should run a statement for every row of a batch', function(done) {
+        db.run("CREATE TABLE batch (a INT, b TEXT)", function(err) {
+            if (err) throw err;
+            var stmt = db.prepare("INSERT INTO batch VALUES ($a, $b)");
+            stmt.runBatch([ { $a: 1, $b: 'one' }, { $a: 2, $b: 'two' } ], function(err) {
+                if (err) throw err;
+                assert.equal(this.changes, 2);
+                stmt.finalize();
+                db.all("SELECT * FROM batch ORDER BY a", function(err, rows) {
+                    if (err) throw err;
+                    assert.deepEqual(rows, [ { a: 1, b: 'one' }, { a: 2, b: 'two' } ]);
+                    done();
+                });
+            });
+        });
+    });
+
+    it('should not reuse values of the previous row', function(done) {
+        db.run("CREATE TABLE sparse (a INT, b TEXT)", function(err) {
+            if (err) throw err;
+            var stmt = db.prepare("INSERT INTO sparse VALUES (?, ?)");
+            stmt.runBatch([ [ 1, 'one' ], [] ], function(err) {
+                if (err) throw err;
+                stmt.finalize();
+                db.all("SELECT * FROM sparse ORDER BY a", function(err, rows) {
+                    if (err) throw err;
+                    assert.deepEqual(rows, [ { a: null, b: null }, { a: 1, b: 'one' } ]);
+                    done();
+                });
+            });
+        });
+    });
+
+    it('should reject unsupported values in a batch', function(done) {
+        var stmt = db.prepare("INSERT INTO sparse VALUES (?, ?)");
+        assert.throws(function() {
+            stmt.runBatch([ [ 1, undefined ] ]);
+        }, /Data type is not supported/);
+        assert.throws(function() {
+            stmt.runBatch([ { 1: 1, 2: function() {} } ]);
+        }, /Data type is not supported/);
+        stmt.finalize(done);
+    });
+
+    it('should report errors of a batch', function(done) {
+        var stmt = db.prepare("INSERT INTO foo VALUES (?, ?)");
+        stmt.runBatch([ [ 1, 'a' ], [ 1, 'b' ] ], function(err) {
+            assert.ok(err);
+            assert.equal(err.code, 'SQLITE_CONSTRAINT');
+            stmt.finalize();
+            db.run("DELETE FROM foo", done);
+        });
+    });
+
+    it('should load rows with deferred indexes', function(done) {
+        db.bulkLoad('foo', { sortBy: 0, batchSize: 1000 }, function(err, loader) {
+            if (err) throw err;
+            db.all("SELECT name FROM sqlite_master WHERE type = 'index' AND tbl_name = 'foo'", function(err, rows) {
+                if (err) throw err;
+                assert.deepEqual(rows, []);
+
+                for (var i = 5000; i > 0; i--) {
+                    loader.insert([ [ i, 'Row ' + i ] ]);
+                }
+                loader.finish(function(err) {
+                    if (err) throw err;
+                    done();
+                });
+            });
+        });
+    });
+
+    it('should have inserted all rows', function(done) {
+        db.get("SELECT count(*) AS n, min(id) AS lo, max(id) AS hi FROM foo", function(err, row) {
+            if (err) throw err;
+            assert.deepEqual(row, { n: 5000, lo: 1, hi: 5000 });
+            done();
+        });
+    });
+
+    it('should have recreated the indexes and restored the settings', function(done) {
+        db.all("SELECT name FROM sqlite_master WHERE type = 'index' AND tbl_name = 'foo'", function(err, rows) {
+            if (err) throw err;
+            assert.deepEqual(rows, [ { name: 'foo_txt' } ]);
+            db.get("PRAGMA journal_mode", function(err, row) {
+                if (err) throw err;
+                assert.equal(row.journal_mode, 'delete');
+                done();
+            });
+        });
+    });
+
+    it('should insert object rows by column name', function(done) {
+        db.run('CREATE TABLE obj (id INTEGER PRIMARY KEY, "my txt" TEXT)', function(err) {
+            if (err) throw err;
+            db.bulkLoad('obj', { columns: [ 'id', 'my txt' ], sortBy: 'id' }, function(err, loader) {
+                if (err) throw err;
+                loader.insert([ { id: 2, 'my txt': 'two' }, { id: 1 }, [ 3, 'three' ] ]);
+                loader.finish(function(err) {
+                    if (err) throw err;
+                    db.all("SELECT * FROM obj ORDER BY id", function(err, rows) {
+                        if (err) throw err;
+                        assert.deepEqual(rows, [
+                            { id: 1, 'my txt': null },
+                            { id: 2, 'my txt': 'two' },
+                            { id: 3, 'my txt': 'three' }
+                        ]);
+                        done();
+                    });
+                });
+            });
+        });
+    });
+
+    it('should reject unknown sortBy columns', function(done) {
+        db.bulkLoad('obj', { sortBy: 'nope' }, function(err) {
+            assert.ok(err instanceof TypeError);
+            done();
+        });
+    });
+
+    it('should report errors after SQLite rolled back', function(done) {
+        db.run("CREATE TABLE strict (id INTEGER PRIMARY KEY ON CONFLICT ROLLBACK)", function(err) {
+            if (err) throw err;
+            db.bulkLoad('strict', function(err, loader) {
+                if (err) throw err;
+                loader.insert([ [ 1 ], [ 1 ] ]);
+                loader.finish(function(err) {
+                    assert.ok(err);
+                    assert.equal(err.code, 'SQLITE_CONSTRAINT');
+                    db.get("SELECT count(*) AS n FROM strict", function(err, row) {
+                        if (err) throw err;
+                        assert.equal(row.n, 0);
+                        done();
+                    });
+                });
+            });
+        });
+    });
+
+    after(function(done) {
+        db.close(function() {
+            helper.deleteFile('test/tmp/test_bulk_load.db');
+            done();
+        });
+    });
+});
@@ -0,0 +1,72 @@
+var sqlite3 = require('..');
+var assert = require('assert');
+
+describe('collations', function() {
+    var db;
+    before(function(done) {
+        db = new sqlite3.Database(':memory:', function(err) {
+            if (err) throw err;
+            db.serialize(function() {
+                db.run("CREATE TABLE files (name TEXT)");
+                var stmt = db.prepare("INSERT INTO files VALUES (?)");
+                [ 'file10.txt', 'file2.txt', 'File1.txt', 'file1.txt', 'Ärger', 'ärger2', 'Zebra' ].forEach(function(name) {
+                    stmt.run(name);
+                });
+                stmt.finalize(done);
+            });
+        });
+    });
+
+    function names(sql, callback) {
+        db.all(sql, function(err, rows) {
+            if (err) throw err;
+            callback(rows.map(function(row) { return row.name; }));
+        });
+    }
+
+    it('should sort numbers naturally', function(done) {
+        names("SELECT name FROM files WHERE name LIKE 'file%' ORDER BY name COLLATE NATSORT", function(result) {
+            assert.deepEqual(result, [ 'File1.txt', 'file1.txt', 'file2.txt', 'file10.txt' ]);
+            done();
+        });
+    });
+
+    it('should sort naturally ignoring case', function(done) {
+        names("SELECT name FROM files WHERE name LIKE 'file%' ORDER BY name COLLATE NATSORT_NOCASE, name", function(result) {
+            assert.deepEqual(result, [ 'File1.txt', 'file1.txt', 'file2.txt', 'file10.txt' ]);
+            done();
+        });
+    });
+
+    it('should order numbers by value regardless of leading zeros', function(done) {
+        db.get("SELECT 'a007' < 'a10' COLLATE NATSORT AS a, 'a01' < 'a1' COLLATE NATSORT AS b, " +
+                "'a1b' = 'a1b' COLLATE NATSORT AS c", function(err, row) {
+            if (err) throw err;
+            assert.deepEqual(row, { a: 1, b: 0, c: 1 });
+            done();
+        });
+    });
+
+    it('should fold non-ASCII case', function(done) {
+        db.get("SELECT 'ÄRGER' = 'ärger' COLLATE UNICODE_NOCASE AS latin, 'ПРИВЕТ' = 'привет' COLLATE UNICODE_NOCASE AS cyrillic, " +
+                "'ΣΟΦΙΑ' = 'σοφια' COLLATE UNICODE_NOCASE AS greek, 'ÄRGER' = 'ärger' COLLATE NOCASE AS builtin", function(err, row) {
+            if (err) throw err;
+            assert.deepEqual(row, { latin: 1, cyrillic: 1, greek: 1, builtin: 0 });
+            done();
+        });
+    });
+
+    it('should be usable in indexes', function(done) {
+        db.serialize(function() {
+            db.run("CREATE INDEX files_name ON files (name COLLATE UNICODE_NOCASE)");
+            names("SELECT name FROM files WHERE name = 'ÄRGER' COLLATE UNICODE_NOCASE", function(result) {
+                assert.deepEqual(result, [ 'Ärger' ]);
+                done();
+            });
+        });
+    });
+
+    after(function(done) {
+        db.close(done);
+    });
+});
@@ -0,0 +1,60 @@
+var sqlite3 = require('..');
+var assert = require('assert');
+var zlib = require('zlib');
+
+describe('compress', function() {
+    var db;
+    var payload = JSON.stringify(new Array(200).fill({ type: 'event', value: 42 }));
+
+    before(function(done) {
+        db = new sqlite3.Database(':memory:', function(err) {
+            if (err) throw err;
+            db.serialize(function() {
+                db.run("CREATE TABLE docs (id INTEGER PRIMARY KEY, body BLOB)");
+                db.run("INSERT INTO docs (body) VALUES (compress(?))", payload, done);
+            });
+        });
+    });
+
+    it('should store compressed blobs', function(done) {
+        db.get("SELECT length(body) AS size, body FROM docs", function(err, row) {
+            if (err) throw err;
+            assert.ok(row.size < payload.length / 10);
+            // 4-byte little-endian length followed by a zlib stream.
+            assert.equal(row.body.readUInt32LE(0), payload.length);
+            assert.equal(zlib.inflateSync(row.body.slice(4)).toString(), payload);
+            done();
+        });
+    });
+
+    it('should decompress inside queries', function(done) {
+        db.get("SELECT CAST(decompress(body) AS TEXT) AS body FROM docs", function(err, row) {
+            if (err) throw err;
+            assert.equal(row.body, payload);
+            done();
+        });
+    });
+
+    it('should accept a compression level', function(done) {
+        db.get("SELECT decompress(compress(x'00010203', 9)) AS raw, compress('', 1) AS empty, compress(NULL) AS none",
+                function(err, row) {
+            if (err) throw err;
+            assert.deepEqual(row.raw, new Buffer([ 0, 1, 2, 3 ]));
+            assert.equal(row.empty.length, 0);
+            assert.equal(row.none, null);
+            done();
+        });
+    });
+
+    it('should reject invalid data', function(done) {
+        db.get("SELECT decompress(x'0500000078')", function(err) {
+            assert.ok(err);
+            assert.ok(/invalid compressed data/.test(err.message));
+            done();
+        });
+    });
+
+    after(function(done) {
+        db.close(done);
+    });
+});
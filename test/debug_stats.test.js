@@ -0,0 +1,44 @@
+var sqlite3 = require('..');
+var assert = require('assert');
+
+describe('debug stats', function() {
+    var db;
+    before(function(done) {
+        db = new sqlite3.Database(':memory:', function(err) {
+            if (err) throw err;
+            db.exec("CREATE TABLE foo (id INT, txt TEXT);" +
+                "INSERT INTO foo VALUES (1, 'abc'), (2, 'defg'), (3, NULL);", done);
+        });
+    });
+
+    it('should report all operations', function() {
+        var stats = sqlite3.debugStats();
+        ['bind', 'row', 'convert', 'baton', 'call'].forEach(function(name) {
+            assert.equal(typeof stats[name].allocations, 'number');
+            assert.equal(typeof stats[name].bytes, 'number');
+        });
+    });
+
+    it('should count fields and copied bytes', function(done) {
+        sqlite3.debugStats(true);
+        db.all("SELECT id, txt FROM foo WHERE txt <> ? OR txt IS NULL", 'xy', function(err, rows) {
+            if (err) throw err;
+            assert.equal(rows.length, 3);
+            var stats = sqlite3.debugStats();
+            assert.deepEqual(stats.bind, { allocations: 1, bytes: 2 });
+            assert.deepEqual(stats.row, { allocations: 6, bytes: 7 });
+            assert.deepEqual(stats.convert, { allocations: 6, bytes: 7 });
+            assert.ok(stats.baton.allocations >= 2);
+            done();
+        });
+    });
+
+    it('should reset', function() {
+        sqlite3.debugStats(true);
+        assert.deepEqual(sqlite3.debugStats(true).row, { allocations: 0, bytes: 0 });
+    });
+
+    after(function(done) {
+        db.close(done);
+    });
+});
@@ -0,0 +1,85 @@
+var sqlite3 = require('..');
+var assert = require('assert');
+
+describe('result hashing', function() {
+    var db;
+    before(function(done) {
+        db = new sqlite3.Database(':memory:', function(err) {
+            if (err) throw err;
+            db.exec("CREATE TABLE foo (id INTEGER PRIMARY KEY, txt TEXT, num REAL, data BLOB);" +
+                "INSERT INTO foo VALUES (1, 'one', 1.5, x'0102');" +
+                "INSERT INTO foo VALUES (2, 'two', NULL, NULL);" +
+                "INSERT INTO foo VALUES (3, NULL, 3, x'');", done);
+        });
+    });
+
+    var first;
+    it('should hash the result set', function(done) {
+        db.hash("SELECT * FROM foo ORDER BY id", function(err, result) {
+            if (err) throw err;
+            assert.equal(result.rows, 3);
+            assert.ok(/^[0-9a-f]{16}$/.test(result.hash));
+            first = result.hash;
+            done();
+        });
+    });
+
+    it('should be stable', function(done) {
+        var stmt = db.prepare("SELECT * FROM foo ORDER BY id");
+        stmt.hash(function(err, a) {
+            if (err) throw err;
+            stmt.hash(function(err, b) {
+                if (err) throw err;
+                assert.equal(a.hash, first);
+                assert.equal(b.hash, first);
+                stmt.finalize(done);
+            });
+        });
+    });
+
+    it('should change with the data', function(done) {
+        db.run("UPDATE foo SET txt = 'three' WHERE id = 3", function(err) {
+            if (err) throw err;
+            db.hash("SELECT * FROM foo ORDER BY id", function(err, result) {
+                if (err) throw err;
+                assert.notEqual(result.hash, first);
+                done();
+            });
+        });
+    });
+
+    it('should tell types and column names apart', function(done) {
+        db.hash("SELECT 1 AS a", function(err, a) {
+            if (err) throw err;
+            db.hash("SELECT '1' AS a", function(err, b) {
+                if (err) throw err;
+                db.hash("SELECT 1 AS b", function(err, c) {
+                    if (err) throw err;
+                    assert.notEqual(a.hash, b.hash);
+                    assert.notEqual(a.hash, c.hash);
+                    done();
+                });
+            });
+        });
+    });
+
+    it('should bind parameters', function(done) {
+        db.hash("SELECT * FROM foo WHERE id > ?", 5, function(err, result) {
+            if (err) throw err;
+            assert.equal(result.rows, 0);
+            done();
+        });
+    });
+
+    it('should report errors', function(done) {
+        db.hash("SELECT * FROM missing", function(err) {
+            assert.ok(err);
+            assert.equal(err.code, 'SQLITE_ERROR');
+            done();
+        });
+    });
+
+    after(function(done) {
+        db.close(done);
+    });
+});
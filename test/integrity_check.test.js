@@ -0,0 +1,107 @@
+var sqlite3 = require('..');
+var assert = require('assert');
+var fs = require('fs');
+var helper = require('./support/helper');
+
+describe('integrityCheck', function() {
+    var file = 'test/tmp/test_integrity_check.db';
+    var db;
+    before(function(done) {
+        helper.deleteFile(file);
+        helper.ensureExists('test/tmp');
+        db = new sqlite3.Database(file);
+        db.serialize(function() {
+            db.run("CREATE TABLE foo (id INTEGER PRIMARY KEY, txt TEXT)");
+            db.run("CREATE INDEX foo_txt ON foo (txt)");
+            db.run("BEGIN");
+            var stmt = db.prepare("INSERT INTO foo (txt) VALUES (?)");
+            for (var i = 0; i < 5000; i++) stmt.run('row ' + i);
+            stmt.finalize();
+            db.run("COMMIT", done);
+        });
+    });
+
+    it('should report no problems in slices', function(done) {
+        var progress = [];
+        var check = db.integrityCheck({ pagesPerSlice: 5, pause: 0 }, function(err, problems) {
+            if (err) throw err;
+            assert.deepEqual(problems, []);
+            assert.ok(progress.length > 1);
+            progress.forEach(function(event) {
+                assert.ok(event.pages <= event.totalPages);
+                assert.equal(event.totalPages, progress[0].totalPages);
+            });
+            done();
+        });
+        check.on('progress', function(event) { progress.push(event); });
+    });
+
+    it('should refuse to pause outside of WAL mode', function(done) {
+        db.integrityCheck({ pagesPerSlice: 1, pause: 5 }, function(err) {
+            assert.ok(err);
+            assert.equal(err.code, 'SQLITE_MISUSE');
+            assert.ok(/requires WAL mode/.test(err.message));
+            done();
+        });
+    });
+
+    it('should not block the database', function(done) {
+        var queried = false;
+        db.run("PRAGMA journal_mode = WAL", function(err) {
+            if (err) throw err;
+            db.integrityCheck({ pagesPerSlice: 1, pause: 5 }, function(err) {
+                if (err) throw err;
+                assert.ok(queried);
+                done();
+            });
+            db.get("SELECT count(*) AS n FROM foo", function(err, row) {
+                if (err) throw err;
+                assert.equal(row.n, 5000);
+                queried = true;
+            });
+        });
+    });
+
+    it('should be cancelable', function(done) {
+        var check = db.integrityCheck({ pagesPerSlice: 1, pause: 5 }, function(err) {
+            assert.ok(err);
+            assert.equal(err.code, 'SQLITE_INTERRUPT');
+            done();
+        });
+        check.once('progress', function() { check.cancel(); });
+    });
+
+    it('should reject in-memory databases', function(done) {
+        var memory = new sqlite3.Database(':memory:');
+        memory.integrityCheck(function(err) {
+            assert.ok(/In-memory databases/.test(err.message));
+            memory.close(done);
+        });
+    });
+
+    it('should find corruption', function(done) {
+        db.run("PRAGMA journal_mode = DELETE");
+        db.get("PRAGMA page_count", function(err, row) {
+            if (err) throw err;
+            var pages = row.page_count;
+            db.get("PRAGMA page_size", function(err, row) {
+                if (err) throw err;
+                // Overwrite the cell pointers of the last page.
+                var fd = fs.openSync(file, 'r+');
+                var garbage = new Buffer(200);
+                garbage.fill(0xff);
+                fs.writeSync(fd, garbage, 0, garbage.length, (pages - 1) * row.page_size + 100);
+                fs.closeSync(fd);
+                db.integrityCheck({ quick: true, maxErrors: 3 }, function(err, problems) {
+                    if (err) throw err;
+                    assert.ok(problems.length > 0);
+                    done();
+                });
+            });
+        });
+    });
+
+    after(function(done) {
+        db.close(done);
+    });
+});
@@ -0,0 +1,91 @@
+var sqlite3 = require('..');
+var assert = require('assert');
+
+describe('lock stats', function() {
+    var db;
+    before(function(done) {
+        db = new sqlite3.Database(':memory:', function(err) {
+            if (err) throw err;
+            db.exec("CREATE TABLE foo (id INT); INSERT INTO foo VALUES (1), (2), (3)", done);
+        });
+    });
+
+    it('should count acquisitions of the connection mutex', function(done) {
+        var stmt = db.prepare("INSERT INTO foo VALUES (?)");
+        stmt.run(4);
+        stmt.run(5);
+        stmt.run(6, function(err) {
+            if (err) throw err;
+            // The last operation is counted before its callback runs.
+            var stats = stmt.lockStats();
+            assert.equal(stats.connection.acquisitions, 4);
+            assert.ok(stats.connection.contentions <= 4);
+            assert.ok(stats.connection.waitTime >= 0);
+            assert.deepEqual(stats.rows, { acquisitions: 0, contentions: 0, waitTime: 0 });
+            stmt.finalize(done);
+        });
+    });
+
+    it('should count waits for the rows of each()', function(done) {
+        var stmt = db.prepare("SELECT id FROM foo");
+        stmt.each(function(err) {
+            if (err) throw err;
+        }, function(err, count) {
+            if (err) throw err;
+            assert.equal(count, 6);
+            // The row buffer is counted when its handle is closed.
+            setTimeout(function() {
+                var stats = stmt.lockStats(true);
+                assert.ok(stats.rows.acquisitions >= 7);
+                assert.equal(stmt.lockStats().rows.acquisitions, 0);
+                stmt.finalize(done);
+            }, 10);
+        });
+    });
+
+    it('should report waits by operation', function(done) {
+        db.parallelize(function() {
+            for (var i = 0; i < 10; i++) db.get("SELECT count(*) FROM foo");
+            db.get("SELECT 1", function(err) {
+                if (err) throw err;
+                var lines = sqlite3.metrics().split('\n');
+                function find(prefix) {
+                    return lines.filter(function(line) {
+                        return line.indexOf(prefix) === 0 && line.indexOf('filename=":memory:"') > 0;
+                    });
+                }
+                var get = find('sqlite3_lock_acquisitions_total').filter(function(line) {
+                    return line.indexOf('lock="connection",operation="Statement.Get"') > 0;
+                });
+                assert.equal(get.length, 1);
+                assert.ok(Number(get[0].split(' ').pop()) >= 11);
+                assert.ok(find('sqlite3_lock_wait_seconds_total').length >= 4);
+                assert.ok(find('sqlite3_lock_contentions_total').some(function(line) {
+                    return line.indexOf('lock="rows",operation="Statement.Each"') > 0;
+                }));
+                done();
+            });
+        });
+    });
+
+    it('should add lock waits to timeline spans', function(done) {
+        sqlite3.timeline.start();
+        db.all("SELECT * FROM foo", function(err) {
+            if (err) throw err;
+            setImmediate(function() {
+                sqlite3.timeline.stop();
+                var spans = sqlite3.timeline.spans(true);
+                assert.ok(spans.length);
+                spans.forEach(function(span) {
+                    assert.equal(typeof span.lockWait, 'number');
+                    assert.ok(span.lockWait <= span.workEnd - span.workStart + 0.001);
+                });
+                done();
+            });
+        });
+    });
+
+    after(function(done) {
+        db.close(done);
+    });
+});
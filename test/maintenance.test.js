@@ -0,0 +1,101 @@
+var sqlite3 = require('..');
+var assert = require('assert');
+var helper = require('./support/helper');
+
+describe('maintenance', function() {
+    var db;
+    before(function(done) {
+        helper.deleteFile('test/tmp/test_maintenance.db');
+        helper.ensureExists('test/tmp');
+        db = new sqlite3.Database('test/tmp/test_maintenance.db', done);
+    });
+
+    it('should reject invalid options', function() {
+        assert.throws(function() {
+            db.configure('maintenanceMode', true);
+        }, /is not a valid configuration option/);
+    });
+
+    it('should set up an incrementally vacuumed table', function(done) {
+        db.serialize(function() {
+            db.run("PRAGMA auto_vacuum = INCREMENTAL");
+            db.run("CREATE TABLE foo (id INTEGER PRIMARY KEY, txt TEXT)");
+            db.run("CREATE INDEX foo_txt ON foo (txt)");
+            db.run("BEGIN");
+            var stmt = db.prepare("INSERT INTO foo (txt) VALUES (?)");
+            for (var i = 0; i < 2000; i++) {
+                stmt.run(new Array(100).join('x') + i);
+            }
+            stmt.finalize();
+            db.run("COMMIT");
+            db.run("DELETE FROM foo WHERE id > 100", done);
+        });
+    });
+
+    it('should analyze and vacuum when idle', function(done) {
+        var analyzed = false, vacuumed = 0;
+        db.on('maintenance', function(result) {
+            assert.equal(typeof result.interrupted, 'boolean');
+            if (result.analyzed === 'foo') analyzed = true;
+            vacuumed += result.vacuumed;
+            if (analyzed && vacuumed > 0) {
+                db.removeAllListeners('maintenance');
+                db.configure('maintenance', false);
+                done();
+            }
+        });
+        db.configure('maintenance', { idle: 10, budget: 1000, vacuumPages: 1000 });
+    });
+
+    it('should have written statistics', function(done) {
+        db.all("SELECT tbl FROM sqlite_stat1 WHERE tbl = 'foo'", function(err, rows) {
+            if (err) throw err;
+            assert.ok(rows.length > 0);
+            done();
+        });
+    });
+
+    it('should only analyze tables written to since', function(done) {
+        var analyzed = [], written = false;
+        db.run("CREATE TABLE bar (id INTEGER PRIMARY KEY)", function(err) {
+            if (err) throw err;
+            db.on('maintenance', function(result) {
+                if (result.analyzed) analyzed.push(result.analyzed);
+                if (result.analyzed || result.interrupted || result.vacuumed) return;
+                // Settled.
+                if (!written) {
+                    assert.deepEqual(analyzed.sort(), [ 'bar', 'foo' ]);
+                    analyzed = [];
+                    written = true;
+                    var stmt = db.prepare("INSERT INTO bar VALUES (NULL)");
+                    stmt.run();
+                    stmt.finalize();
+                }
+                else {
+                    assert.deepEqual(analyzed, [ 'bar' ]);
+                    db.removeAllListeners('maintenance');
+                    db.configure('maintenance', false);
+                    done();
+                }
+            });
+            db.configure('maintenance', { idle: 10, budget: 1000, vacuumPages: 0 });
+        });
+    });
+
+    it('should not delay queries', function(done) {
+        db.configure('maintenance', { idle: 0, budget: 1000 });
+        db.get("SELECT count(*) AS n FROM foo", function(err, row) {
+            if (err) throw err;
+            assert.equal(row.n, 100);
+            db.configure('maintenance', false);
+            done();
+        });
+    });
+
+    after(function(done) {
+        db.close(function() {
+            helper.deleteFile('test/tmp/test_maintenance.db');
+            done();
+        });
+    });
+});
@@ -0,0 +1,81 @@
+var sqlite3 = require('..');
+var assert = require('assert');
+var helper = require('./support/helper');
+
+describe('metrics', function() {
+    var file = 'test/tmp/test_metrics.db';
+    var db, other;
+    before(function(done) {
+        helper.deleteFile(file);
+        helper.ensureExists('test/tmp');
+        db = new sqlite3.Database(file, function(err) {
+            if (err) throw err;
+            db.exec("CREATE TABLE foo (id INTEGER PRIMARY KEY, txt TEXT)", function(err) {
+                if (err) throw err;
+                other = new sqlite3.Database(file, done);
+            });
+        });
+    });
+
+    function value(text, name, filter) {
+        var lines = text.split('\n').filter(function(line) {
+            return line.indexOf(name + '{') === 0 && line.indexOf('filename="' + file + '"') > 0 &&
+                (!filter || line.indexOf(filter) > 0);
+        });
+        assert.ok(lines.length, 'missing ' + name);
+        return Number(lines[0].split(' ').pop());
+    }
+
+    it('should render OpenMetrics text', function(done) {
+        db.run("INSERT INTO foo (txt) VALUES ('abc')");
+        db.all("SELECT * FROM foo", function(err) {
+            if (err) throw err;
+            var text = sqlite3.metrics();
+            assert.ok(/\n# EOF\n$/.test(text));
+            assert.ok(text.indexOf('# TYPE sqlite3_operation_duration_seconds histogram\n') >= 0);
+            assert.equal(value(text, 'sqlite3_queue_depth'), 0);
+            assert.equal(value(text, 'sqlite3_pending_result_bytes'), 0);
+            assert.equal(value(text, 'sqlite3_statements_prepared_total'), 2);
+            assert.equal(value(text, 'sqlite3_table_reads_total', 'table="foo"'), 1);
+            assert.equal(value(text, 'sqlite3_table_writes_total', 'table="foo"'), 1);
+            assert.ok(value(text, 'sqlite3_page_cache_hits_total') +
+                value(text, 'sqlite3_page_cache_misses_total') > 0);
+            var count = value(text, 'sqlite3_operation_duration_seconds_count');
+            assert.ok(count >= 4);
+            assert.equal(value(text, 'sqlite3_operation_duration_seconds_bucket', 'le="+Inf"'), count);
+            done();
+        });
+    });
+
+    it('should count busy retries', function(done) {
+        other.configure('busyTimeout', 30);
+        db.exec("BEGIN EXCLUSIVE", function(err) {
+            if (err) throw err;
+            other.run("INSERT INTO foo (txt) VALUES ('def')", function(err) {
+                assert.ok(err);
+                assert.equal(err.code, 'SQLITE_BUSY');
+                var retries = sqlite3.metrics().split('\n').filter(function(line) {
+                    return line.indexOf('sqlite3_busy_retries_total{') === 0;
+                }).map(function(line) { return Number(line.split(' ').pop()); });
+                assert.ok(Math.max.apply(Math, retries) > 0);
+                db.exec("COMMIT", done);
+            });
+        });
+    });
+
+    it('should leave out closed databases', function(done) {
+        other.close(function(err) {
+            if (err) throw err;
+            var lines = sqlite3.metrics().split('\n').filter(function(line) {
+                return line.indexOf('sqlite3_queue_depth{') === 0 &&
+                    line.indexOf('filename="' + file + '"') > 0;
+            });
+            assert.equal(lines.length, 1);
+            done();
+        });
+    });
+
+    after(function(done) {
+        db.close(done);
+    });
+});
@@ -0,0 +1,148 @@
+var sqlite3 = require('..');
+var assert = require('assert');
+var helper = require('./support/helper');
+
+describe('parallelAll', function() {
+    var db;
+    before(function(done) {
+        helper.deleteFile('test/tmp/test_parallel_all.db');
+        helper.ensureExists('test/tmp');
+        db = new sqlite3.Database('test/tmp/test_parallel_all.db', done);
+    });
+
+    it('should create and fill the table', function(done) {
+        db.serialize(function() {
+            db.run("CREATE TABLE foo (id INTEGER PRIMARY KEY, num INT)");
+            db.run("BEGIN");
+            var stmt = db.prepare("INSERT INTO foo (num) VALUES (?)");
+            for (var i = 1; i <= 1000; i++) {
+                stmt.run(i);
+            }
+            stmt.finalize();
+            db.run("COMMIT", done);
+        });
+    });
+
+    it('should concatenate the rows of all parts', function(done) {
+        db.parallelAll("SELECT id FROM foo WHERE id >= $partitionStart AND id < $partitionEnd ORDER BY id",
+                { table: 'foo', parts: 4 }, function(err, rows) {
+            if (err) throw err;
+            assert.equal(rows.length, 1000);
+            for (var i = 0; i < rows.length; i++) {
+                assert.equal(rows[i].id, i + 1);
+            }
+            done();
+        });
+    });
+
+    it('should combine aggregates', function(done) {
+        db.parallelAll("SELECT count(*) AS n, sum(num) AS total, max(num) AS top FROM foo " +
+                "WHERE num > ? AND rowid >= $partitionStart AND rowid < $partitionEnd", 10,
+                { table: 'foo', parts: 3, merge: { n: 'sum', total: 'sum', top: 'max' } },
+                function(err, rows) {
+            if (err) throw err;
+            assert.deepEqual(rows, [ { n: 990, total: 500445, top: 1000 } ]);
+            done();
+        });
+    });
+
+    it('should return an empty result for an empty table', function(done) {
+        db.run("CREATE TABLE empty (id INTEGER PRIMARY KEY)", function(err) {
+            if (err) throw err;
+            db.parallelAll("SELECT id FROM empty WHERE id >= $partitionStart AND id < $partitionEnd",
+                    { table: 'empty', parts: 2 }, function(err, rows) {
+                if (err) throw err;
+                assert.deepEqual(rows, []);
+                done();
+            });
+        });
+    });
+
+    it('should report query errors', function(done) {
+        db.parallelAll("SELECT nope FROM foo WHERE rowid >= $partitionStart AND rowid < $partitionEnd",
+                { table: 'foo', parts: 2 }, function(err) {
+            assert.ok(err);
+            assert.equal(err.code, 'SQLITE_ERROR');
+            done();
+        });
+    });
+
+    it('should require a table', function(done) {
+        db.parallelAll("SELECT 1", {}, function(err) {
+            assert.ok(err instanceof TypeError);
+            done();
+        });
+    });
+
+    it('should quote the table and column', function(done) {
+        db.serialize(function() {
+            db.run('CREATE TABLE "odd ""name""" ("my id" INTEGER)');
+            db.run('INSERT INTO "odd ""name""" VALUES (1), (2), (3)');
+            db.parallelAll('SELECT count(*) AS n FROM "odd ""name""" ' +
+                    'WHERE "my id" >= $partitionStart AND "my id" < $partitionEnd',
+                    { table: 'odd "name"', partitionBy: 'my id', parts: 2, merge: { n: 'sum' } },
+                    function(err, rows) {
+                if (err) throw err;
+                assert.deepEqual(rows, [ { n: 3 } ]);
+                done();
+            });
+        });
+    });
+
+    it('should reject columns without integer ranges', function(done) {
+        db.serialize(function() {
+            db.run("CREATE TABLE words (word TEXT)");
+            db.run("INSERT INTO words VALUES ('apple'), ('pear')");
+            db.parallelAll("SELECT word FROM words WHERE word >= $partitionStart AND word < $partitionEnd",
+                    { table: 'words', partitionBy: 'word' }, function(err) {
+                assert.ok(err instanceof TypeError);
+                assert.ok(/integer partitionBy column/.test(err.message));
+                done();
+            });
+        });
+    });
+
+    it('should call functions registered on the database', function(done) {
+        db.function('triple', function(x) { return x * 3; });
+        db.aggregate('js_count', { start: 0, step: function(n, x) { return n + 1; } });
+        db.parallelAll("SELECT sum(triple(num)) AS total, js_count(num) AS n FROM foo " +
+                "WHERE rowid >= $partitionStart AND rowid < $partitionEnd",
+                { table: 'foo', parts: 4, merge: { total: 'sum', n: 'sum' } }, function(err, rows) {
+            if (err) throw err;
+            assert.deepEqual(rows, [ { total: 1501500, n: 1000 } ]);
+            done();
+        });
+    });
+
+    it('should close the database and its readers', function(done) {
+        db.close(done);
+    });
+
+    it('should report failing readers to every caller', function(done) {
+        var file = 'test/tmp/test_parallel_all_gone.db';
+        helper.deleteFile(file);
+        var gone = new sqlite3.Database(file, function(err) {
+            if (err) throw err;
+            gone.serialize(function() {
+                gone.run("CREATE TABLE foo (id INTEGER PRIMARY KEY)");
+                gone.run("INSERT INTO foo VALUES (1), (2)", function(err) {
+                    if (err) throw err;
+                    // Readers can't open the file anymore.
+                    helper.deleteFile(file);
+                    var errors = 0;
+                    function failed(err) {
+                        assert.ok(err);
+                        if (++errors === 2) gone.close(done);
+                    }
+                    var sql = "SELECT id FROM foo WHERE id >= $partitionStart AND id < $partitionEnd";
+                    gone.parallelAll(sql, { table: 'foo', parts: 2 }, failed);
+                    gone.parallelAll(sql, { table: 'foo', parts: 2 }, failed);
+                });
+            });
+        });
+    });
+
+    after(function() {
+        helper.deleteFile('test/tmp/test_parallel_all.db');
+    });
+});
@@ -0,0 +1,100 @@
+var sqlite3 = require('..');
+var assert = require('assert');
+var helper = require('./support/helper');
+
+describe('connection pool', function() {
+    var file = 'test/tmp/test_pool.db';
+    before(function() {
+        sqlite3.drainPool();
+        helper.deleteFile(file);
+        helper.ensureExists('test/tmp');
+    });
+
+    it('should return connections on close', function(done) {
+        var db = sqlite3.pooled.Database(file, function(err) {
+            if (err) throw err;
+            assert.ok(db.mode & sqlite3.OPEN_POOLED);
+            assert.deepEqual(sqlite3.poolStats(), { idle: 0, borrowed: 1 });
+            db.exec("CREATE TABLE foo (id INTEGER PRIMARY KEY, txt TEXT);" +
+                "INSERT INTO foo (txt) VALUES ('one')", function(err) {
+                if (err) throw err;
+                db.close(function(err) {
+                    if (err) throw err;
+                    assert.deepEqual(sqlite3.poolStats(), { idle: 1, borrowed: 0 });
+                    done();
+                });
+            });
+        });
+    });
+
+    it('should reuse idle connections', function(done) {
+        var db = sqlite3.pooled.Database(file, function(err) {
+            if (err) throw err;
+            assert.deepEqual(sqlite3.poolStats(), { idle: 0, borrowed: 1 });
+            db.get("SELECT txt FROM foo", function(err, row) {
+                if (err) throw err;
+                assert.equal(row.txt, 'one');
+                db.close(done);
+            });
+        });
+    });
+
+    it('should resolve paths and keep native functions', function(done) {
+        var db = sqlite3.pooled.Database('./test/tmp/../tmp/test_pool.db', function(err) {
+            if (err) throw err;
+            assert.deepEqual(sqlite3.poolStats(), { idle: 0, borrowed: 1 });
+            db.get("SELECT txt REGEXP '^o' AS o FROM foo", function(err, row) {
+                if (err) throw err;
+                assert.equal(row.o, 1);
+                db.close(done);
+            });
+        });
+    });
+
+    it('should key connections by flags', function(done) {
+        var db = sqlite3.pooled.Database(file, sqlite3.OPEN_READONLY, function(err) {
+            if (err) throw err;
+            assert.deepEqual(sqlite3.poolStats(), { idle: 1, borrowed: 1 });
+            db.close(done);
+        });
+    });
+
+    it('should not keep connections with open transactions', function(done) {
+        sqlite3.drainPool();
+        var db = sqlite3.pooled.Database(file, function(err) {
+            if (err) throw err;
+            db.exec("BEGIN", function(err) {
+                if (err) throw err;
+                db.close(function(err) {
+                    if (err) throw err;
+                    assert.deepEqual(sqlite3.poolStats(), { idle: 0, borrowed: 0 });
+                    done();
+                });
+            });
+        });
+    });
+
+    it('should not keep in-memory connections', function(done) {
+        var db = sqlite3.pooled.Database(':memory:', function(err) {
+            if (err) throw err;
+            db.close(function(err) {
+                if (err) throw err;
+                assert.deepEqual(sqlite3.poolStats(), { idle: 0, borrowed: 0 });
+                done();
+            });
+        });
+    });
+
+    it('should drain idle connections', function(done) {
+        var db = sqlite3.pooled.Database(file, function(err) {
+            if (err) throw err;
+            db.close(function(err) {
+                if (err) throw err;
+                assert.equal(sqlite3.poolStats().idle, 1);
+                sqlite3.drainPool();
+                assert.equal(sqlite3.poolStats().idle, 0);
+                done();
+            });
+        });
+    });
+});
@@ -0,0 +1,85 @@
+var sqlite3 = require('..');
+var assert = require('assert');
+
+if (typeof Promise === 'undefined' || !sqlite3.Statement.prototype.runAsync) return;
+
+describe('promises', function() {
+    var db;
+    before(function() {
+        db = new sqlite3.Database(':memory:');
+        return db.execAsync("CREATE TABLE foo (id INTEGER PRIMARY KEY, txt TEXT)");
+    });
+
+    it('should run statements', function() {
+        return db.runAsync("INSERT INTO foo (txt) VALUES (?)", 'one').then(function(result) {
+            assert.deepEqual(result, { lastID: 1, changes: 1 });
+            return db.runAsync("INSERT INTO foo (txt) VALUES (?)", 'two');
+        }).then(function(result) {
+            assert.equal(result.lastID, 2);
+        });
+    });
+
+    it('should get rows', function() {
+        return db.getAsync("SELECT txt FROM foo WHERE id = ?", 2).then(function(row) {
+            assert.deepEqual(row, { txt: 'two' });
+            return db.getAsync("SELECT txt FROM foo WHERE id = ?", 3);
+        }).then(function(row) {
+            assert.strictEqual(row, undefined);
+        });
+    });
+
+    it('should get all rows', function() {
+        return db.allAsync("SELECT id, txt FROM foo ORDER BY id").then(function(rows) {
+            assert.deepEqual(rows, [ { id: 1, txt: 'one' }, { id: 2, txt: 'two' } ]);
+        });
+    });
+
+    it('should prepare statements', function() {
+        return db.prepareAsync("SELECT txt FROM foo WHERE id = ?", 1).then(function(stmt) {
+            assert.ok(stmt instanceof sqlite3.Statement);
+            return stmt.getAsync().then(function(row) {
+                assert.equal(row.txt, 'one');
+                return stmt.allAsync(2);
+            }).then(function(rows) {
+                assert.deepEqual(rows, [ { txt: 'two' } ]);
+                return stmt.finalizeAsync();
+            });
+        });
+    });
+
+    it('should reject on errors', function() {
+        return db.allAsync("SELECT * FROM missing").then(function() {
+            assert.fail('should have been rejected');
+        }, function(err) {
+            assert.equal(err.code, 'SQLITE_ERROR');
+            assert.ok(/no such table: missing/.test(err.message));
+            return db.runAsync("INSERT INTO foo (id) VALUES (1)");
+        }).then(function() {
+            assert.fail('should have been rejected');
+        }, function(err) {
+            assert.equal(err.code, 'SQLITE_CONSTRAINT');
+        });
+    });
+
+    it('should reject finalized statements', function() {
+        var stmt = db.prepare("SELECT 1");
+        return stmt.finalizeAsync().then(function() {
+            return stmt.getAsync();
+        }).then(function() {
+            assert.fail('should have been rejected');
+        }, function(err) {
+            assert.ok(/Statement is already finalized/.test(err.message));
+        });
+    });
+
+    it('should close', function() {
+        return db.closeAsync().then(function() {
+            assert.equal(db.open, false);
+            return db.execAsync("SELECT 1");
+        }).then(function() {
+            assert.fail('should have been rejected');
+        }, function(err) {
+            assert.ok(/Database is closed/.test(err.message));
+        });
+    });
+});
@@ -0,0 +1,85 @@
+var sqlite3 = require('..');
+var assert = require('assert');
+
+describe('regexp', function() {
+    var db;
+    before(function(done) {
+        db = new sqlite3.Database(':memory:', function(err) {
+            if (err) throw err;
+            db.serialize(function() {
+                db.run("CREATE TABLE foo (txt TEXT)");
+                var stmt = db.prepare("INSERT INTO foo VALUES (?)");
+                [ 'apple', 'banana', 'cherry', 'Avocado', null ].forEach(function(txt) {
+                    stmt.run(txt);
+                });
+                stmt.finalize(done);
+            });
+        });
+    });
+
+    it('should filter rows with REGEXP', function(done) {
+        db.all("SELECT txt FROM foo WHERE txt REGEXP ? ORDER BY txt", '^[aA]', function(err, rows) {
+            if (err) throw err;
+            assert.deepEqual(rows, [ { txt: 'Avocado' }, { txt: 'apple' } ]);
+            done();
+        });
+    });
+
+    it('should search anywhere in the text', function(done) {
+        db.get("SELECT 'hello world' REGEXP 'o\\s+w' AS yes, 'hello' REGEXP 'x' AS no", function(err, row) {
+            if (err) throw err;
+            assert.deepEqual(row, { yes: 1, no: 0 });
+            done();
+        });
+    });
+
+    it('should return NULL for NULL arguments', function(done) {
+        db.get("SELECT NULL REGEXP 'a' AS a, 'a' REGEXP NULL AS b", function(err, row) {
+            if (err) throw err;
+            assert.deepEqual(row, { a: null, b: null });
+            done();
+        });
+    });
+
+    it('should report invalid patterns', function(done) {
+        db.all("SELECT txt FROM foo WHERE txt REGEXP '('", function(err) {
+            assert.ok(err);
+            assert.ok(/invalid regular expression/.test(err.message));
+            done();
+        });
+    });
+
+    it('should match code points rather than bytes', function(done) {
+        db.get("SELECT 'caf\u00e9' REGEXP '^caf.$' AS dot, 'na\u00efve' REGEXP '^na[\u00e0-\u00ff]ve$' AS class",
+            function(err, row) {
+                if (err) throw err;
+                assert.deepEqual(row, { dot: 1, class: 1 });
+                done();
+            });
+    });
+
+    it('should match long texts without backtracking', function(done) {
+        db.get("SELECT x REGEXP 'a.*c' AS a, x REGEXP '(a|b)*c' AS b, x REGEXP '^(a|aa)+$' AS c " +
+               "FROM (SELECT replace(zeroblob(200000), X'00', 'a') AS x)", function(err, row) {
+            if (err) throw err;
+            assert.deepEqual(row, { a: 0, b: 0, c: 1 });
+            done();
+        });
+    });
+
+    it('should reject backreferences and lookarounds', function(done) {
+        db.get("SELECT 'aa' REGEXP '(a)\\1'", function(err) {
+            assert.ok(err);
+            assert.ok(/backreferences are not supported/.test(err.message));
+            db.get("SELECT 'ab' REGEXP 'a(?=b)'", function(err) {
+                assert.ok(err);
+                assert.ok(/lookarounds are not supported/.test(err.message));
+                done();
+            });
+        });
+    });
+
+    after(function(done) {
+        db.close(done);
+    });
+});
@@ -0,0 +1,92 @@
+var sqlite3 = require('..');
+var assert = require('assert');
+
+describe('resultSet', function() {
+    var db;
+    before(function(done) {
+        db = new sqlite3.Database(':memory:', function(err) {
+            if (err) throw err;
+            db.exec("CREATE TABLE foo (id INTEGER PRIMARY KEY, num REAL, txt TEXT, raw BLOB);" +
+                "INSERT INTO foo VALUES (1, 1.5, 'one', x'00010203');" +
+                "INSERT INTO foo VALUES (-2, NULL, 'zwei ü', NULL);" +
+                "INSERT INTO foo VALUES (9007199254740991, -0.25, '', x'');" +
+                "INSERT INTO foo VALUES (-9007199254740991, 1e300, NULL, x'ff')", done);
+        });
+    });
+
+    it('should decode the same rows as all()', function(done) {
+        var sql = "SELECT * FROM foo ORDER BY rowid";
+        db.all(sql, function(err, rows) {
+            if (err) throw err;
+            db.resultSet(sql, function(err, result) {
+                if (err) throw err;
+                assert.ok(result instanceof sqlite3.ResultSet);
+                assert.equal(result.length, 4);
+                assert.deepEqual(result.columns, [ 'id', 'num', 'txt', 'raw' ]);
+                for (var i = 0; i < result.length; i++) {
+                    assert.deepEqual(result.row(i), rows[i]);
+                }
+                assert.deepEqual(result.toArray(), rows);
+                done();
+            });
+        });
+    });
+
+    it('should read single columns', function(done) {
+        db.resultSet("SELECT txt, id FROM foo WHERE id > ? ORDER BY id", -3, function(err, result) {
+            if (err) throw err;
+            assert.deepEqual(result.column('id'), [ -2, 1, 9007199254740991 ]);
+            assert.deepEqual(result.column('txt'), [ 'zwei ü', 'one', '' ]);
+            assert.throws(function() { result.column('nope'); }, /No column named nope/);
+            assert.throws(function() { result.row(3); }, RangeError);
+            done();
+        });
+    });
+
+    it('should iterate', function(done) {
+        if (typeof Symbol !== 'function') return done();
+        var stmt = db.prepare("SELECT id FROM foo ORDER BY id");
+        stmt.resultSet(function(err, result) {
+            if (err) throw err;
+            var ids = [];
+            var iterator = result[Symbol.iterator]();
+            for (var step = iterator.next(); !step.done; step = iterator.next()) {
+                ids.push(step.value.id);
+            }
+            assert.deepEqual(ids, [ -9007199254740991, -2, 1, 9007199254740991 ]);
+            stmt.finalize(done);
+        });
+    });
+
+    it('should be rebuilt from its ArrayBuffer', function(done) {
+        db.resultSet("SELECT * FROM foo", function(err, result) {
+            if (err) throw err;
+            var buffer = result.toArrayBuffer();
+            assert.ok(buffer instanceof ArrayBuffer);
+            assert.deepEqual(new sqlite3.ResultSet(buffer).toArray(), result.toArray());
+            done();
+        });
+    });
+
+    it('should return empty results', function(done) {
+        db.resultSet("SELECT id AS a, txt AS b FROM foo WHERE 0", function(err, result) {
+            if (err) throw err;
+            assert.equal(result.length, 0);
+            assert.deepEqual(result.columns, [ 'a', 'b' ]);
+            assert.deepEqual(result.column('a'), []);
+            done();
+        });
+    });
+
+    it('should report errors', function(done) {
+        db.resultSet("SELECT * FROM missing", function(err) {
+            assert.ok(/no such table: missing/.test(err.message));
+            assert.equal(err.code, 'SQLITE_ERROR');
+            done();
+        });
+    });
+
+    after(function(done) {
+        db.close(done);
+    });
+});
@@ -0,0 +1,115 @@
+var sqlite3 = require('..');
+var assert = require('assert');
+var helper = require('./support/helper');
+
+describe('ShardedDatabase', function() {
+    var files = [ 0, 1, 2 ].map(function(i) { return 'test/tmp/test_sharded_' + i + '.db'; });
+    var sharded;
+
+    before(function(done) {
+        helper.ensureExists('test/tmp');
+        files.forEach(helper.deleteFile);
+        sharded = new sqlite3.ShardedDatabase(files, done);
+    });
+
+    it('should create the schema on every shard', function(done) {
+        sharded.exec("CREATE TABLE users (id INTEGER PRIMARY KEY, name TEXT)", done);
+    });
+
+    it('should route writes by key', function(done) {
+        var remaining = 30;
+        for (var i = 1; i <= 30; i++) {
+            sharded.run(i, "INSERT INTO users VALUES (?, ?)", i, 'user ' + i, function(err) {
+                if (err) throw err;
+                if (!--remaining) done();
+            });
+        }
+    });
+
+    it('should read a single key from its shard', function(done) {
+        sharded.get(7, "SELECT name FROM users WHERE id = ?", 7, function(err, row) {
+            if (err) throw err;
+            assert.deepEqual(row, { name: 'user 7' });
+            done();
+        });
+    });
+
+    it('should spread keys over all shards', function(done) {
+        var seen = {};
+        for (var i = 1; i <= 30; i++) seen[sharded.shardFor(i)] = true;
+        assert.equal(Object.keys(seen).length, 3);
+        done();
+    });
+
+    it('should merge sorted results', function(done) {
+        sharded.fanout("SELECT id FROM users ORDER BY id", { orderBy: 'id', limit: 10 }, function(err, rows) {
+            if (err) throw err;
+            assert.deepEqual(rows.map(function(row) { return row.id; }), [ 1, 2, 3, 4, 5, 6, 7, 8, 9, 10 ]);
+            done();
+        });
+    });
+
+    it('should combine aggregates', function(done) {
+        sharded.fanout("SELECT count(*) AS n, max(id) AS top FROM users WHERE id > ?", 10,
+                { merge: { n: 'sum', top: 'max' } }, function(err, rows) {
+            if (err) throw err;
+            assert.deepEqual(rows, [ { n: 20, top: 30 } ]);
+            done();
+        });
+    });
+
+    it('should only query the shards owning the keys', function(done) {
+        sharded.fanout("SELECT id FROM users WHERE id IN (3, 4)", { keys: [ 3, 4 ] }, function(err, rows) {
+            if (err) throw err;
+            assert.deepEqual(rows.map(function(row) { return row.id; }).sort(), [ 3, 4 ]);
+            done();
+        });
+    });
+
+    it('should support range sharding', function(done) {
+        var ranged = new sqlite3.ShardedDatabase([ ':memory:', ':memory:' ], { ranges: [ 100 ] }, function(err) {
+            if (err) throw err;
+            assert.equal(ranged.shardFor(99), 0);
+            assert.equal(ranged.shardFor(100), 1);
+            ranged.close(done);
+        });
+    });
+
+    it('should reject unsorted range boundaries', function() {
+        var memory = [ ':memory:', ':memory:', ':memory:' ];
+        assert.throws(function() {
+            new sqlite3.ShardedDatabase(memory, { ranges: [ 200, 100 ] });
+        }, /strictly increasing/);
+        assert.throws(function() {
+            new sqlite3.ShardedDatabase(memory, { ranges: [ 100, 100 ] });
+        }, /strictly increasing/);
+        assert.throws(function() {
+            new sqlite3.ShardedDatabase(memory, { ranges: [ 100 ] });
+        }, /Expected 2 range boundaries/);
+    });
+
+    it('should query private in-memory shards opened by URI', function(done) {
+        var memory = new sqlite3.ShardedDatabase([ 'file::memory:', 'file:shard?mode=memory' ], function(err) {
+            if (err) throw err;
+            memory.exec("CREATE TABLE users (id INTEGER PRIMARY KEY)", function(err) {
+                if (err) throw err;
+                memory.run(1, "INSERT INTO users VALUES (1)", function(err) {
+                    if (err) throw err;
+                    memory.fanout("SELECT count(*) AS n FROM users", { merge: { n: 'sum' } }, function(err, rows) {
+                        if (err) throw err;
+                        assert.deepEqual(rows, [ { n: 1 } ]);
+                        memory.close(done);
+                    });
+                });
+            });
+        });
+    });
+
+    it('should close all shards', function(done) {
+        sharded.close(done);
+    });
+
+    after(function() {
+        files.forEach(helper.deleteFile);
+    });
+});
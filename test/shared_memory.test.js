@@ -0,0 +1,75 @@
+var sqlite3 = require('..');
+var assert = require('assert');
+
+describe('shared in-memory databases', function() {
+    var name = 'file:shared_memory_test?mode=memory&cache=shared';
+    var a, b;
+
+    before(function(done) {
+        a = new sqlite3.Database(name, function(err) {
+            if (err) throw err;
+            a.exec("CREATE TABLE foo (id INTEGER PRIMARY KEY, txt TEXT);" +
+                "INSERT INTO foo (txt) VALUES ('one'), ('two'), ('three'), ('four');", function(err) {
+                if (err) throw err;
+                b = new sqlite3.Database(name, done);
+            });
+        });
+    });
+
+    it('should open URIs', function() {
+        assert.ok(a.mode & sqlite3.OPEN_URI);
+        assert.ok(sqlite3.OPEN_SHAREDCACHE);
+        assert.ok(sqlite3.OPEN_PRIVATECACHE);
+    });
+
+    it('should share data between connections', function(done) {
+        b.all("SELECT txt FROM foo ORDER BY id", function(err, rows) {
+            if (err) throw err;
+            assert.deepEqual(rows.map(function(row) { return row.txt; }),
+                [ 'one', 'two', 'three', 'four' ]);
+            done();
+        });
+    });
+
+    it('should wait for locks held by other connections', function(done) {
+        a.exec("BEGIN; INSERT INTO foo (txt) VALUES ('five')", function(err) {
+            if (err) throw err;
+            var committed = false;
+            b.get("SELECT count(*) AS n FROM foo", function(err, row) {
+                if (err) throw err;
+                assert.ok(committed);
+                assert.equal(row.n, 5);
+                done();
+            });
+            setTimeout(function() {
+                committed = true;
+                a.exec("COMMIT", function(err) { if (err) throw err; });
+            }, 50);
+        });
+    });
+
+    it('should read in parallel', function(done) {
+        a.parallelAll("SELECT count(*) AS n FROM foo WHERE rowid >= $partitionStart AND rowid < $partitionEnd",
+            { table: 'foo', parts: 2, merge: { n: 'sum' } }, function(err, rows) {
+            if (err) throw err;
+            assert.equal(rows[0].n, 5);
+            assert.equal(a._readerPool.length, 2);
+            done();
+        });
+    });
+
+    it('should only cache shared URIs', function(done) {
+        var first = sqlite3.cached.Database('file::memory:');
+        var second = sqlite3.cached.Database('file::memory:');
+        assert.notEqual(first, second);
+        assert.equal(sqlite3.cached.Database(name), sqlite3.cached.Database(name));
+        first.close(function() { second.close(done); });
+    });
+
+    after(function(done) {
+        b.close(function(err) {
+            if (err) throw err;
+            a.close(done);
+        });
+    });
+});
@@ -0,0 +1,86 @@
+var sqlite3 = require('..');
+var assert = require('assert');
+var helper = require('./support/helper');
+
+describe('snapshot', function() {
+    var db;
+    before(function(done) {
+        helper.deleteFile('test/tmp/test_snapshot.db');
+        helper.ensureExists('test/tmp');
+        db = new sqlite3.Database('test/tmp/test_snapshot.db', function(err) {
+            if (err) throw err;
+            db.serialize(function() {
+                db.run("PRAGMA journal_mode = WAL");
+                db.run("CREATE TABLE foo (id INTEGER PRIMARY KEY)");
+                db.run("INSERT INTO foo VALUES (1), (2), (3)", done);
+            });
+        });
+    });
+
+    var snapshot;
+    it('should pin several readers to one snapshot', function(done) {
+        db.snapshot({ readers: 3 }, function(err, snap) {
+            if (err) throw err;
+            snapshot = snap;
+            assert.equal(snapshot.readers.length, 3);
+            done();
+        });
+    });
+
+    it('should not see later writes', function(done) {
+        db.run("INSERT INTO foo VALUES (4)", function(err) {
+            if (err) throw err;
+            var remaining = 3;
+            for (var i = 0; i < 3; i++) {
+                snapshot.get("SELECT count(*) AS n FROM foo", function(err, row) {
+                    if (err) throw err;
+                    assert.equal(row.n, 3);
+                    if (!--remaining) done();
+                });
+            }
+        });
+    });
+
+    it('should see writes on the database itself', function(done) {
+        db.get("SELECT count(*) AS n FROM foo", function(err, row) {
+            if (err) throw err;
+            assert.equal(row.n, 4);
+            done();
+        });
+    });
+
+    it('should release the snapshot', function(done) {
+        snapshot.release(function(err) {
+            if (err) throw err;
+            assert.throws(function() {
+                snapshot.all("SELECT 1");
+            }, /already been released/);
+            done();
+        });
+    });
+
+    it('should refuse in-memory databases', function(done) {
+        var memory = new sqlite3.Database(':memory:');
+        memory.snapshot(function(err) {
+            assert.ok(err);
+            memory.close(done);
+        });
+    });
+
+    it('should refuse private in-memory databases opened by URI', function(done) {
+        var memory = new sqlite3.Database('file:snapshot?mode=memory');
+        memory.snapshot(function(err) {
+            assert.ok(/require a database file/.test(err.message));
+            memory.close(done);
+        });
+    });
+
+    after(function(done) {
+        db.close(function() {
+            helper.deleteFile('test/tmp/test_snapshot.db');
+            helper.deleteFile('test/tmp/test_snapshot.db-wal');
+            helper.deleteFile('test/tmp/test_snapshot.db-shm');
+            done();
+        });
+    });
+});
@@ -0,0 +1,61 @@
+var sqlite3 = require('..');
+var assert = require('assert');
+
+describe('table stats', function() {
+    var db;
+    before(function(done) {
+        db = new sqlite3.Database(':memory:', function(err) {
+            if (err) throw err;
+            db.exec("CREATE TABLE users (id INTEGER PRIMARY KEY, name TEXT, email TEXT);" +
+                "CREATE TABLE orders (id INTEGER PRIMARY KEY, user INTEGER, total REAL);", done);
+        });
+    });
+
+    it('should start empty', function() {
+        // exec() doesn't prepare statements that are accounted.
+        assert.deepEqual(db.tableStats(), {});
+    });
+
+    it('should count reads and writes per table', function(done) {
+        var insert = db.prepare("INSERT INTO users (name, email) VALUES (?, ?)");
+        insert.run('a', 'a@example.com');
+        insert.run('b', 'b@example.com');
+        insert.finalize();
+        db.run("INSERT INTO orders (user, total) SELECT id, 10 FROM users");
+        db.all("SELECT name FROM users WHERE id = 1");
+        db.run("UPDATE users SET email = 'c@example.com' WHERE id = 2");
+        db.all("SELECT u.name, o.total FROM users u JOIN orders o ON o.user = u.id", function(err) {
+            if (err) throw err;
+            var stats = db.tableStats();
+            assert.equal(stats.users.writes, 3);
+            assert.equal(stats.users.changes, 3);
+            assert.equal(stats.users.reads, 4);
+            assert.equal(stats.orders.writes, 1);
+            assert.equal(stats.orders.changes, 2);
+            assert.equal(stats.orders.reads, 1);
+            // The authorizer only names columns for updates.
+            assert.deepEqual(stats.users.writtenColumns, ['email']);
+            assert.deepEqual(stats.users.readColumns, ['id', 'name']);
+            assert.deepEqual(stats.orders.readColumns, ['total', 'user']);
+            assert.ok(stats.users.vmSteps > 0);
+            done();
+        });
+    });
+
+    it('should count full scan steps', function(done) {
+        db.tableStats(true);
+        db.all("SELECT * FROM users WHERE name LIKE '%b%'", function(err, rows) {
+            if (err) throw err;
+            var stats = db.tableStats();
+            assert.equal(rows.length, 1);
+            assert.equal(stats.users.reads, 1);
+            assert.equal(stats.users.fullscanSteps, 2);
+            assert.equal(stats.orders.reads, 0);
+            done();
+        });
+    });
+
+    after(function(done) {
+        db.close(done);
+    });
+});
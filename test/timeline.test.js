@@ -0,0 +1,97 @@
+var sqlite3 = require('..');
+var assert = require('assert');
+
+describe('timeline', function() {
+    var db;
+    before(function(done) {
+        db = new sqlite3.Database(':memory:', function(err) {
+            if (err) throw err;
+            db.run("CREATE TABLE foo (id INT)", done);
+        });
+    });
+
+    it('should record the phases of operations', function(done) {
+        sqlite3.timeline.start();
+        db.serialize(function() {
+            db.run("INSERT INTO foo VALUES (1)");
+            db.all("SELECT * FROM foo", function(err) {
+                if (err) throw err;
+                // The span of this operation is recorded after its callback.
+                setImmediate(function() {
+                    sqlite3.timeline.stop();
+                    var spans = sqlite3.timeline.spans();
+                    assert.deepEqual(spans.map(function(span) { return span.name; }),
+                        [ 'Statement.Prepare', 'Statement.Run', 'Statement.Prepare', 'Statement.All' ]);
+                    spans.forEach(function(span) {
+                        assert.equal(span.connection, spans[0].connection);
+                        assert.ok(span.statement > 0);
+                        assert.ok(span.enqueued <= span.dequeued);
+                        assert.ok(span.dequeued <= span.workStart);
+                        assert.ok(span.workStart <= span.workEnd);
+                        assert.ok(span.workEnd <= span.afterStart);
+                        assert.ok(span.afterStart <= span.afterEnd);
+                    });
+                    assert.equal(spans[0].statement, spans[1].statement);
+                    assert.notEqual(spans[1].statement, spans[2].statement);
+                    done();
+                });
+            });
+        });
+    });
+
+    it('should not record while stopped', function(done) {
+        sqlite3.timeline.spans(true);
+        db.get("SELECT 1", function(err) {
+            if (err) throw err;
+            setImmediate(function() {
+                assert.equal(sqlite3.timeline.spans().length, 0);
+                done();
+            });
+        });
+    });
+
+    it('should keep the most recent spans', function(done) {
+        sqlite3.timeline.start(2);
+        db.exec("SELECT 1");
+        db.exec("SELECT 2");
+        db.exec("SELECT 3", function(err) {
+            if (err) throw err;
+            setImmediate(function() {
+                sqlite3.timeline.stop();
+                var spans = sqlite3.timeline.spans();
+                assert.equal(spans.length, 2);
+                assert.equal(spans[0].name, 'Database.Exec');
+                assert.ok(spans[0].id < spans[1].id);
+                done();
+            });
+        });
+    });
+
+    it('should export Chrome traces', function() {
+        var trace = sqlite3.timeline.toChromeTrace();
+        var names = trace.traceEvents.map(function(event) { return event.name; });
+        assert.deepEqual(names, [ 'thread_name',
+            'Database.Exec', 'queued', 'thread pool', 'work', 'callback',
+            'Database.Exec', 'queued', 'thread pool', 'work', 'callback' ]);
+        assert.equal(trace.traceEvents[1].ph, 'X');
+    });
+
+    it('should export OpenTelemetry spans', function() {
+        var data = sqlite3.timeline.toOpenTelemetry(true);
+        var spans = data.resourceSpans[0].scopeSpans[0].spans;
+        assert.equal(spans.length, 2);
+        assert.ok(/^[0-9a-f]{32}$/.test(spans[0].traceId));
+        assert.ok(/^[0-9a-f]{16}$/.test(spans[0].spanId));
+        assert.ok(/^\d+$/.test(spans[0].startTimeUnixNano));
+        assert.equal(spans[0].events.length, 4);
+        assert.equal(sqlite3.timeline.spans().length, 0);
+    });
+
+    it('should reject invalid capacities', function() {
+        assert.throws(function() { sqlite3.timeline.start(0); }, /capacity must be positive/);
+    });
+
+    after(function(done) {
+        db.close(done);
+    });
+});
@@ -0,0 +1,72 @@
+var sqlite3 = require('..');
+var assert = require('assert');
+
+describe('fts5 tokenizers', function() {
+    var db;
+    before(function(done) {
+        db = new sqlite3.Database(':memory:', done);
+    });
+
+    function matches(table, query, callback) {
+        db.all("SELECT highlight(" + table + ", 0, '[', ']') AS body FROM " + table +
+                " WHERE " + table + " MATCH ? ORDER BY rowid", query, function(err, rows) {
+            if (err) throw err;
+            callback(rows.map(function(row) { return row.body; }));
+        });
+    }
+
+    describe('ngram', function() {
+        before(function(done) {
+            db.exec("CREATE VIRTUAL TABLE grams USING fts5(body, tokenize = 'ngram');" +
+                "INSERT INTO grams VALUES ('The quick brown fox'), ('Crème brûlée');" +
+                "CREATE VIRTUAL TABLE cjk USING fts5(body, tokenize = 'ngram n 2');" +
+                "INSERT INTO cjk VALUES ('东京都的天气很好'), ('北京的天气');", done);
+        });
+
+        it('should find substrings', function(done) {
+            matches('grams', 'uick', function(rows) {
+                assert.deepEqual(rows, [ 'The q[uick] brown fox' ]);
+                done();
+            });
+        });
+
+        it('should fold case and diacritics', function(done) {
+            matches('grams', 'BRULE', function(rows) {
+                assert.deepEqual(rows, [ 'Crème [brûlé]e' ]);
+                done();
+            });
+        });
+
+        it('should split CJK text into bigrams', function(done) {
+            matches('cjk', '天气', function(rows) {
+                assert.deepEqual(rows, [ '东京都的[天气]很好', '北京的[天气]' ]);
+                done();
+            });
+        });
+    });
+
+    describe('fold', function() {
+        before(function(done) {
+            db.exec("CREATE VIRTUAL TABLE words USING fts5(body, tokenize = 'fold');" +
+                "INSERT INTO words VALUES ('Tiếng Việt'), ('Αθήνα'), ('Łódź');", done);
+        });
+
+        it('should match words without diacritics', function(done) {
+            matches('words', 'tieng OR αθηνα OR lodz', function(rows) {
+                assert.deepEqual(rows, [ '[Tiếng] Việt', '[Αθήνα]', '[Łódź]' ]);
+                done();
+            });
+        });
+
+        it('should reject unknown options', function(done) {
+            db.run("CREATE VIRTUAL TABLE bad USING fts5(body, tokenize = 'fold n 2')", function(err) {
+                assert.ok(err);
+                done();
+            });
+        });
+    });
+
+    after(function(done) {
+        db.close(done);
+    });
+});
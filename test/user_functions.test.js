@@ -0,0 +1,149 @@
+var sqlite3 = require('..');
+var assert = require('assert');
+
+describe('user functions', function() {
+    var db;
+    var calls = 0;
+    before(function(done) {
+        db = new sqlite3.Database(':memory:', function(err) {
+            if (err) throw err;
+            db.function('add', function(a, b) { return a + b; });
+            db.function('concat', function() {
+                return Array.prototype.join.call(arguments, '');
+            }, { varargs: true });
+            db.function('counted', function(x) { calls++; return x * 10; }, { deterministic: true });
+            db.function('fail', function() { throw new Error('boom'); });
+            db.function('nothing', function() {});
+            db.function('bytes', function(s) { return new Buffer(s); });
+            db.aggregate('js_sum', {
+                start: 0,
+                step: function(total, x) { return total + x; }
+            });
+            db.aggregate('js_avg', {
+                start: function() { return { sum: 0, count: 0 }; },
+                step: function(acc, x) { acc.sum += x; acc.count++; return acc; },
+                result: function(acc) { return acc.count ? acc.sum / acc.count : null; }
+            });
+            db.aggregate('js_fail', {
+                start: 0,
+                step: function(total, x) {
+                    if (x === 1500) throw new Error('bad row');
+                    return total + x;
+                }
+            });
+            db.exec("CREATE TABLE nums (n INTEGER, g INTEGER);" +
+                "WITH RECURSIVE c(i) AS (SELECT 1 UNION ALL SELECT i + 1 FROM c WHERE i < 3000) " +
+                "INSERT INTO nums SELECT i, i % 3 FROM c;", done);
+        });
+    });
+
+    it('should call scalar functions', function(done) {
+        db.get("SELECT add(1, 2) AS a, add('x', 'y') AS b, concat(1, 'a', 2.5) AS c",
+                function(err, row) {
+            if (err) throw err;
+            assert.deepEqual(row, { a: 3, b: 'xy', c: '1a2.5' });
+            done();
+        });
+    });
+
+    it('should convert results', function(done) {
+        db.get("SELECT nothing() AS a, typeof(nothing()) AS b, bytes('hi') AS c",
+                function(err, row) {
+            if (err) throw err;
+            assert.equal(row.a, null);
+            assert.equal(row.b, 'null');
+            assert.ok(Buffer.isBuffer(row.c));
+            assert.equal(row.c.toString(), 'hi');
+            done();
+        });
+    });
+
+    it('should check the number of arguments', function(done) {
+        db.get("SELECT add(1)", function(err) {
+            assert.ok(err);
+            assert.ok(/wrong number of arguments/.test(err.message));
+            done();
+        });
+    });
+
+    it('should report exceptions as query errors', function(done) {
+        db.get("SELECT fail()", function(err) {
+            assert.ok(err);
+            assert.ok(/boom/.test(err.message));
+            done();
+        });
+    });
+
+    it('should cache deterministic results', function(done) {
+        db.all("SELECT counted(g) AS x FROM nums", function(err, rows) {
+            if (err) throw err;
+            assert.equal(rows.length, 3000);
+            assert.equal(rows[0].x, 10);
+            assert.equal(calls, 3);
+            done();
+        });
+    });
+
+    it('should run aggregates over many batches', function(done) {
+        db.get("SELECT js_sum(n) AS a, sum(n) AS b, js_avg(n) AS c FROM nums", function(err, row) {
+            if (err) throw err;
+            assert.equal(row.a, row.b);
+            assert.equal(row.c, 1500.5);
+            done();
+        });
+    });
+
+    it('should keep separate state per group', function(done) {
+        db.all("SELECT g, js_sum(n) AS a, sum(n) AS b FROM nums GROUP BY g ORDER BY g", function(err, rows) {
+            if (err) throw err;
+            assert.equal(rows.length, 3);
+            rows.forEach(function(row) { assert.equal(row.a, row.b); });
+            done();
+        });
+    });
+
+    it('should call result for empty groups', function(done) {
+        db.get("SELECT js_sum(n) AS a, js_avg(n) AS b FROM nums WHERE n < 0", function(err, row) {
+            if (err) throw err;
+            assert.deepEqual(row, { a: 0, b: null });
+            done();
+        });
+    });
+
+    it('should report exceptions in aggregates', function(done) {
+        db.get("SELECT js_fail(n) FROM nums", function(err) {
+            assert.ok(err);
+            assert.ok(/bad row/.test(err.message));
+            done();
+        });
+    });
+
+    it('should not block calls while configuring or finalizing', function(done) {
+        var stmt = db.prepare("SELECT 1");
+        db.all("SELECT add(n, 1) AS x FROM nums", function(err, rows) {
+            if (err) throw err;
+            assert.equal(rows.length, 3000);
+            done();
+        });
+        // Both need the connection, which the query holds while it waits
+        // for add() on the main thread.
+        db.configure('busyTimeout', 1000);
+        stmt.finalize();
+    });
+
+    it('should close with statements left to finalize', function(done) {
+        var other = new sqlite3.Database(':memory:');
+        other.function('one', function() { return 1; });
+        other.prepare("SELECT one()").finalize();
+        other.close(done);
+    });
+
+    it('should reject invalid definitions', function() {
+        assert.throws(function() { db.function('x', 1); }, /fn must be a function/);
+        assert.throws(function() { db.aggregate('x', {}); }, /step must be a function/);
+    });
+
+    after(function(done) {
+        db.close(done);
+    });
+});
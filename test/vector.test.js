@@ -0,0 +1,88 @@
+var sqlite3 = require('..');
+var assert = require('assert');
+
+function float32(values) {
+    return new Buffer(new Uint8Array(new Float32Array(values).buffer));
+}
+
+function int8(values) {
+    return new Buffer(new Uint8Array(new Int8Array(values).buffer));
+}
+
+describe('vector functions', function() {
+    var db;
+    before(function(done) {
+        db = new sqlite3.Database(':memory:', function(err) {
+            if (err) throw err;
+            db.serialize(function() {
+                db.run("CREATE TABLE items (id INTEGER PRIMARY KEY, embedding BLOB, quantized BLOB)");
+                var stmt = db.prepare("INSERT INTO items VALUES (?, ?, ?)");
+                for (var i = 1; i <= 20; i++) {
+                    var values = [];
+                    for (var j = 0; j < 19; j++) values.push((i * 7 + j * 3) % 11 - 5);
+                    stmt.run(i, float32(values), int8(values));
+                }
+                stmt.finalize(done);
+            });
+        });
+    });
+
+    it('should compute float32 metrics', function(done) {
+        db.get("SELECT vec_dot(?1, ?2) AS dot, vec_cosine(?1, ?1) AS cosine, vec_l2(?1, ?2) AS l2",
+                float32([ 1, 2, 3 ]), float32([ 4, 5, 6 ]), function(err, row) {
+            if (err) throw err;
+            assert.equal(row.dot, 32);
+            assert.ok(Math.abs(row.cosine - 1) < 1e-6);
+            assert.ok(Math.abs(row.l2 - Math.sqrt(27)) < 1e-6);
+            done();
+        });
+    });
+
+    it('should agree between float32 and int8 vectors', function(done) {
+        db.all("SELECT vec_dot(embedding, embedding) AS f, vec_dot_i8(quantized, quantized) AS q, " +
+                "vec_l2(embedding, ?1) AS fl2, vec_l2_i8(quantized, ?2) AS ql2 FROM items",
+                float32(new Array(19).fill(1)), int8(new Array(19).fill(1)), function(err, rows) {
+            if (err) throw err;
+            assert.equal(rows.length, 20);
+            rows.forEach(function(row) {
+                assert.equal(row.f, row.q);
+                assert.ok(Math.abs(row.fl2 - row.ql2) < 1e-6);
+            });
+            done();
+        });
+    });
+
+    it('should return NULL for NULL and zero vectors', function(done) {
+        db.get("SELECT vec_dot(NULL, ?1) AS a, vec_cosine(?1, ?1) AS b", float32([ 0, 0 ]), function(err, row) {
+            if (err) throw err;
+            assert.deepEqual(row, { a: null, b: null });
+            done();
+        });
+    });
+
+    it('should reject vectors of different dimensions', function(done) {
+        db.get("SELECT vec_l2(?, ?)", float32([ 1 ]), float32([ 1, 2 ]), function(err) {
+            assert.ok(err);
+            assert.ok(/different dimensions/.test(err.message));
+            done();
+        });
+    });
+
+    it('should return the top k rows', function(done) {
+        db.get("SELECT vec_topk(id, -vec_l2(embedding, (SELECT embedding FROM items WHERE id = 3)), 2) AS top " +
+                "FROM items", function(err, row) {
+            if (err) throw err;
+            var top = JSON.parse(row.top);
+            assert.equal(top.length, 2);
+            assert.equal(top[0].score, 0);
+            assert.ok(top[0].score >= top[1].score);
+            // Rows 3 and 14 hold the same vector ((i * 7) % 11 repeats every 11).
+            assert.deepEqual(top.map(function(item) { return item.id; }).sort(), [ 14, 3 ]);
+            done();
+        });
+    });
+
+    after(function(done) {
+        db.close(done);
+    });
+});